@@ -0,0 +1,68 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: online/offline signing with a pool of commitments (y, v = a*y)
+*           precomputed for one secret key by background threads
+*
+* NOTE: this mode is not covered by the KATs. y is sampled from H(seed_y, r) with a fresh r,
+*       independently of H(m), so signatures are valid qTESLA signatures that crypto_sign_open()
+*       accepts, but not the ones crypto_sign() outputs for the same randomness.
+*       A commitment is handed out once and erased, whether its signature is accepted or rejected
+**************************************************************************************/
+
+#ifndef __COMMITPOOL_H
+#define __COMMITPOOL_H
+
+#include <stdint.h>
+#include "api.h"
+
+#define QTESLA_HM_BYTES (2*HM_BYTES)   // H(m) followed by the hash of the public key, as hashed by H
+
+typedef struct commitpool commitpool_t;
+
+typedef struct {
+  unsigned int capacity;          // Commitments stored when the pool is full (high watermark)
+  unsigned int low_watermark;     // Background threads resume when the fill level drops below this
+  unsigned int fill;              // Commitments currently stored
+  unsigned long long generated;   // Commitments computed by the background threads
+  unsigned long long served;      // Commitments handed out from the pool
+  unsigned long long misses;      // Commitments computed inline because the pool was empty
+  unsigned long long rejected;    // Commitments discarded because their signature was rejected
+  unsigned long long signatures;  // Signatures output
+  double refill_rate;             // Commitments per second computed by the background threads while active
+} commitpool_stats_t;
+
+// Creates a pool of "capacity" commitments for the secret key sk, of which it keeps a copy. "nthreads" background
+// threads refill it once its fill level drops below "low_watermark". Returns NULL on failure
+commitpool_t *commitpool_create(const unsigned char *sk, unsigned int capacity, unsigned int low_watermark, unsigned int nthreads);
+
+// Outputs the signed message sm as crypto_sign() does, with the key of the pool. Each rejection iteration takes a
+// commitment from the pool, or computes one inline if the pool is empty. Returns 0
+int commitpool_sign(commitpool_t *pool, unsigned char *sm, unsigned long long *smlen, const unsigned char *m, unsigned long long mlen);
+
+// Same as above, with the large temporaries kept in "ws", a workspace of CRYPTO_WORKSPACEBYTES bytes
+// aligned to CRYPTO_WORKSPACEALIGN
+int commitpool_sign_ws(commitpool_t *pool, unsigned char *sm, unsigned long long *smlen, const unsigned char *m, unsigned long long mlen, void *ws);
+
+void commitpool_get_stats(commitpool_t *pool, commitpool_stats_t *stats);
+
+// Stops the background threads and erases the stored commitments and the copy of the secret key
+void commitpool_destroy(commitpool_t *pool);
+
+// The two phases of a signature, in sign.c. The polynomials y, v and a are aligned to CRYPTO_WORKSPACEALIGN
+
+// Expands the PARAM_K*PARAM_N coefficients of the polynomials a_k of sk
+void qtesla_commit_a(int32_t *a, const unsigned char *sk, void *ws);
+
+// Offline phase: samples y (PARAM_N coefficients) from fresh randomness and computes v = a*y (PARAM_K*PARAM_N)
+void qtesla_commit(int32_t *y, int32_t *v, const int32_t *a, const unsigned char *sk, void *ws);
+
+// Hashes m for qtesla_sign_commit
+void qtesla_sign_hm(unsigned char *hm, const unsigned char *m, unsigned long long mlen, const unsigned char *sk);
+
+// Online phase: signs m with the commitment (y, v), whose v it overwrites. Returns 0 with the signed message in sm,
+// or QTESLA_SIGN_AGAIN if the signature was rejected; the commitment must never be used again either way
+int qtesla_sign_commit(unsigned char *sm, unsigned long long *smlen, const unsigned char *m, unsigned long long mlen,
+                       const unsigned char *hm, const unsigned char *sk, int32_t *y, int32_t *v, void *ws);
+
+#endif
@@ -7,7 +7,26 @@
 #include "poly.h"
 
 #define CHUNK_SIZE 512   // Fix chunk size for sampling
+#define GAUSS_CHUNKS (PARAM_N/CHUNK_SIZE)
+
+// Number of polynomials whose cSHAKE chunks fill the parallel Keccak
+#if defined(__AVX512F__)
+  #define KECCAK_LANES 8
+#else
+  #define KECCAK_LANES 4
+#endif
+#if KECCAK_LANES > GAUSS_CHUNKS
+  #define GAUSS_BATCH (KECCAK_LANES/GAUSS_CHUNKS)
+#else
+  #define GAUSS_BATCH 1
+#endif
+
+// Size of the buffer taken by sample_gauss_poly_batch: GAUSS_BATCH polynomials of CDT_COLS random words per coefficient
+#define GAUSS_BATCH_BYTES (GAUSS_BATCH*PARAM_N*2*4)
 
 void sample_gauss_poly(poly z, const unsigned char *seed, int nonce);
+int check_ES(poly p, unsigned int bound);   // Bound check of e and s, in sign.c; 0 if ok, otherwise 1
+unsigned int sample_gauss_poly_batch(int32_t *z[], const unsigned char *seed[], int nonce, unsigned int n, 
+                                     int (*check)(poly, unsigned int), const unsigned int bound[], int32_t *samp);
 
 #endif
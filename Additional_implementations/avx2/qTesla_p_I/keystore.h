@@ -0,0 +1,84 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: on-disk store of expanded keys, mapped into memory for signing and
+*           verification without expanding the keys again
+*
+* NOTE: a store holds the expanded polynomials in the layout of the implementation and
+*       parameter set that wrote it, and is only opened by the same ones, on a machine of
+*       the same byte order. It holds secret keys in the clear: keystore_write() creates
+*       it readable by its owner only
+**************************************************************************************/
+
+#ifndef __KEYSTORE_H
+#define __KEYSTORE_H
+
+#include <stdint.h>
+#include "api.h"
+
+#define KEYSTORE_VERSION 1
+#define KEYSTORE_DATA_OFFSET 4096      // The records start on the second page of the file
+#define KEYSTORE_DIGEST_BYTES 32
+
+// Flags of keystore_open()
+#define KEYSTORE_VERIFY_ALL 1          // Check the digest of every record when opening, instead of on first use
+#define KEYSTORE_VERIFY_NONE 2         // Never check the digests of the records
+#define KEYSTORE_POPULATE 4            // Read the whole store into memory when opening (MAP_POPULATE)
+#define KEYSTORE_HUGEPAGES 8           // Ask for transparent huge pages (MADV_HUGEPAGE)
+
+typedef struct {   // Public key expanded for verification
+  _Alignas(CRYPTO_WORKSPACEALIGN) int32_t a[PARAM_K*PARAM_N];   // Polynomials a_k, as output by poly_uniform()
+  _Alignas(CRYPTO_WORKSPACEALIGN) int32_t t[PARAM_K*PARAM_N];   // Polynomials t_k, decoded from pk
+  unsigned char hash_pk[HM_BYTES];                              // Hash of pk absorbed by H
+} qtesla_pk_expanded_t;
+
+typedef struct {   // One key of a store. a_k derives from seed_a, which sk and pk share, so it serves both
+  qtesla_pk_expanded_t x;
+  unsigned char pk[CRYPTO_PUBLICKEYBYTES];
+  unsigned char sk[CRYPTO_SECRETKEYBYTES];   // s and e are stored as bytes, which the signing loop reads as they are
+  uint32_t has_sk;
+  unsigned char digest[KEYSTORE_DIGEST_BYTES];   // SHAKE256 of the record up to this field, and of its index
+} keystore_record_t;
+
+typedef struct keystore keystore_t;
+
+// Writes the store of the n key pairs (pk[i], sk[i]) to "path", expanding every key. sk, or any sk[i], may be NULL
+// for keys that only verify. The store is written to a new file "path.XXXXXX" readable by its owner only, synced and
+// renamed over "path", so an existing
+// store is replaced whole or not at all, and stays valid for processes that have it open. Returns 0, or -1 if a
+// secret key does not match its public key or writing fails
+int keystore_write(const char *path, const unsigned char *const *pk, const unsigned char *const *sk, unsigned int n);
+
+// Maps the store at "path" read-only and shared, so that every process that opens it shares its pages.
+// Returns NULL if the file is not a store of this implementation and parameter set, or its header is corrupted
+keystore_t *keystore_open(const char *path, unsigned int flags);
+
+unsigned int keystore_count(keystore_t *ks);
+
+// Returns record i, or NULL if i is out of range or its digest does not match. The digest of a record is checked
+// on its first use unless the store was opened with KEYSTORE_VERIFY_ALL or KEYSTORE_VERIFY_NONE
+const keystore_record_t *keystore_get(keystore_t *ks, unsigned int i);
+
+// Same as crypto_sign() with the secret key of record i. Returns 0, or -1 if the record is invalid or has no secret key
+int keystore_sign(keystore_t *ks, unsigned int i, unsigned char *sm, unsigned long long *smlen, const unsigned char *m, unsigned long long mlen);
+
+// Same as crypto_sign_open() with the public key of record i. Returns 0 for a valid signature, otherwise a negative value
+int keystore_verify(keystore_t *ks, unsigned int i, unsigned char *m, unsigned long long *mlen, const unsigned char *sm, unsigned long long smlen);
+
+// Same as above, with the large temporaries kept in "ws", a workspace of CRYPTO_WORKSPACEBYTES bytes
+// aligned to CRYPTO_WORKSPACEALIGN
+int keystore_sign_ws(keystore_t *ks, unsigned int i, unsigned char *sm, unsigned long long *smlen, const unsigned char *m, unsigned long long mlen, void *ws);
+
+int keystore_verify_ws(keystore_t *ks, unsigned int i, unsigned char *m, unsigned long long *mlen, const unsigned char *sm, unsigned long long smlen, void *ws);
+
+void keystore_close(keystore_t *ks);
+
+// The expanded keys, in sign.c
+
+// Expands pk for qtesla_open_expanded()
+void qtesla_expand_pk(qtesla_pk_expanded_t *x, const unsigned char *pk, void *ws);
+
+// Same as crypto_sign_open_ws() with an expanded public key
+int qtesla_open_expanded(unsigned char *m, unsigned long long *mlen, const unsigned char *sm, unsigned long long smlen, const qtesla_pk_expanded_t *x, void *ws);
+
+#endif
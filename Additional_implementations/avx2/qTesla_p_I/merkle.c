@@ -0,0 +1,249 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: batch signing, with one signature of the root of a Merkle tree over the
+*           batch and a proof of inclusion per message
+*
+* Leaves are SHAKE256(0x00 || m) and inner nodes SHAKE256(0x01 || left || right), truncated
+* to MERKLE_HASH_BYTES, so a leaf can never be taken for a node. A node without a sibling
+* (the last one of a level of odd size) moves up unchanged instead of being paired with a
+* copy of itself, which would let two different batches share a root. The root message is
+* signed through its own hash, a cSHAKE256 with a Merkle customization in place of H(m), so
+* a signature output by crypto_sign() is never taken for a signed root.
+**************************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "api.h"
+#include "sign_step.h"
+#include "merkle.h"
+#include "sha3/fips202.h"
+
+#define MERKLE_ROOT_CSTM 0x4D02   // cSHAKE customization of the hash of the root message
+
+static const unsigned char merkle_tag[16] = "qTESLA Merkle v2";
+
+
+static void hash_leaf(unsigned char *out, const unsigned char *m, unsigned long long mlen)
+{ // out = H(0x00 || m)
+  uint64_t s[26];
+  unsigned char prefix = 0x00, buf[SHAKE256_RATE];
+
+  shake256_inc_init(s);
+  shake256_inc_absorb(s, &prefix, 1);
+  shake256_inc_absorb(s, m, mlen);
+  shake256_inc_finalize(s);
+  shake256_squeezeblocks(buf, 1, s);
+  memcpy(out, buf, MERKLE_HASH_BYTES);
+}
+
+
+static void hash_node(unsigned char *out, const unsigned char *left, const unsigned char *right)
+{ // out = H(0x01 || left || right). out may be left or right
+  unsigned char in[1 + 2*MERKLE_HASH_BYTES];
+
+  in[0] = 0x01;
+  memcpy(&in[1], left, MERKLE_HASH_BYTES);
+  memcpy(&in[1 + MERKLE_HASH_BYTES], right, MERKLE_HASH_BYTES);
+  shake256(out, MERKLE_HASH_BYTES, in, sizeof(in));
+}
+
+
+static void hash_root(unsigned char *hm, const unsigned char *msg)
+{ // Hash of the root message signed in place of H(m)
+  cshake256_simple(hm, HM_BYTES, MERKLE_ROOT_CSTM, msg, MERKLE_ROOT_MSG_BYTES);
+}
+
+
+static unsigned int tree_depth(unsigned int n)
+{
+  unsigned int depth = 0;
+
+  for (; n > 1; n = (n+1)/2)
+    depth++;
+  return depth;
+}
+
+
+static void store32(unsigned char *p, uint32_t x)
+{
+  for (unsigned int i = 0; i < 4; i++)
+    p[i] = (unsigned char)(x >> 8*i);
+}
+
+
+static uint32_t load32(const unsigned char *p)
+{
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+
+unsigned int merkle_proof_bytes(unsigned int n)
+{
+  if (n == 0 || n > MERKLE_MAX_BATCH)
+    return 0;
+  return 4 + tree_depth(n)*MERKLE_HASH_BYTES;
+}
+
+
+/***************************************************************
+* Name:        merkle_sign_batch
+* Description: signs the root of the Merkle tree over n messages
+*              and outputs the proof of inclusion of each one
+* Parameters:  inputs:
+*              - const unsigned char *const *m: messages
+*              - const unsigned long long *mlen: message lengths
+*              - unsigned int n: number of messages
+*              - const unsigned char* sk: secret key
+*              outputs:
+*              - unsigned char *sm: signed root
+*              - unsigned long long *smlen: signed root length
+*              - unsigned char *proofs: n*merkle_proof_bytes(n) bytes
+*              - unsigned int *prooflen: proof lengths, or NULL
+* Returns:     0 for successful execution
+*              -1 if n is out of range or memory runs out
+***************************************************************/
+int merkle_sign_batch(unsigned char *sm, unsigned long long *smlen, unsigned char *proofs, unsigned int *prooflen,
+                      const unsigned char *const *m, const unsigned long long *mlen, unsigned int n, const unsigned char *sk)
+{
+  unsigned char msg[MERKLE_ROOT_MSG_BYTES], hm[HM_BYTES], *nodes, *p;
+  unsigned int size[MERKLE_MAX_DEPTH+1], depth, stride, i, k, idx;
+  size_t offset[MERKLE_MAX_DEPTH+1], total = 0;
+  unsigned long long siglen;
+  qtesla_sign_t st;
+  void *ws;
+  int rsp;
+
+  if (n == 0 || n > MERKLE_MAX_BATCH)
+    return -1;
+  depth = tree_depth(n);
+  for (k = 0, i = n; k <= depth; k++, i = (i+1)/2) {
+    size[k] = i;
+    offset[k] = total;
+    total += i;
+  }
+  nodes = malloc(total*MERKLE_HASH_BYTES);
+  if (nodes == NULL)
+    return -1;
+  if (posix_memalign(&ws, CRYPTO_WORKSPACEALIGN, CRYPTO_WORKSPACEBYTES) != 0) {
+    free(nodes);
+    return -1;
+  }
+
+  for (i = 0; i < n; i++)
+    hash_leaf(&nodes[i*MERKLE_HASH_BYTES], m[i], mlen[i]);
+  for (k = 0; k < depth; k++) {
+    for (i = 0; i < size[k+1]; i++) {
+      p = &nodes[(offset[k] + 2*i)*MERKLE_HASH_BYTES];
+      if (2*i+1 < size[k])
+        hash_node(&nodes[(offset[k+1] + i)*MERKLE_HASH_BYTES], p, p + MERKLE_HASH_BYTES);
+      else
+        memcpy(&nodes[(offset[k+1] + i)*MERKLE_HASH_BYTES], p, MERKLE_HASH_BYTES);
+    }
+  }
+
+  // The proof of message i holds the siblings of the nodes on its path to the root, from the leaves up
+  stride = merkle_proof_bytes(n);
+  for (i = 0; i < n; i++) {
+    p = &proofs[(size_t)i*stride];
+    store32(p, i);
+    p += 4;
+    for (k = 0, idx = i; k < depth; k++, idx >>= 1) {
+      if ((idx^1) < size[k]) {
+        memcpy(p, &nodes[(offset[k] + (idx^1))*MERKLE_HASH_BYTES], MERKLE_HASH_BYTES);
+        p += MERKLE_HASH_BYTES;
+      }
+    }
+    if (prooflen != NULL)
+      prooflen[i] = (unsigned int)(p - &proofs[(size_t)i*stride]);
+  }
+
+  memcpy(msg, merkle_tag, sizeof(merkle_tag));
+  memcpy(&msg[sizeof(merkle_tag)], &nodes[offset[depth]*MERKLE_HASH_BYTES], MERKLE_HASH_BYTES);
+  store32(&msg[sizeof(merkle_tag) + MERKLE_HASH_BYTES], n);
+  free(nodes);
+
+  hash_root(hm, msg);
+  qtesla_sign_begin_hm(&st, hm, sk, ws);
+  qtesla_sign_step(&st, 0);
+  rsp = qtesla_sign_finish(&st, sm, &siglen);
+  qtesla_clear(ws, CRYPTO_WORKSPACEBYTES);
+  free(ws);
+  memcpy(&sm[CRYPTO_BYTES], msg, MERKLE_ROOT_MSG_BYTES);
+  *smlen = MERKLE_SIGNED_ROOT_BYTES;
+  return rsp;
+}
+
+
+void merkle_verifier_init(merkle_verifier_t *v, const unsigned char *pk)
+{
+  memcpy(v->pk, pk, CRYPTO_PUBLICKEYBYTES);
+  v->cached = 0;
+  v->root_verifications = 0;
+  v->cache_hits = 0;
+}
+
+
+/***************************************************************
+* Name:        merkle_verify
+* Description: checks the proof of inclusion of m in a batch and,
+*              unless it is the cached one, the signed root
+* Parameters:  inputs:
+*              - merkle_verifier_t *v: verifier of the public key
+*              - const unsigned char *m: message
+*              - unsigned long long mlen: message length
+*              - const unsigned char *proof: proof of inclusion
+*              - unsigned int prooflen: proof length
+*              - const unsigned char *sm: signed root
+*              - unsigned long long smlen: signed root length
+* Returns:     0 for valid proof and signature
+*              -1 otherwise
+***************************************************************/
+int merkle_verify(merkle_verifier_t *v, const unsigned char *m, unsigned long long mlen, const unsigned char *proof,
+                  unsigned int prooflen, const unsigned char *sm, unsigned long long smlen)
+{
+  unsigned char h[MERKLE_HASH_BYTES], hm[HM_BYTES];
+  const unsigned char *msg = &sm[CRYPTO_BYTES];
+  unsigned int n, idx, size, used = 4;
+  void *ws;
+  int rsp;
+
+  if (smlen != MERKLE_SIGNED_ROOT_BYTES || prooflen < 4 || memcmp(msg, merkle_tag, sizeof(merkle_tag)) != 0)
+    return -1;
+  if (v->cached && memcmp(v->sm, sm, MERKLE_SIGNED_ROOT_BYTES) == 0) {
+    v->cache_hits++;
+  } else {
+    v->cached = 0;
+    v->root_verifications++;
+    hash_root(hm, msg);
+    if (posix_memalign(&ws, CRYPTO_WORKSPACEALIGN, CRYPTO_WORKSPACEBYTES) != 0)
+      return -1;
+    rsp = qtesla_verify_hm(sm, CRYPTO_BYTES, hm, v->pk, ws);
+    free(ws);
+    if (rsp != 0)
+      return -1;
+    memcpy(v->sm, sm, MERKLE_SIGNED_ROOT_BYTES);
+    v->cached = 1;
+  }
+
+  n = load32(&msg[sizeof(merkle_tag) + MERKLE_HASH_BYTES]);
+  idx = load32(proof);
+  if (n == 0 || n > MERKLE_MAX_BATCH || idx >= n)
+    return -1;
+  hash_leaf(h, m, mlen);
+  for (size = n; size > 1; size = (size+1)/2, idx >>= 1) {
+    if ((idx^1) >= size)
+      continue;
+    if (prooflen - used < MERKLE_HASH_BYTES)
+      return -1;
+    if (idx & 1)
+      hash_node(h, &proof[used], h);
+    else
+      hash_node(h, h, &proof[used]);
+    used += MERKLE_HASH_BYTES;
+  }
+  if (used != prooflen || memcmp(h, &msg[sizeof(merkle_tag)], MERKLE_HASH_BYTES) != 0)
+    return -1;
+  return 0;
+}
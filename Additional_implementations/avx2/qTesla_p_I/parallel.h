@@ -0,0 +1,22 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: opt-in fork-join helper threads for the per-polynomial loops inside a
+*           single key generation, signature or verification
+**************************************************************************************/
+
+#ifndef __PARALLEL_H
+#define __PARALLEL_H
+
+// Starts "nhelpers" helper threads, pinned to cpus[0..nhelpers-1] unless "cpus" is NULL. From then on
+// parallel_for() runs on the calling thread plus the helpers. Returns 0 on success
+int parallel_enable(unsigned int nhelpers, const int *cpus);
+
+// Stops the helper threads. Must not run concurrently with any qTESLA operation
+void parallel_disable(void);
+
+// Runs fn(arg, i) for i = 0..n-1 and returns when all calls have completed. Calls run on the helper 
+// threads when they are enabled and idle, and in order on the calling thread otherwise
+void parallel_for(unsigned int n, void (*fn)(void *arg, unsigned int i), void *arg);
+
+#endif
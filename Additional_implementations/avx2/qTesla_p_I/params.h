@@ -30,7 +30,12 @@
 #define PARAM_R2_INVN 13632409
 #define PARAM_R 172048372
 #define SHAKE shake128
+#define SHAKE_INC_INIT shake128_inc_init
+#define SHAKE_INC_ABSORB shake128_inc_absorb
+#define SHAKE_INC_FINALIZE shake128_inc_finalize
+#define SHAKE_SQUEEZEBLOCKS shake128_squeezeblocks
 #define cSHAKE cshake128_simple
+#define cSHAKE_BATCH cshake128_simple_batch
 #define SHAKE_RATE SHAKE128_RATE
 
 #endif
\ No newline at end of file
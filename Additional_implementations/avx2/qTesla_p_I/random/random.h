@@ -4,4 +4,21 @@
 // Generate random bytes and output the result to random_array
 void randombytes(unsigned char* random_array, unsigned int nbytes);
 
+// Same, but reading every request directly from the operating system
+void randombytes_system(unsigned char* random_array, unsigned int nbytes);
+
+#ifdef REPLAY
+// Replay builds only (make REPLAY=TRUE), NOT for production: randombytes() is keyed from a fixed seed, so the 
+// same calls return the same bytes in every run and anyone who knows the seed can recompute keys and signatures. 
+// The seed is QTESLA_REPLAY_SEED from the environment, or RANDOMBYTES_REPLAY_SEED. Each thread reads its own 
+// stream of the seed, numbered in the order the threads first call randombytes()
+#define RANDOMBYTES_REPLAY_SEED "qTESLA replay"
+
+// Sets the seed and restarts the calling thread at stream 0, and the streams of other threads from 1
+void randombytes_replay(const unsigned char* seed, unsigned int seedlen);
+
+// Restarts the calling thread at the beginning of "stream", independently of the order threads start in
+void randombytes_replay_stream(unsigned int stream);
+#endif
+
 #endif
@@ -12,5 +12,20 @@ void shake256(unsigned char *output, unsigned long long outlen, const unsigned c
 void sha3256(unsigned char *output, const unsigned char *input, unsigned int inputByteLen);
 void cshake128_simple(unsigned char *output, unsigned long long outlen, uint16_t cstm, const unsigned char *in, unsigned long long inlen);
 void cshake256_simple(unsigned char *output, unsigned long long outlen, uint16_t cstm, const unsigned char *in, unsigned long long inlen);
+void cshake128_simple_absorb(uint64_t s[25], uint16_t cstm, const unsigned char *in, unsigned long long inlen);
+void cshake128_simple_squeezeblocks(unsigned char *output, unsigned long long nblocks, uint64_t *s);
+void shake256_squeezeblocks(unsigned char *output, unsigned long long nblocks, uint64_t *s);
+
+// Incremental absorption: s_inc holds 26 words, the state and the number of bytes absorbed into the current block.
+// After _inc_finalize, the output is read with shake128_squeezeblocks/shake256_squeezeblocks
+void shake128_inc_init(uint64_t *s_inc);
+void shake128_inc_absorb(uint64_t *s_inc, const unsigned char *input, unsigned long long inlen);
+void shake128_inc_finalize(uint64_t *s_inc);
+void shake256_inc_init(uint64_t *s_inc);
+void shake256_inc_absorb(uint64_t *s_inc, const unsigned char *input, unsigned long long inlen);
+void shake256_inc_finalize(uint64_t *s_inc);
+// cSHAKE256 with the 16-bit customization "cstm", as cshake256_simple: absorb with shake256_inc_absorb
+void cshake256_inc_init(uint64_t *s_inc, uint16_t cstm);
+void cshake256_inc_finalize(uint64_t *s_inc);
 
 #endif
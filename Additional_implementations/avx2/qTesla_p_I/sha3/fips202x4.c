@@ -2,6 +2,7 @@
 #include <stdint.h>
 #include <assert.h>
 #include "fips202.h"
+#include "fips202x4.h"
 
 #define NROUNDS 24
 #define ROL(a, offset) ((a << offset) ^ (a >> (64-offset)))
@@ -124,6 +125,13 @@ static void keccak_squeezeblocks4x(unsigned char *h0, unsigned char *h1, unsigne
 /********** cSHAKE128 ***********/
 
 void cshake128_simple_absorb4x(__m256i *s, uint16_t cstm0, uint16_t cstm1, uint16_t cstm2, uint16_t cstm3, const unsigned char *in, unsigned long long inlen)
+{
+  cshake128_simple_absorb4x_multi(s, cstm0, cstm1, cstm2, cstm3, in, in, in, in, inlen);
+}
+
+
+void cshake128_simple_absorb4x_multi(__m256i *s, uint16_t cstm0, uint16_t cstm1, uint16_t cstm2, uint16_t cstm3, 
+                                   const unsigned char *in0, const unsigned char *in1, const unsigned char *in2, const unsigned char *in3, unsigned long long inlen)
 {
   unsigned char *sep = (unsigned char *)s;
   unsigned int i;
@@ -153,7 +161,7 @@ void cshake128_simple_absorb4x(__m256i *s, uint16_t cstm0, uint16_t cstm1, uint1
   KeccakF1600_StatePermute4x(s);
 
   /* Absorb input */
-  keccak_absorb4x(s, SHAKE128_RATE, in, in, in, in, inlen, 0x04);
+  keccak_absorb4x(s, SHAKE128_RATE, in0, in1, in2, in3, inlen, 0x04);
 }
 
 
@@ -197,9 +205,51 @@ void cshake128_simple4x(unsigned char *output0, unsigned char *output1, unsigned
 }
 
 
+/* Same as above, with a separate input string for each instance */
+void cshake128_simple4x_multi(unsigned char *output0, unsigned char *output1, unsigned char *output2, unsigned char *output3, unsigned long long outlen, 
+                              uint16_t cstm0, uint16_t cstm1, uint16_t cstm2, uint16_t cstm3, 
+                              const unsigned char *in0, const unsigned char *in1, const unsigned char *in2, const unsigned char *in3, unsigned long long inlen)
+{
+  __m256i s[25];
+  unsigned char t0[SHAKE128_RATE];
+  unsigned char t1[SHAKE128_RATE];
+  unsigned char t2[SHAKE128_RATE];
+  unsigned char t3[SHAKE128_RATE];
+  unsigned int i;
+
+  cshake128_simple_absorb4x_multi(s, cstm0, cstm1, cstm2, cstm3, in0, in1, in2, in3, inlen);
+
+  /* Squeeze output */
+  keccak_squeezeblocks4x(output0, output1, output2, output3, outlen/SHAKE128_RATE, s, SHAKE128_RATE);
+  output0 += (outlen/SHAKE128_RATE)*SHAKE128_RATE;
+  output1 += (outlen/SHAKE128_RATE)*SHAKE128_RATE;
+  output2 += (outlen/SHAKE128_RATE)*SHAKE128_RATE;
+  output3 += (outlen/SHAKE128_RATE)*SHAKE128_RATE;
+
+  if (outlen%SHAKE128_RATE)
+  {
+    keccak_squeezeblocks4x(t0, t1, t2, t3, 1, s, SHAKE128_RATE);
+    for (i = 0; i < outlen%SHAKE128_RATE; i++)
+    {
+      output0[i] = t0[i];
+      output1[i] = t1[i];
+      output2[i] = t2[i];
+      output3[i] = t3[i];
+    }
+  }
+}
+
+
 /********** cSHAKE256 ***********/
 
 void cshake256_simple_absorb4x(__m256i *s, uint16_t cstm0, uint16_t cstm1, uint16_t cstm2, uint16_t cstm3, const unsigned char *in, unsigned long long inlen)
+{
+  cshake256_simple_absorb4x_multi(s, cstm0, cstm1, cstm2, cstm3, in, in, in, in, inlen);
+}
+
+
+void cshake256_simple_absorb4x_multi(__m256i *s, uint16_t cstm0, uint16_t cstm1, uint16_t cstm2, uint16_t cstm3, 
+                                   const unsigned char *in0, const unsigned char *in1, const unsigned char *in2, const unsigned char *in3, unsigned long long inlen)
 {
   unsigned char *sep = (unsigned char *)s;
   unsigned int i;
@@ -229,7 +279,7 @@ void cshake256_simple_absorb4x(__m256i *s, uint16_t cstm0, uint16_t cstm1, uint1
   KeccakF1600_StatePermute4x(s);
 
   /* Absorb input */
-  keccak_absorb4x(s, SHAKE256_RATE, in, in, in, in, inlen, 0x04);
+  keccak_absorb4x(s, SHAKE256_RATE, in0, in1, in2, in3, inlen, 0x04);
 }
 
 
@@ -271,3 +321,38 @@ void cshake256_simple4x(unsigned char *output0, unsigned char *output1, unsigned
     }
   }
 }
+
+
+/* Same as above, with a separate input string for each instance */
+void cshake256_simple4x_multi(unsigned char *output0, unsigned char *output1, unsigned char *output2, unsigned char *output3, unsigned long long outlen, 
+                              uint16_t cstm0, uint16_t cstm1, uint16_t cstm2, uint16_t cstm3, 
+                              const unsigned char *in0, const unsigned char *in1, const unsigned char *in2, const unsigned char *in3, unsigned long long inlen)
+{
+  __m256i s[25];
+  unsigned char t0[SHAKE256_RATE];
+  unsigned char t1[SHAKE256_RATE];
+  unsigned char t2[SHAKE256_RATE];
+  unsigned char t3[SHAKE256_RATE];
+  unsigned int i;
+
+  cshake256_simple_absorb4x_multi(s, cstm0, cstm1, cstm2, cstm3, in0, in1, in2, in3, inlen);
+
+  /* Squeeze output */
+  keccak_squeezeblocks4x(output0, output1, output2, output3, outlen/SHAKE256_RATE, s, SHAKE256_RATE);
+  output0 += (outlen/SHAKE256_RATE)*SHAKE256_RATE;
+  output1 += (outlen/SHAKE256_RATE)*SHAKE256_RATE;
+  output2 += (outlen/SHAKE256_RATE)*SHAKE256_RATE;
+  output3 += (outlen/SHAKE256_RATE)*SHAKE256_RATE;
+
+  if (outlen%SHAKE256_RATE)
+  {
+    keccak_squeezeblocks4x(t0, t1, t2, t3, 1, s, SHAKE256_RATE);
+    for (i = 0; i < outlen%SHAKE256_RATE; i++)
+    {
+      output0[i] = t0[i];
+      output1[i] = t1[i];
+      output2[i] = t2[i];
+      output3[i] = t3[i];
+    }
+  }
+}
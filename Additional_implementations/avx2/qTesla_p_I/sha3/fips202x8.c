@@ -0,0 +1,249 @@
+#include <immintrin.h>
+#include <stdint.h>
+#include "fips202.h"
+#include "fips202x4.h"
+#include "fips202x8.h"
+
+
+#if defined(__AVX512F__)
+
+static uint64_t load64(const unsigned char *x)
+{
+  unsigned long long r = 0, i;
+
+  for (i = 0; i < 8; ++i) {
+    r |= (unsigned long long)x[i] << 8 * i;
+  }
+  return r;
+}
+
+
+static void store64(uint8_t *x, uint64_t u)
+{
+  unsigned int i;
+
+  for (i = 0; i < 8; ++i) {
+    x[i] = u;
+    u >>= 8;
+  }
+}
+
+
+/* 8-way variant of the Keccak Code Package permutation */
+extern void KeccakP1600times8_PermuteAll_24rounds(__m512i *s);
+#define KeccakF1600_StatePermute8x KeccakP1600times8_PermuteAll_24rounds
+
+
+static void keccak_absorb8x(__m512i *s, unsigned int r, const unsigned char *m[8], unsigned long long int mlen, unsigned char p)
+{
+  unsigned long long i, pos = 0;
+  unsigned int j;
+  unsigned char t[8][200];
+  unsigned long long *ss = (unsigned long long *)s;
+   
+  while (mlen >= r) 
+  {
+    for (i = 0; i < r / 8; ++i)
+      for (j = 0; j < 8; j++)
+        ss[8*i+j] ^= load64(m[j] + pos + 8 * i);
+    
+    KeccakF1600_StatePermute8x(s);
+    mlen -= r;
+    pos += r;
+  }
+
+  for (j = 0; j < 8; j++)
+  {
+    for (i = 0; i < r; ++i)
+      t[j][i] = 0;
+    for (i = 0; i < mlen; ++i)
+      t[j][i] = m[j][pos + i];
+    t[j][i] = p;
+    t[j][r - 1] |= 128;
+  }
+
+  for (i = 0; i < r / 8; ++i)
+    for (j = 0; j < 8; j++)
+      ss[8*i+j] ^= load64(t[j] + 8 * i);
+}
+
+
+static void keccak_squeezeblocks8x(unsigned char *h[8], unsigned long long int nblocks, __m512i *s, unsigned int r)
+{
+  unsigned long long pos = 0;
+  unsigned int i, j;
+  unsigned long long *ss = (unsigned long long *)s;
+
+  while (nblocks > 0) 
+  {
+    KeccakF1600_StatePermute8x(s);
+    for (i = 0; i < (r>>3); i++)
+      for (j = 0; j < 8; j++)
+        store64(h[j] + pos + 8*i, ss[8*i+j]);
+    pos += r;
+    nblocks--;
+  }
+}
+
+
+static void cshake_simple_absorb8x(__m512i *s, unsigned int r, unsigned char rate_byte, const uint16_t cstm[8], const unsigned char *in[8], unsigned long long inlen)
+{
+  unsigned char *sep = (unsigned char *)s;
+  unsigned int i;
+
+  for (i = 0; i < 25; i++)
+    s[i] = _mm512_setzero_si512(); // zero state
+
+  /* Absorb customization (domain-separation) string */
+  for (i = 0; i < 8; i++)
+  {
+    sep[8*i+0] = 0x01;
+    sep[8*i+1] = rate_byte;
+    sep[8*i+2] = 0x01;
+    sep[8*i+3] = 0x00;
+    sep[8*i+4] = 0x01;
+    sep[8*i+5] = 16;
+    sep[8*i+6] = cstm[i] & 0xff;
+    sep[8*i+7] = cstm[i] >> 8;
+  }
+
+  KeccakF1600_StatePermute8x(s);
+
+  /* Absorb input */
+  keccak_absorb8x(s, r, in, inlen, 0x04);
+}
+
+
+static void cshake_simple_squeeze8x(unsigned char *output[8], unsigned long long outlen, __m512i *s, unsigned int r)
+{
+  unsigned char t[8][SHAKE128_RATE];
+  unsigned char *tp[8];
+  unsigned long long full = (outlen/r)*r;
+  unsigned int i, j;
+
+  /* Squeeze output */
+  keccak_squeezeblocks8x(output, outlen/r, s, r);
+
+  if (outlen%r)
+  {
+    for (j = 0; j < 8; j++)
+      tp[j] = t[j];
+    keccak_squeezeblocks8x(tp, 1, s, r);
+    for (j = 0; j < 8; j++)
+      for (i = 0; i < outlen%r; i++)
+        output[j][full + i] = t[j][i];
+  }
+}
+
+
+/********** cSHAKE128 ***********/
+
+void cshake128_simple_absorb8x(__m512i *s, const uint16_t cstm[8], const unsigned char *in[8], unsigned long long inlen)
+{
+  cshake_simple_absorb8x(s, SHAKE128_RATE, 0xa8, cstm, in, inlen);
+}
+
+
+void cshake128_simple_squeezeblocks8x(unsigned char *output[8], unsigned long long outlen, __m512i *s)
+{
+  keccak_squeezeblocks8x(output, outlen, s, SHAKE128_RATE);
+}
+
+
+void cshake128_simple8x(unsigned char *output[8], unsigned long long outlen, const uint16_t cstm[8], const unsigned char *in[8], unsigned long long inlen)
+{
+  __m512i s[25];
+
+  cshake_simple_absorb8x(s, SHAKE128_RATE, 0xa8, cstm, in, inlen);
+  cshake_simple_squeeze8x(output, outlen, s, SHAKE128_RATE);
+}
+
+
+/********** cSHAKE256 ***********/
+
+void cshake256_simple_absorb8x(__m512i *s, const uint16_t cstm[8], const unsigned char *in[8], unsigned long long inlen)
+{
+  cshake_simple_absorb8x(s, SHAKE256_RATE, 0x88, cstm, in, inlen);
+}
+
+
+void cshake256_simple_squeezeblocks8x(unsigned char *output[8], unsigned long long outlen, __m512i *s)
+{
+  keccak_squeezeblocks8x(output, outlen, s, SHAKE256_RATE);
+}
+
+
+void cshake256_simple8x(unsigned char *output[8], unsigned long long outlen, const uint16_t cstm[8], const unsigned char *in[8], unsigned long long inlen)
+{
+  __m512i s[25];
+
+  cshake_simple_absorb8x(s, SHAKE256_RATE, 0x88, cstm, in, inlen);
+  cshake_simple_squeeze8x(output, outlen, s, SHAKE256_RATE);
+}
+
+#endif
+
+
+/********** Batched cSHAKE ***********/
+
+/* Instances are processed in groups of the Keccak width. Unused lanes of the last group repeat 
+   the last instance, which writes the same bytes to the same output a second time. */
+
+void cshake128_simple_batch(unsigned char **output, unsigned long long outlen, const uint16_t *cstm, const unsigned char **in, unsigned long long inlen, unsigned int n)
+{
+  unsigned int i = 0;
+
+#if defined(__AVX512F__)
+  unsigned int j, k;
+  unsigned char *o8[8];
+  const unsigned char *i8[8];
+  uint16_t c8[8];
+
+  for (; i + 4 < n; i += 8) {
+    for (j = 0; j < 8; j++) {
+      k = (i+j < n) ? i+j : n-1;
+      o8[j] = output[k];
+      c8[j] = cstm[k];
+      i8[j] = in[k];
+    }
+    cshake128_simple8x(o8, outlen, c8, i8, inlen);
+  }
+#endif
+  for (; i + 1 < n; i += 4) {
+    unsigned int k1 = (i+1 < n) ? i+1 : n-1, k2 = (i+2 < n) ? i+2 : n-1, k3 = (i+3 < n) ? i+3 : n-1;
+    cshake128_simple4x_multi(output[i], output[k1], output[k2], output[k3], outlen, cstm[i], cstm[k1], cstm[k2], cstm[k3], 
+                             in[i], in[k1], in[k2], in[k3], inlen);
+  }
+  if (i < n)
+    cshake128_simple(output[i], outlen, cstm[i], in[i], inlen);
+}
+
+
+void cshake256_simple_batch(unsigned char **output, unsigned long long outlen, const uint16_t *cstm, const unsigned char **in, unsigned long long inlen, unsigned int n)
+{
+  unsigned int i = 0;
+
+#if defined(__AVX512F__)
+  unsigned int j, k;
+  unsigned char *o8[8];
+  const unsigned char *i8[8];
+  uint16_t c8[8];
+
+  for (; i + 4 < n; i += 8) {
+    for (j = 0; j < 8; j++) {
+      k = (i+j < n) ? i+j : n-1;
+      o8[j] = output[k];
+      c8[j] = cstm[k];
+      i8[j] = in[k];
+    }
+    cshake256_simple8x(o8, outlen, c8, i8, inlen);
+  }
+#endif
+  for (; i + 1 < n; i += 4) {
+    unsigned int k1 = (i+1 < n) ? i+1 : n-1, k2 = (i+2 < n) ? i+2 : n-1, k3 = (i+3 < n) ? i+3 : n-1;
+    cshake256_simple4x_multi(output[i], output[k1], output[k2], output[k3], outlen, cstm[i], cstm[k1], cstm[k2], cstm[k3], 
+                             in[i], in[k1], in[k2], in[k3], inlen);
+  }
+  if (i < n)
+    cshake256_simple(output[i], outlen, cstm[i], in[i], inlen);
+}
@@ -0,0 +1,136 @@
+/********************************************************************************************
+* 8-way parallel Keccak-p[1600,24] permutation using AVX-512
+*
+* Based on the public domain "times8 SIMD512" implementation from the eXtended Keccak Code
+* Package (https://github.com/XKCP/XKCP) by the Keccak, Keyak and Ketje Teams.
+*
+* The eight states are interleaved lane by lane: s[i] holds lane i of all eight instances.
+* Theta parities and chi use three-input "vpternlogq" operations and the rotations use
+* "vprolq", so a round needs no temporary NOTs or shift pairs.
+*********************************************************************************************/
+
+#if defined(__AVX512F__)
+
+#include <immintrin.h>
+#include <stdint.h>
+
+typedef __m512i V512;
+
+#define XOR(a, b)           _mm512_xor_si512(a, b)
+#define XOR3(a, b, c)       _mm512_ternarylogic_epi64(a, b, c, 0x96)
+#define XOR5(a, b, c, d, e) XOR3(XOR3(a, b, c), d, e)
+#define ROL(a, offset)      _mm512_rol_epi64(a, offset)
+#define CHI(a, b, c)        _mm512_ternarylogic_epi64(a, b, c, 0xD2)   // a ^ (~b & c)
+
+
+static const uint64_t KeccakP1600times8_RoundConstants[24] =
+{
+    0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL, 0x8000000080008000ULL,
+    0x000000000000808bULL, 0x0000000080000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
+    0x000000000000008aULL, 0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
+    0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL, 0x8000000000008003ULL,
+    0x8000000000008002ULL, 0x8000000000000080ULL, 0x000000000000800aULL, 0x800000008000000aULL,
+    0x8000000080008081ULL, 0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL
+};
+
+
+#define declareABCDE \
+    V512 Aba, Abe, Abi, Abo, Abu; \
+    V512 Aga, Age, Agi, Ago, Agu; \
+    V512 Aka, Ake, Aki, Ako, Aku; \
+    V512 Ama, Ame, Ami, Amo, Amu; \
+    V512 Asa, Ase, Asi, Aso, Asu; \
+    V512 Bba, Bbe, Bbi, Bbo, Bbu; \
+    V512 Ca, Ce, Ci, Co, Cu; \
+    V512 Da, De, Di, Do, Du; \
+    V512 Eba, Ebe, Ebi, Ebo, Ebu; \
+    V512 Ega, Ege, Egi, Ego, Egu; \
+    V512 Eka, Eke, Eki, Eko, Eku; \
+    V512 Ema, Eme, Emi, Emo, Emu; \
+    V512 Esa, Ese, Esi, Eso, Esu;
+
+#define chiPlane(E, y) \
+    E##y##a = CHI(Bba, Bbe, Bbi); \
+    E##y##e = CHI(Bbe, Bbi, Bbo); \
+    E##y##i = CHI(Bbi, Bbo, Bbu); \
+    E##y##o = CHI(Bbo, Bbu, Bba); \
+    E##y##u = CHI(Bbu, Bba, Bbe);
+
+// Round i reading state A and writing state E
+#define thetaRhoPiChiIota(i, A, E) \
+    Ca = XOR5(A##ba, A##ga, A##ka, A##ma, A##sa); \
+    Ce = XOR5(A##be, A##ge, A##ke, A##me, A##se); \
+    Ci = XOR5(A##bi, A##gi, A##ki, A##mi, A##si); \
+    Co = XOR5(A##bo, A##go, A##ko, A##mo, A##so); \
+    Cu = XOR5(A##bu, A##gu, A##ku, A##mu, A##su); \
+    Da = XOR(Cu, ROL(Ce, 1)); \
+    De = XOR(Ca, ROL(Ci, 1)); \
+    Di = XOR(Ce, ROL(Co, 1)); \
+    Do = XOR(Ci, ROL(Cu, 1)); \
+    Du = XOR(Co, ROL(Ca, 1)); \
+    \
+    Bba = XOR(A##ba, Da); \
+    Bbe = ROL(XOR(A##ge, De), 44); \
+    Bbi = ROL(XOR(A##ki, Di), 43); \
+    Bbo = ROL(XOR(A##mo, Do), 21); \
+    Bbu = ROL(XOR(A##su, Du), 14); \
+    chiPlane(E, b) \
+    E##ba = XOR(E##ba, _mm512_set1_epi64((long long)KeccakP1600times8_RoundConstants[i])); \
+    \
+    Bba = ROL(XOR(A##bo, Do), 28); \
+    Bbe = ROL(XOR(A##gu, Du), 20); \
+    Bbi = ROL(XOR(A##ka, Da),  3); \
+    Bbo = ROL(XOR(A##me, De), 45); \
+    Bbu = ROL(XOR(A##si, Di), 61); \
+    chiPlane(E, g) \
+    \
+    Bba = ROL(XOR(A##be, De),  1); \
+    Bbe = ROL(XOR(A##gi, Di),  6); \
+    Bbi = ROL(XOR(A##ko, Do), 25); \
+    Bbo = ROL(XOR(A##mu, Du),  8); \
+    Bbu = ROL(XOR(A##sa, Da), 18); \
+    chiPlane(E, k) \
+    \
+    Bba = ROL(XOR(A##bu, Du), 27); \
+    Bbe = ROL(XOR(A##ga, Da), 36); \
+    Bbi = ROL(XOR(A##ke, De), 10); \
+    Bbo = ROL(XOR(A##mi, Di), 15); \
+    Bbu = ROL(XOR(A##so, Do), 56); \
+    chiPlane(E, m) \
+    \
+    Bba = ROL(XOR(A##bi, Di), 62); \
+    Bbe = ROL(XOR(A##go, Do), 55); \
+    Bbi = ROL(XOR(A##ku, Du), 39); \
+    Bbo = ROL(XOR(A##ma, Da), 41); \
+    Bbu = ROL(XOR(A##se, De),  2); \
+    chiPlane(E, s)
+
+#define copyFromState(X, state) \
+    X##ba = state[ 0]; X##be = state[ 1]; X##bi = state[ 2]; X##bo = state[ 3]; X##bu = state[ 4]; \
+    X##ga = state[ 5]; X##ge = state[ 6]; X##gi = state[ 7]; X##go = state[ 8]; X##gu = state[ 9]; \
+    X##ka = state[10]; X##ke = state[11]; X##ki = state[12]; X##ko = state[13]; X##ku = state[14]; \
+    X##ma = state[15]; X##me = state[16]; X##mi = state[17]; X##mo = state[18]; X##mu = state[19]; \
+    X##sa = state[20]; X##se = state[21]; X##si = state[22]; X##so = state[23]; X##su = state[24];
+
+#define copyToState(state, X) \
+    state[ 0] = X##ba; state[ 1] = X##be; state[ 2] = X##bi; state[ 3] = X##bo; state[ 4] = X##bu; \
+    state[ 5] = X##ga; state[ 6] = X##ge; state[ 7] = X##gi; state[ 8] = X##go; state[ 9] = X##gu; \
+    state[10] = X##ka; state[11] = X##ke; state[12] = X##ki; state[13] = X##ko; state[14] = X##ku; \
+    state[15] = X##ma; state[16] = X##me; state[17] = X##mi; state[18] = X##mo; state[19] = X##mu; \
+    state[20] = X##sa; state[21] = X##se; state[22] = X##si; state[23] = X##so; state[24] = X##su;
+
+
+void KeccakP1600times8_PermuteAll_24rounds(V512 *s)
+{ // Keccak-f[1600] applied to eight interleaved states
+    declareABCDE
+    unsigned int i;
+
+    copyFromState(A, s)
+    for (i = 0; i < 24; i += 2) {
+        thetaRhoPiChiIota(i  , A, E)
+        thetaRhoPiChiIota(i+1, E, A)
+    }
+    copyToState(s, A)
+}
+
+#endif
@@ -0,0 +1,51 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: per-thread statistics of key generation, signing and verification
+**************************************************************************************/
+
+#include <string.h>
+#include "stats.h"
+
+#ifdef STATS
+__thread qtesla_stats_t qtesla_stats_local;
+#endif
+
+
+int qtesla_stats_snapshot(qtesla_stats_t *stats)
+{
+#ifdef STATS
+  *stats = qtesla_stats_local;
+  return 0;
+#else
+  memset(stats, 0, sizeof(qtesla_stats_t));
+  return -1;
+#endif
+}
+
+
+void qtesla_stats_reset(void)
+{
+#ifdef STATS
+  memset(&qtesla_stats_local, 0, sizeof(qtesla_stats_t));
+#endif
+}
+
+
+void qtesla_stats_merge(qtesla_stats_t *total, const qtesla_stats_t *stats)
+{
+  unsigned int i, j;
+
+  total->keypairs += stats->keypairs;
+  total->signatures += stats->signatures;
+  total->verifications += stats->verifications;
+  total->gauss_samples += stats->gauss_samples;
+  total->sign_iterations += stats->sign_iterations;
+  for (i = 0; i < QTESLA_NREJECTS; i++) {
+    total->rejections[i] += stats->rejections[i];
+    for (j = 0; j < QTESLA_STATS_HIST; j++)
+      total->rejection_hist[i][j] += stats->rejection_hist[i][j];
+  }
+  for (i = 0; i < QTESLA_NPHASES; i++)
+    total->cycles[i] += stats->cycles[i];
+}
@@ -0,0 +1,120 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: amortized cost per message of Merkle batch signing against one
+*           crypto_sign and crypto_sign_open per message
+*
+* Usage: bench_merkle [nruns]
+*        Each batch size is signed "nruns" times (20 by default). Verification checks
+*        every proof of a batch with one verifier, so the signed root is verified once
+**************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../random/random.h"
+#include "../api.h"
+#include "../merkle.h"
+#include "cpucycles.h"
+
+#define MLEN 64   // A small record
+#define NRUNS 20
+#define NSIZES 5
+
+static const unsigned int batch_sizes[NSIZES] = { 1, 16, 256, 1024, 4096 };
+
+
+static int cmp_llu(const void *a, const void*b)
+{
+  if (*(unsigned long long *)a < *(unsigned long long *)b) return -1;
+  if (*(unsigned long long *)a > *(unsigned long long *)b) return 1;
+  return 0;
+}
+
+
+int main(int argc, char **argv)
+{
+  unsigned char pk[CRYPTO_PUBLICKEYBYTES], sk[CRYPTO_SECRETKEYBYTES], sm[MERKLE_SIGNED_ROOT_BYTES];
+  unsigned char m1[MLEN], sm1[MLEN+CRYPTO_BYTES], mo1[MLEN+CRYPTO_BYTES];
+  unsigned char *records, *proofs;
+  const unsigned char **m;
+  unsigned long long *mlen, *sign_cycles, *verify_cycles, smlen, mo1len, t0, proof_bytes;
+  unsigned int *prooflen, nruns, maxn = batch_sizes[NSIZES-1], stride, n, i, r, s;
+  merkle_verifier_t v;
+
+  nruns = (argc > 1) ? (unsigned int)atoi(argv[1]) : NRUNS;
+  if (nruns == 0)
+    return -1;
+  records = malloc((size_t)maxn*MLEN);
+  proofs = malloc((size_t)maxn*merkle_proof_bytes(maxn));
+  m = malloc(maxn*sizeof(unsigned char *));
+  mlen = malloc(maxn*sizeof(unsigned long long));
+  prooflen = malloc(maxn*sizeof(unsigned int));
+  sign_cycles = malloc(nruns*sizeof(unsigned long long));
+  verify_cycles = malloc(nruns*sizeof(unsigned long long));
+  if (records == NULL || proofs == NULL || m == NULL || mlen == NULL || prooflen == NULL || sign_cycles == NULL || verify_cycles == NULL)
+    return -1;
+  for (i = 0; i < maxn; i++) {
+    m[i] = &records[(size_t)i*MLEN];
+    mlen[i] = MLEN;
+  }
+  crypto_sign_keypair(pk, sk);
+
+  printf("\n");
+  printf("===========================================================================================\n");
+  printf("Merkle batch signing for %s, %u-byte messages, %u runs per batch size\n", CRYPTO_ALGNAME, MLEN, nruns);
+  printf("===========================================================================================\n\n");
+  printf("batch    sign/msg (median ");
+  print_unit;
+  printf(")   verify/msg (median ");
+  print_unit;
+  printf(")   bytes/msg   proof bytes\n");
+
+  for (r = 0; r < nruns; r++) {
+    randombytes(m1, MLEN);
+    t0 = cpucycles();
+    crypto_sign(sm1, &smlen, m1, MLEN, sk);
+    sign_cycles[r] = cpucycles() - t0;
+    t0 = cpucycles();
+    if (crypto_sign_open(mo1, &mo1len, sm1, smlen, pk) != 0) {
+      printf("Signature verification FAILED. \n");
+      return -1;
+    }
+    verify_cycles[r] = cpucycles() - t0;
+  }
+  qsort(sign_cycles, nruns, sizeof(unsigned long long), cmp_llu);
+  qsort(verify_cycles, nruns, sizeof(unsigned long long), cmp_llu);
+  printf("%-8s %24llu %26llu %11u %13s\n", "none", sign_cycles[nruns/2], verify_cycles[nruns/2], CRYPTO_BYTES, "-");
+
+  for (s = 0; s < NSIZES; s++) {
+    n = batch_sizes[s];
+    stride = merkle_proof_bytes(n);
+    proof_bytes = 0;
+    for (r = 0; r < nruns; r++) {
+      randombytes(records, n*MLEN);
+      t0 = cpucycles();
+      merkle_sign_batch(sm, &smlen, proofs, prooflen, m, mlen, n, sk);
+      sign_cycles[r] = cpucycles() - t0;
+
+      merkle_verifier_init(&v, pk);
+      t0 = cpucycles();
+      for (i = 0; i < n; i++) {
+        if (merkle_verify(&v, m[i], mlen[i], &proofs[(size_t)i*stride], prooflen[i], sm, smlen) != 0) {
+          printf("Proof verification FAILED. \n");
+          return -1;
+        }
+      }
+      verify_cycles[r] = cpucycles() - t0;
+    }
+    for (i = 0; i < n; i++)
+      proof_bytes += prooflen[i];
+    qsort(sign_cycles, nruns, sizeof(unsigned long long), cmp_llu);
+    qsort(verify_cycles, nruns, sizeof(unsigned long long), cmp_llu);
+    printf("%-8u %24llu %26llu %11llu %13.1f\n", n, sign_cycles[nruns/2]/n, verify_cycles[nruns/2]/n,
+           (MERKLE_SIGNED_ROOT_BYTES + proof_bytes + n - 1)/n, (double)proof_bytes/n);
+  }
+  printf("\nbytes/msg is the signed root shared by the batch plus the proof of each message\n\n");
+
+  free(records); free(proofs); free(m); free(mlen); free(prooflen); free(sign_cycles); free(verify_cycles);
+  return 0;
+}
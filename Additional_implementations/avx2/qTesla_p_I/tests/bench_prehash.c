@@ -0,0 +1,92 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: throughput of the tree hash of prehash.c against the serial SHAKE
+*           hash of m that crypto_sign() runs
+*
+* Usage: bench_prehash [helpers]
+*        With "helpers" > 0, the tree hash is also measured with that many helper
+*        threads of parallel_for() (see parallel.h)
+**************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../random/random.h"
+#include "../api.h"
+#include "../params.h"
+#include "../prehash.h"
+#include "../parallel.h"
+#include "../sha3/fips202.h"
+#include "cpucycles.h"
+
+#define NRUNS 9
+#define NSIZES 4
+
+static const unsigned long long msg_sizes[NSIZES] = { 1ULL << 12, 1ULL << 16, 1ULL << 20, 1ULL << 24 };
+
+
+static int cmp_llu(const void *a, const void*b)
+{
+  if (*(unsigned long long *)a < *(unsigned long long *)b) return -1;
+  if (*(unsigned long long *)a > *(unsigned long long *)b) return 1;
+  return 0;
+}
+
+
+static double cycles_per_byte(const unsigned char *m, unsigned long long mlen, int tree)
+{ // Median over NRUNS runs
+  static _Alignas(CRYPTO_WORKSPACEALIGN) unsigned char ws[CRYPTO_WORKSPACEBYTES];
+  unsigned long long cycles[NRUNS], t0;
+  unsigned char hm[HM_BYTES];
+
+  for (unsigned int r = 0; r < NRUNS; r++) {
+    t0 = cpucycles();
+    if (tree)
+      qtesla_prehash_ws(hm, m, mlen, ws);
+    else
+      shake256(hm, HM_BYTES, m, mlen);
+    cycles[r] = cpucycles() - t0;
+  }
+  qsort(cycles, NRUNS, sizeof(unsigned long long), cmp_llu);
+  return (double)cycles[NRUNS/2]/(double)mlen;
+}
+
+
+int main(int argc, char **argv)
+{
+  unsigned int helpers = (argc > 1) ? (unsigned int)atoi(argv[1]) : 0;
+  unsigned long long maxlen = msg_sizes[NSIZES-1];
+  double serial, tree, threads = 0;
+  unsigned char *m;
+
+  m = malloc(maxlen);
+  if (m == NULL)
+    return -1;
+  randombytes(m, maxlen);
+
+  printf("\n");
+  printf("===========================================================================================\n");
+  printf("Prehash of %s (version %u, %u-byte leaves), median of %u runs, in ", CRYPTO_ALGNAME, QTESLA_PREHASH_VERSION, QTESLA_PREHASH_LEAF_BYTES, NRUNS);
+  print_unit;
+  printf(" per byte\n");
+  printf("===========================================================================================\n\n");
+  printf("bytes        SHAKE256   tree hash   tree hash, %u helpers\n", helpers);
+
+  for (unsigned int s = 0; s < NSIZES; s++) {
+    serial = cycles_per_byte(m, msg_sizes[s], 0);
+    tree = cycles_per_byte(m, msg_sizes[s], 1);
+    if (helpers > 0) {
+      if (parallel_enable(helpers, NULL) != 0) {
+        printf("Helper threads could not be started. \n");
+        return -1;
+      }
+      threads = cycles_per_byte(m, msg_sizes[s], 1);
+      parallel_disable();
+    }
+    printf("%-10llu %10.2f %11.2f %11.2f\n", msg_sizes[s], serial, tree, threads);
+  }
+  printf("\n");
+
+  free(m);
+  return 0;
+}
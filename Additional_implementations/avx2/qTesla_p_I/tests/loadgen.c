@@ -0,0 +1,317 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: open-loop load generator. Requests arrive on a fixed schedule, independent
+*           of when earlier ones complete, and each latency is measured from the time
+*           the request was due, so a stalled worker cannot hide the requests queued
+*           behind it (coordinated omission). Latencies go into HDR histograms, and
+*           signing latencies are broken down by rejection iterations
+*
+* Usage: loadgen [-op sign|verify] [-r rate] [-d seconds] [-t threads] [-poisson]
+*        -r requests per second (1000 by default) over -d seconds (5 by default),
+*        served by -t worker threads (1 by default); -poisson draws exponential
+*        inter-arrival times instead of evenly spaced ones
+**************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "../random/random.h"
+#include "../api.h"
+#include "../sign_step.h"
+
+#define MLEN 59
+#define NMESSAGES 64
+#define RATE 1000.0
+#define SECONDS 5.0
+#define MAX_ITERATIONS 32        // Signing latencies by iterations; the last row also counts larger values
+
+// HDR histogram of nanoseconds: values below 2^HDR_SUB_BITS are exact, larger ones fall in one of
+// 2^(HDR_SUB_BITS-1) buckets per power of two, so a reported value is within 1/128 of the true one
+#define HDR_SUB_BITS 8
+#define HDR_HALF (1U << (HDR_SUB_BITS-1))
+#define HDR_BUCKETS ((64-HDR_SUB_BITS+2)*HDR_HALF)
+
+typedef struct {
+  uint64_t count[HDR_BUCKETS];
+  uint64_t total, max;
+} hdr_t;
+
+typedef struct {
+  int verify;
+  uint64_t *due;             // Due time of each request, in ns from the start
+  unsigned int nrequests;
+  atomic_uint next;          // Next request to be served
+  uint64_t start;
+  unsigned char m[NMESSAGES][MLEN], sm[NMESSAGES][MLEN+CRYPTO_BYTES];
+  unsigned long long smlen[NMESSAGES];
+  unsigned char pk[CRYPTO_PUBLICKEYBYTES], sk[CRYPTO_SECRETKEYBYTES];
+  uint64_t *latency;         // Per request, for the breakdown by iterations
+  uint8_t *iterations;
+} load_t;
+
+typedef struct {
+  load_t *load;
+  hdr_t latency, service;    // From the due time, and from the actual start, of each request
+  int failed;
+} worker_t;
+
+
+static unsigned int hdr_index(uint64_t v)
+{
+  unsigned int shift;
+
+  if (v < 2*HDR_HALF)
+    return (unsigned int)v;
+  shift = (unsigned int)(63 - __builtin_clzll(v)) - (HDR_SUB_BITS-1);
+  return (shift+1)*HDR_HALF + (unsigned int)(v >> shift) - HDR_HALF;
+}
+
+
+static uint64_t hdr_value(unsigned int i)
+{ // Highest value that falls in bucket i
+  unsigned int shift;
+
+  if (i < 2*HDR_HALF)
+    return i;
+  shift = i/HDR_HALF - 1;
+  return ((uint64_t)(i % HDR_HALF + HDR_HALF + 1) << shift) - 1;
+}
+
+
+static void hdr_record(hdr_t *h, uint64_t v)
+{
+  h->count[hdr_index(v)]++;
+  h->total++;
+  if (v > h->max)
+    h->max = v;
+}
+
+
+static void hdr_merge(hdr_t *total, const hdr_t *h)
+{
+  for (unsigned int i = 0; i < HDR_BUCKETS; i++)
+    total->count[i] += h->count[i];
+  total->total += h->total;
+  if (h->max > total->max)
+    total->max = h->max;
+}
+
+
+static uint64_t hdr_percentile(const hdr_t *h, double p)
+{
+  uint64_t rank = (uint64_t)ceil(p/100*(double)h->total), seen = 0;
+
+  if (rank == 0)
+    rank = 1;
+  for (unsigned int i = 0; i < HDR_BUCKETS; i++) {
+    seen += h->count[i];
+    if (seen >= rank)
+      return (hdr_value(i) < h->max) ? hdr_value(i) : h->max;
+  }
+  return h->max;
+}
+
+
+static uint64_t time_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec*1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+
+static void wait_until(uint64_t t)
+{
+  struct timespec ts;
+
+  ts.tv_sec = (time_t)(t/1000000000ULL);
+  ts.tv_nsec = (long)(t%1000000000ULL);
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0);
+}
+
+
+static void *run_worker(void *arg)
+{ // Serves requests in arrival order, each no earlier than it is due
+  worker_t *w = arg;
+  load_t *l = w->load;
+  unsigned char sm[MLEN+CRYPTO_BYTES], mo[MLEN+CRYPTO_BYTES];
+  unsigned long long smlen, mlen;
+  uint64_t due, begin, end;
+  qtesla_sign_t st;
+  unsigned int i, j;
+  void *ws;
+
+  if (posix_memalign(&ws, CRYPTO_WORKSPACEALIGN, CRYPTO_WORKSPACEBYTES) != 0) {
+    w->failed = 1;
+    return NULL;
+  }
+  while ((i = atomic_fetch_add(&l->next, 1)) < l->nrequests) {
+    due = l->start + l->due[i];
+    if (time_ns() < due)
+      wait_until(due);
+    j = i % NMESSAGES;
+    begin = time_ns();
+    if (l->verify) {
+      w->failed |= (crypto_sign_open(mo, &mlen, l->sm[j], l->smlen[j], l->pk) != 0);
+    } else {
+      qtesla_sign_begin(&st, l->m[j], MLEN, l->sk, ws);
+      qtesla_sign_step(&st, 0);
+      w->failed |= (qtesla_sign_finish(&st, sm, &smlen) != 0);
+      l->iterations[i] = (uint8_t)((st.rejected_z + st.rejected_w + 1 < MAX_ITERATIONS) ? st.rejected_z + st.rejected_w + 1 : MAX_ITERATIONS);
+    }
+    end = time_ns();
+    hdr_record(&w->latency, end - due);
+    hdr_record(&w->service, end - begin);
+    l->latency[i] = end - due;
+  }
+  free(ws);
+  return NULL;
+}
+
+
+static int cmp_u64(const void *a, const void *b)
+{
+  if (*(const uint64_t *)a < *(const uint64_t *)b) return -1;
+  if (*(const uint64_t *)a > *(const uint64_t *)b) return 1;
+  return 0;
+}
+
+
+static void print_iterations(const load_t *l, uint64_t p99)
+{ // Latency by number of rejection iterations, and how the iterations of the requests above p99 compare
+  uint64_t *lat = malloc(l->nrequests*sizeof(uint64_t));
+  unsigned long long n, tail = 0, tail_sum = 0, sum = 0;
+  unsigned int it, i;
+
+  if (lat == NULL)
+    return;
+  for (i = 0; i < l->nrequests; i++) {
+    sum += l->iterations[i];
+    if (l->latency[i] >= p99) {
+      tail++;
+      tail_sum += l->iterations[i];
+    }
+  }
+  printf("\niterations   requests     share    p50 us    p99 us    max us   share of tail >= p99\n");
+  for (it = 1; it <= MAX_ITERATIONS; it++) {
+    for (i = 0, n = 0; i < l->nrequests; i++)
+      if (l->iterations[i] == it)
+        lat[n++] = l->latency[i];
+    if (n == 0)
+      continue;
+    qsort(lat, n, sizeof(uint64_t), cmp_u64);
+    for (i = 0; i < n && lat[i] < p99; i++);
+    printf("%s%-8u %10llu %8.2f%% %9.1f %9.1f %9.1f %10.2f%%\n", (it == MAX_ITERATIONS) ? ">=" : "  ", it, n, 100.0*n/l->nrequests,
+           lat[n/2]/1e3, lat[(size_t)(0.99*(n-1))]/1e3, lat[n-1]/1e3, (tail > 0) ? 100.0*(n-i)/tail : 0);
+  }
+  printf("\nMean iterations: %.2f over all requests, %.2f over the %llu requests at or above p99\n",
+         (double)sum/l->nrequests, (tail > 0) ? (double)tail_sum/tail : 0, tail);
+  free(lat);
+}
+
+
+int main(int argc, char **argv)
+{
+  static const double percentiles[] = { 50, 90, 99, 99.9, 99.99 };
+  double rate = RATE, seconds = SECONDS, t = 0;
+  unsigned int nthreads = 1, poisson = 0, i;
+  uint64_t r;
+  hdr_t *latency, *service;
+  pthread_t *threads;
+  worker_t *workers;
+  load_t *l;
+
+  l = calloc(1, sizeof(load_t));
+  if (l == NULL)
+    return -1;
+  for (i = 1; i < (unsigned int)argc; i++) {
+    if (strcmp(argv[i], "-op") == 0 && i+1 < (unsigned int)argc && (strcmp(argv[i+1], "sign") == 0 || strcmp(argv[i+1], "verify") == 0))
+      l->verify = (strcmp(argv[++i], "verify") == 0);
+    else if (strcmp(argv[i], "-r") == 0 && i+1 < (unsigned int)argc)
+      rate = atof(argv[++i]);
+    else if (strcmp(argv[i], "-d") == 0 && i+1 < (unsigned int)argc)
+      seconds = atof(argv[++i]);
+    else if (strcmp(argv[i], "-t") == 0 && i+1 < (unsigned int)argc)
+      nthreads = (unsigned int)atoi(argv[++i]);
+    else if (strcmp(argv[i], "-poisson") == 0)
+      poisson = 1;
+    else {
+      printf("Usage: %s [-op sign|verify] [-r rate] [-d seconds] [-t threads] [-poisson]\n", argv[0]);
+      return -1;
+    }
+  }
+  if (rate <= 0 || seconds <= 0 || nthreads == 0 || rate*seconds < 1 || rate*seconds > 1e8)
+    return -1;
+
+  // Arrival schedule, fixed before the run so that it does not depend on the service times
+  l->nrequests = (unsigned int)(rate*seconds);
+  l->due = malloc(l->nrequests*sizeof(uint64_t));
+  l->latency = malloc(l->nrequests*sizeof(uint64_t));
+  l->iterations = calloc(l->nrequests, 1);
+  threads = malloc(nthreads*sizeof(pthread_t));
+  workers = calloc(nthreads, sizeof(worker_t));
+  latency = calloc(1, sizeof(hdr_t));
+  service = calloc(1, sizeof(hdr_t));
+  if (!l->due || !l->latency || !l->iterations || !threads || !workers || !latency || !service)
+    return -1;
+  for (i = 0; i < l->nrequests; i++) {
+    l->due[i] = (uint64_t)(t*1e9);
+    if (poisson) {
+      randombytes((unsigned char *)&r, sizeof(r));
+      t += -log(((double)(r >> 11) + 1)/9007199254740992.0)/rate;   // Exponential, from a uniform in (0,1]
+    } else {
+      t += 1/rate;
+    }
+  }
+
+  crypto_sign_keypair(l->pk, l->sk);
+  for (i = 0; i < NMESSAGES; i++) {
+    randombytes(l->m[i], MLEN);
+    crypto_sign(l->sm[i], &l->smlen[i], l->m[i], MLEN, l->sk);
+  }
+
+  atomic_init(&l->next, 0);
+  l->start = time_ns() + 1000000;   // Leave the workers 1 ms to start
+  for (i = 0; i < nthreads; i++) {
+    workers[i].load = l;
+    if (pthread_create(&threads[i], NULL, run_worker, &workers[i]) != 0) {
+      printf("Thread creation FAILED. \n");
+      return -1;
+    }
+  }
+  for (i = 0; i < nthreads; i++) {
+    pthread_join(threads[i], NULL);
+    if (workers[i].failed) {
+      printf("Operation FAILED. \n");
+      return -1;
+    }
+    hdr_merge(latency, &workers[i].latency);
+    hdr_merge(service, &workers[i].service);
+  }
+  t = (time_ns() - l->start)/1e9;
+
+  printf("\n");
+  printf("===========================================================================================\n");
+  printf("Open-loop %s load on %s: %.0f requests/s (%s) for %.1f s, %u worker%s\n", l->verify ? "verify" : "sign", CRYPTO_ALGNAME,
+         rate, poisson ? "Poisson" : "uniform", seconds, nthreads, (nthreads > 1) ? "s" : "");
+  printf("===========================================================================================\n\n");
+  printf("%u requests completed in %.2f s (%.0f/s)\n\n", l->nrequests, t, l->nrequests/t);
+  printf("percentile     latency us    service us\n");
+  for (i = 0; i < sizeof(percentiles)/sizeof(percentiles[0]); i++)
+    printf("%9.2f %14.1f %13.1f\n", percentiles[i], hdr_percentile(latency, percentiles[i])/1e3, hdr_percentile(service, percentiles[i])/1e3);
+  printf("%9s %14.1f %13.1f\n", "max", latency->max/1e3, service->max/1e3);
+  printf("\nLatency is measured from the time each request was due, service from the time it started\n");
+  if (!l->verify)
+    print_iterations(l, hdr_percentile(latency, 99));
+  printf("\n");
+
+  free(l->due); free(l->latency); free(l->iterations); free(l);
+  free(threads); free(workers); free(latency); free(service);
+  return 0;
+}
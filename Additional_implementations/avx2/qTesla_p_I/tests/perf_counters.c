@@ -0,0 +1,127 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: hardware performance counters through perf_event_open
+**************************************************************************************/
+
+#include <string.h>
+#include "perf_counters.h"
+
+#if defined(__linux__)
+
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+static const struct {
+  uint32_t type;
+  uint64_t config;
+} events[PERF_NCOUNTERS] = {
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+  { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+};
+
+
+static int open_event(unsigned int i, int group)
+{
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = events[i].type;
+  attr.config = events[i].config;
+  attr.disabled = (group == -1);   // The leader starts disabled and the group follows it
+  attr.exclude_kernel = 1;         // Allowed with the default perf_event_paranoid setting
+  attr.exclude_hv = 1;
+  return (int)syscall(__NR_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+
+int perf_counters_open(perf_counters_t *pc)
+{
+  unsigned int i;
+  int n = 0;
+
+  pc->leader = -1;
+  for (i = 0; i < PERF_NCOUNTERS; i++) {
+    pc->fd[i] = open_event(i, pc->leader);
+    if (pc->fd[i] < 0) {
+      pc->fd[i] = -1;
+      continue;
+    }
+    if (pc->leader == -1)
+      pc->leader = pc->fd[i];
+    n++;
+  }
+  if (pc->leader != -1)
+    ioctl(pc->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  return n;
+}
+
+
+void perf_counters_start(perf_counters_t *pc)
+{
+  if (pc->leader != -1)
+    ioctl(pc->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+
+void perf_counters_stop(perf_counters_t *pc)
+{
+  if (pc->leader != -1)
+    ioctl(pc->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+}
+
+
+void perf_counters_read(perf_counters_t *pc, uint64_t value[PERF_NCOUNTERS], int available[PERF_NCOUNTERS])
+{
+  unsigned int i;
+
+  for (i = 0; i < PERF_NCOUNTERS; i++) {
+    value[i] = 0;
+    available[i] = (pc->fd[i] != -1 && read(pc->fd[i], &value[i], sizeof(uint64_t)) == sizeof(uint64_t));
+  }
+  if (pc->leader != -1)
+    ioctl(pc->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+}
+
+
+void perf_counters_close(perf_counters_t *pc)
+{
+  unsigned int i;
+
+  for (i = 0; i < PERF_NCOUNTERS; i++)
+    if (pc->fd[i] != -1)
+      close(pc->fd[i]);
+  pc->leader = -1;
+}
+
+#else
+
+int perf_counters_open(perf_counters_t *pc)
+{
+  for (unsigned int i = 0; i < PERF_NCOUNTERS; i++)
+    pc->fd[i] = -1;
+  pc->leader = -1;
+  return 0;
+}
+
+void perf_counters_start(perf_counters_t *pc) { (void)pc; }
+void perf_counters_stop(perf_counters_t *pc) { (void)pc; }
+
+void perf_counters_read(perf_counters_t *pc, uint64_t value[PERF_NCOUNTERS], int available[PERF_NCOUNTERS])
+{
+  (void)pc;
+  for (unsigned int i = 0; i < PERF_NCOUNTERS; i++) {
+    value[i] = 0;
+    available[i] = 0;
+  }
+}
+
+void perf_counters_close(perf_counters_t *pc) { (void)pc; }
+
+#endif
@@ -7,6 +7,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include "../random/random.h"
 #include "cpucycles.h"
 #include "../api.h"
@@ -16,17 +17,40 @@
 #include "../params.h"
 #include "../gauss.h"
 #include "../sha3/fips202.h"
+#include "../keypool.h"
+#include "../commitpool.h"
+#include "../merkle.h"
+#include "../prehash.h"
+#include "../verifycache.h"
+#include "../keystore.h"
+#include "../threadpool.h"
+#include "../parallel.h"
+#include "../sign_step.h"
+#include "../stats.h"
   
 #if (OS_TARGET == OS_LINUX)
   #include <sys/types.h>
   #include <sys/stat.h>
   #include <fcntl.h>
   #include <unistd.h>
+  #include <glob.h>
 #endif
 
 #define MLEN 59
 #define NRUNS 5000
 #define NTESTS 10000
+#define NKEYPOOL 64
+#define NCOMMITPOOL 64
+#define NMERKLE 37
+#define NPREHASH (12*QTESLA_PREHASH_LEAF_BYTES + 123)
+#define PREHASH_ROOT_INPUT_BYTES (19 + 13*QTESLA_PREHASH_CV_BYTES + 8)   // Header, chaining values of 13 leaves and length
+#define NVERIFYCACHE 40
+#define NKEYSTORE 3
+#define NTHREADPOOL 32
+#define NPARALLEL 64
+#define NSTREAM 64
+#define NSTEP 64
+#define NBOUNDED 64
 
 
 static int cmp_llu(const void *a, const void*b)
@@ -73,40 +97,46 @@ unsigned char pk[CRYPTO_PUBLICKEYBYTES];
 unsigned char sk[CRYPTO_SECRETKEYBYTES];
 unsigned long long smlen, mlen;
 
-extern unsigned long long rejwctr;
-extern unsigned long long rejyzctr;
-extern unsigned long long ctr_keygen;
-extern unsigned long long ctr_sign;
 
 
 #ifdef STATS  
 
 int print_accrates()
 {
-  int r;
-  double rejw=.0, rejyz=.0, rejctr=.0, rejctrkg=.0;
-  unsigned long long i, j;
+  static const char *phases[QTESLA_NPHASES] = { "gauss", "gen_a", "sample_y", "ntt/pmul", "hash_H", "encode_c", "sparse_mul", "checks", "packing" };
+  qtesla_stats_t st;
+  double rejw, rejyz, total = .0;
+  unsigned long long i;
 
-  for (i=0; i<NTESTS; i++){
+  qtesla_stats_reset();
+  for (i=0; i<NTESTS; i++)
     crypto_sign_keypair(pk, sk);
-    rejctrkg+=ctr_keygen;
-  }
+  qtesla_stats_snapshot(&st);
 
-  // Print acceptance rate for keygen. The counter increased by PARAM_K for each try
-  printf("Acceptance rate of Keygen : %.2f\n", (double)((PARAM_K+1)*NTESTS)/((double)rejctrkg)); fflush(stdout);
+  // Print acceptance rate for keygen. Each key pair samples PARAM_K+1 polynomials plus the rejected ones
+  printf("Acceptance rate of Keygen : %.2f\n", (double)((PARAM_K+1)*NTESTS)/((double)st.gauss_samples)); fflush(stdout);
  
+  qtesla_stats_reset();
   for (i=0; i<NTESTS; i++)
   {
     randombytes(mi, MLEN);
     crypto_sign(sm, &smlen, mi, MLEN, sk);    
-    rejctr+=ctr_sign;
-    rejw+=rejwctr;
-    rejyz+=rejyzctr;
   }
+  qtesla_stats_snapshot(&st);
+  rejw = (double)st.rejections[QTESLA_REJECT_W];
+  rejyz = (double)st.rejections[QTESLA_REJECT_Z];
   
   printf("Acceptance rate of v\t  : %.2f\n",1/((rejw/NTESTS)+1));
   printf("Acceptance rate of z\t  : %.2f\n",1/((rejyz/(NTESTS+rejw))+1));
-  printf("Acceptance rate of Signing: %.2f\n",(double)NTESTS/rejctr);
+  printf("Acceptance rate of Signing: %.2f\n",(double)NTESTS/st.sign_iterations);
+  printf("Signatures by rejections  :");
+  for (i=0; i<QTESLA_STATS_HIST; i++)
+    printf(" %llu", st.rejection_hist[QTESLA_REJECT_Z][i]);
+  printf(" (z)\n");
+  for (i=0; i<QTESLA_NPHASES; i++)
+    total += (double)st.cycles[i];
+  for (i=0; i<QTESLA_NPHASES; i++)
+    printf("  %-10s %5.1f%% of signing\n", phases[i], 100*(double)st.cycles[i]/total);
   printf("\n");
  
   return 0;
@@ -118,11 +148,13 @@ void test_functions()
   unsigned int i;
   unsigned long long cycles0[NRUNS];
   int nonce;
-  poly t, a, s, e, y, v, z;
+  poly s, e, y, z;
+  poly_k t, a, v;
   poly2x y_ntt;
   unsigned char randomness[CRYPTO_RANDOMBYTES]; 
   unsigned char c[CRYPTO_C_BYTES], seed[2*CRYPTO_SEEDBYTES], randomness_extended[4*CRYPTO_SEEDBYTES];
   unsigned char hm[HM_BYTES], ss[PARAM_N];
+  unsigned char uniform_buf[POLY_UNIFORM_BYTES], hash_buf[HASH_H_BYTES];
   unsigned char sk[CRYPTO_SECRETKEYBYTES];
   uint32_t pos_list[PARAM_H];
   int16_t sign_list[PARAM_H], ee[PARAM_N]; 
@@ -159,7 +191,7 @@ void test_functions()
 
   for (i = 0; i < NRUNS; i++) {
     cycles0[i] = cpucycles();
-    poly_uniform(a, randomness);
+    poly_uniform(a, randomness, uniform_buf);
     cycles0[i] = cpucycles() - cycles0[i];
   }
   print_results("GenA: ", cycles0, NRUNS);
@@ -174,7 +206,7 @@ void test_functions()
   
   for (i = 0; i < NRUNS; i++) {
     cycles0[i] = cpucycles();
-    hash_H(c, v, hm);
+    hash_H(c, v, hm, hash_buf);
     cycles0[i] = cpucycles() - cycles0[i];
   }
   print_results("H: ", cycles0, NRUNS);
@@ -274,6 +306,632 @@ void test_functions()
 #endif
 
 
+#ifdef REPLAY
+
+static int print_replay()
+{ // Signs NRUNS messages from the replay seed and prints the rejections and a digest of the signatures,
+  // which are the same in every run of a replay build. The benchmarks below then start again from the seed
+  const char *seed = getenv("QTESLA_REPLAY_SEED");
+  unsigned long long rejected_z = 0, rejected_w = 0, hist[QTESLA_STATS_HIST] = {0};
+  unsigned char digest[32+MLEN+CRYPTO_BYTES] = {0};
+  qtesla_sign_t st;
+  unsigned int i, n;
+  void *ws;
+
+  if (seed == NULL)
+    seed = RANDOMBYTES_REPLAY_SEED;
+  if (posix_memalign(&ws, CRYPTO_WORKSPACEALIGN, CRYPTO_WORKSPACEBYTES) != 0)
+    return -1;
+  randombytes_replay((const unsigned char *)seed, (unsigned int)strlen(seed));
+  crypto_sign_keypair(pk, sk);
+  for (i = 0; i < NRUNS; i++) {
+    randombytes(mi, MLEN);
+    qtesla_sign_begin(&st, mi, MLEN, sk, ws);
+    qtesla_sign_step(&st, 0);
+    qtesla_sign_finish(&st, &digest[32], &smlen);
+    shake128(digest, 32, digest, sizeof(digest));    // Chains the signatures into the digest
+    rejected_z += st.rejected_z;
+    rejected_w += st.rejected_w;
+    n = st.rejected_z + st.rejected_w;
+    hist[(n < QTESLA_STATS_HIST) ? n : QTESLA_STATS_HIST-1]++;
+  }
+  free(ws);
+  randombytes_replay((const unsigned char *)seed, (unsigned int)strlen(seed));
+
+  printf("REPLAY build, NOT for production: randomness is replayed from seed \"%s\"\n", seed);
+  printf("Replay profile of %d signatures: %llu iterations, %llu rejected on z, %llu on w\n", NRUNS, NRUNS+rejected_z+rejected_w, rejected_z, rejected_w);
+  printf("Signatures by rejections  :");
+  for (i = 0; i < QTESLA_STATS_HIST; i++)
+    printf(" %llu", hist[i]);
+  printf("\nDigest of the signatures  : ");
+  for (i = 0; i < 16; i++)
+    printf("%02x", digest[i]);
+  printf("\n\n");
+
+  return 0;
+}
+
+#endif
+
+
+static int test_keypool()
+{ // Draws key pairs from a pool refilled by background threads and checks that they work
+  keypool_t *pool;
+  keypool_stats_t stats;
+  unsigned int i;
+
+  if (keypool_create(16, 0, 2) != NULL) {   // A pool that never refills
+    printf("Key pool with no low watermark CREATED. \n");
+    return -1;
+  }
+  pool = keypool_create(16, 8, 2);
+  if (pool == NULL) {
+    printf("Key pool creation FAILED. \n");
+    return -1;
+  }
+  for (i = 0; i < NKEYPOOL; i++) {
+    randombytes(mi, MLEN);
+    keypool_get(pool, pk, sk);
+    crypto_sign(sm, &smlen, mi, MLEN, sk);
+    if (crypto_sign_open(mo, &mlen, sm, smlen, pk) != 0) {
+      printf("Signature verification with pooled key pair FAILED. \n");
+      keypool_destroy(pool);
+      return -1;
+    }
+  }
+  keypool_get_stats(pool, &stats);
+  keypool_destroy(pool);
+  
+  printf("Key pool tests PASSED... \n");
+  printf("served: %llu, misses: %llu, refill rate: %.1f key pairs/s\n\n", stats.served, stats.misses, stats.refill_rate);
+  return 0;
+}
+
+
+static int test_commitpool()
+{ // Signs with commitments precomputed by background threads and checks that the signatures verify
+  commitpool_t *pool;
+  commitpool_stats_t stats;
+  unsigned int i;
+
+  crypto_sign_keypair(pk, sk);
+  pool = commitpool_create(sk, 64, 32, 2);
+  if (pool == NULL) {
+    printf("Commitment pool creation FAILED. \n");
+    return -1;
+  }
+  for (i = 0; i < NCOMMITPOOL; i++) {
+    randombytes(mi, MLEN);
+    commitpool_sign(pool, sm, &smlen, mi, MLEN);
+    if (crypto_sign_open(mo, &mlen, sm, smlen, pk) != 0 || mlen != MLEN || memcmp(mo, mi, MLEN) != 0) {
+      printf("Signature verification with pooled commitments FAILED. \n");
+      commitpool_destroy(pool);
+      return -1;
+    }
+  }
+  commitpool_get_stats(pool, &stats);
+  commitpool_destroy(pool);
+  
+  printf("Commitment pool tests PASSED... \n");
+  printf("served: %llu, misses: %llu, commitments per signature: %.2f, refill rate: %.1f commitments/s\n\n", stats.served, stats.misses,
+         (double)(stats.served + stats.misses)/stats.signatures, stats.refill_rate);
+  return 0;
+}
+
+
+static int test_merkle()
+{ // Signs a batch of messages of different lengths with one signature and checks every proof, and some forgeries
+  static unsigned char m[NMERKLE][NMERKLE], proofs[NMERKLE*MERKLE_MAX_PROOF_BYTES], sm[MERKLE_SIGNED_ROOT_BYTES], sm2[MERKLE_SIGNED_ROOT_BYTES];
+  const unsigned char *mp[NMERKLE];
+  unsigned long long mlen[NMERKLE], smlen, sm2len;
+  unsigned int prooflen[NMERKLE], stride = merkle_proof_bytes(NMERKLE), i;
+  merkle_verifier_t v, v2;
+
+  crypto_sign_keypair(pk, sk);
+  for (i = 0; i < NMERKLE; i++) {
+    randombytes(m[i], i);
+    mp[i] = m[i];
+    mlen[i] = i;
+  }
+  if (merkle_sign_batch(sm, &smlen, proofs, prooflen, mp, mlen, NMERKLE, sk) != 0) {
+    printf("Batch signing FAILED. \n");
+    return -1;
+  }
+  merkle_verifier_init(&v, pk);
+  for (i = 0; i < NMERKLE; i++) {
+    if (merkle_verify(&v, mp[i], mlen[i], &proofs[i*stride], prooflen[i], sm, smlen) != 0) {
+      printf("Proof verification FAILED. \n");
+      return -1;
+    }
+  }
+  if (v.root_verifications != 1) {
+    printf("Signed root verified %llu times. \n", v.root_verifications);
+    return -1;
+  }
+
+  // Another message, the proof of another message and a corrupted signed root must all be rejected
+  if (merkle_verify(&v, mp[1], mlen[1], &proofs[2*stride], prooflen[2], sm, smlen) == 0 ||
+      merkle_verify(&v, mp[NMERKLE-1], mlen[NMERKLE-2], &proofs[(NMERKLE-1)*stride], prooflen[NMERKLE-1], sm, smlen) == 0) {
+    printf("Invalid proof VERIFIED. \n");
+    return -1;
+  }
+  // A signature of crypto_sign() over the root message must not pass for the signed root
+  crypto_sign(sm2, &sm2len, &sm[CRYPTO_BYTES], MERKLE_ROOT_MSG_BYTES, sk);
+  merkle_verifier_init(&v2, pk);
+  if (sm2len != MERKLE_SIGNED_ROOT_BYTES || merkle_verify(&v2, mp[0], mlen[0], &proofs[0], prooflen[0], sm2, sm2len) == 0) {
+    printf("Signature of crypto_sign() VERIFIED as a signed root. \n");
+    return -1;
+  }
+  sm[CRYPTO_BYTES + MERKLE_ROOT_MSG_BYTES - 1] ^= 1;
+  if (merkle_verify(&v, mp[0], mlen[0], &proofs[0], prooflen[0], sm, smlen) == 0) {
+    printf("Corrupted signed root VERIFIED. \n");
+    return -1;
+  }
+
+  printf("Merkle batch signing tests PASSED... \n");
+  printf("%u messages, proofs of %u bytes at most, %u-byte signed root\n\n", NMERKLE, stride, MERKLE_SIGNED_ROOT_BYTES);
+  return 0;
+}
+
+
+static int test_prehash()
+{ // Signs the prehash of a message of several leaves, checks its digest against the construction in prehash.h, 
+  // with and without helper threads, and checks some forgeries
+  static unsigned char m[NPREHASH], sm_root[CRYPTO_BYTES+PREHASH_ROOT_INPUT_BYTES], m_root[CRYPTO_BYTES+PREHASH_ROOT_INPUT_BYTES];
+  unsigned char hm[HM_BYTES], hm2[HM_BYTES], header[19] = "qTESLA prehash", len[8], sig[CRYPTO_BYTES], buf[SHAKE256_RATE];
+  static _Alignas(CRYPTO_WORKSPACEALIGN) unsigned char ws[CRYPTO_WORKSPACEBYTES];
+  unsigned char *root = &sm_root[CRYPTO_BYTES], *cv;
+  unsigned long long siglen, mrootlen, i, n;
+  uint64_t s[26];
+
+  crypto_sign_keypair(pk, sk);
+  randombytes(m, NPREHASH);
+  header[14] = QTESLA_PREHASH_VERSION;
+  for (i = 0; i < 4; i++)
+    header[15+i] = (unsigned char)(QTESLA_PREHASH_LEAF_BYTES >> 8*i);
+  for (i = 0; i < 8; i++)
+    len[i] = (unsigned char)((unsigned long long)NPREHASH >> 8*i);
+  // The input of the root is kept in "root", the message m* of a signed message sig || m* checked below
+  memcpy(root, header, sizeof(header));
+  cv = &root[sizeof(header)];
+  for (i = 0; i < NPREHASH; i += n, cv += QTESLA_PREHASH_CV_BYTES) {
+    n = (NPREHASH - i < QTESLA_PREHASH_LEAF_BYTES) ? NPREHASH - i : QTESLA_PREHASH_LEAF_BYTES;
+    cshake256_simple(cv, QTESLA_PREHASH_CV_BYTES, 0x4C00 | QTESLA_PREHASH_VERSION, &m[i], n);
+  }
+  memcpy(cv, len, sizeof(len));
+  cshake256_inc_init(s, 0x5200 | QTESLA_PREHASH_VERSION);
+  shake256_inc_absorb(s, root, PREHASH_ROOT_INPUT_BYTES);
+  cshake256_inc_finalize(s);
+  shake256_squeezeblocks(buf, 1, s);
+
+  qtesla_prehash_ws(hm, m, NPREHASH, ws);
+  if (parallel_enable(2, NULL) != 0) {
+    printf("Helper thread creation FAILED. \n");
+    return -1;
+  }
+  qtesla_prehash_ws(hm2, m, NPREHASH, ws);
+  parallel_disable();
+  if (memcmp(hm, buf, HM_BYTES) != 0 || memcmp(hm, hm2, HM_BYTES) != 0) {
+    printf("Prehash digest MISMATCH. \n");
+    return -1;
+  }
+
+  if (crypto_sign_prehash(sig, &siglen, m, NPREHASH, sk) != 0 || siglen != CRYPTO_BYTES || 
+      crypto_sign_open_prehash(sig, siglen, m, NPREHASH, pk) != 0) {
+    printf("Prehash signature verification FAILED. \n");
+    return -1;
+  }
+  // A change in the last leaf, a shorter message and a corrupted signature must all be rejected
+  m[NPREHASH-1] ^= 1;
+  if (crypto_sign_open_prehash(sig, siglen, m, NPREHASH, pk) == 0 || crypto_sign_open_prehash(sig, siglen, m, NPREHASH-1, pk) == 0) {
+    printf("Prehash signature of another message VERIFIED. \n");
+    return -1;
+  }
+  m[NPREHASH-1] ^= 1;
+  // Nor may the prehash signature pass as a crypto_sign() signature of the input of the root
+  memcpy(sm_root, sig, CRYPTO_BYTES);
+  if (crypto_sign_open(m_root, &mrootlen, sm_root, CRYPTO_BYTES+PREHASH_ROOT_INPUT_BYTES, pk) == 0) {
+    printf("Prehash signature VERIFIED by crypto_sign_open. \n");
+    return -1;
+  }
+  sig[0] ^= 1;
+  if (crypto_sign_open_prehash(sig, siglen, m, NPREHASH, pk) == 0) {
+    printf("Corrupted prehash signature VERIFIED. \n");
+    return -1;
+  }
+
+  printf("Prehash tests PASSED... \n");
+  printf("%u-byte message, %u leaves, version %u\n\n", NPREHASH, (NPREHASH + QTESLA_PREHASH_LEAF_BYTES - 1)/QTESLA_PREHASH_LEAF_BYTES, QTESLA_PREHASH_VERSION);
+  return 0;
+}
+
+
+static int test_verifycache()
+{ // Verifies signed messages through a small cache: repeated ones must hit, also through a public key handle, forgeries
+  // must never be stored, and a full cache must evict
+  static unsigned char m[NVERIFYCACHE][MLEN], smc[NVERIFYCACHE][MLEN+CRYPTO_BYTES], pk2[CRYPTO_PUBLICKEYBYTES], sk2[CRYPTO_SECRETKEYBYTES];
+  unsigned long long smclen = MLEN+CRYPTO_BYTES;
+  verifycache_pk_t key, key2;
+  verifycache_t *cache;
+  verifycache_stats_t stats;
+  unsigned int i, r;
+
+  crypto_sign_keypair(pk, sk);
+  crypto_sign_keypair(pk2, sk2);
+  randombytes(m[0], NVERIFYCACHE*MLEN);
+  for (i = 0; i < NVERIFYCACHE; i++)
+    crypto_sign(smc[i], &smclen, m[i], MLEN, sk);
+  cache = verifycache_create(16, 2);
+  if (cache == NULL) {
+    printf("Verification cache creation FAILED. \n");
+    return -1;
+  }
+
+  for (r = 0; r < 3; r++) {
+    for (i = 0; i < 8; i++) {
+      memset(mo, 0, MLEN);
+      if (verifycache_open(cache, mo, &mlen, smc[i], smclen, pk) != 0 || mlen != MLEN || memcmp(mo, m[i], MLEN) != 0) {
+        printf("Signature verification through the cache FAILED. \n");
+        verifycache_destroy(cache);
+        return -1;
+      }
+    }
+  }
+  verifycache_get_stats(cache, &stats);
+  if (stats.misses != 8 || stats.hits != 16 || stats.entries != 8) {
+    printf("Verification cache stored %u signatures for %llu misses. \n", stats.entries, stats.misses);
+    verifycache_destroy(cache);
+    return -1;
+  }
+
+  // A handle of pk finds the entries stored by verifycache_open(), and a handle of another key does not
+  verifycache_pk_init(&key, pk);
+  verifycache_pk_init(&key2, pk2);
+  for (i = 0; i < 8; i++) {
+    if (verifycache_open_pk(cache, mo, &mlen, smc[i], smclen, &key) != 0 || mlen != MLEN || memcmp(mo, m[i], MLEN) != 0) {
+      printf("Signature verification through a public key handle FAILED. \n");
+      verifycache_destroy(cache);
+      return -1;
+    }
+  }
+  if (verifycache_open_pk(cache, mo, &mlen, smc[0], smclen, &key2) == 0) {
+    printf("Cached signature VERIFIED under another public key handle. \n");
+    verifycache_destroy(cache);
+    return -1;
+  }
+  verifycache_get_stats(cache, &stats);
+  if (stats.misses != 9 || stats.hits != 24) {
+    printf("Public key handle hit %llu times in 8 lookups. \n", stats.hits - 16);
+    verifycache_destroy(cache);
+    return -1;
+  }
+
+  // A cached signature under another public key, and a corrupted signature seen twice, must be rejected every time
+  memcpy(sm, smc[0], smclen);
+  sm[0] ^= 1;
+  if (verifycache_open(cache, mo, &mlen, smc[0], smclen, pk2) == 0 || 
+      verifycache_open(cache, mo, &mlen, sm, smclen, pk) == 0 || verifycache_open(cache, mo, &mlen, sm, smclen, pk) == 0) {
+    printf("Invalid signature VERIFIED through the cache. \n");
+    verifycache_destroy(cache);
+    return -1;
+  }
+
+  for (i = 0; i < NVERIFYCACHE; i++)
+    verifycache_open(cache, mo, &mlen, smc[i], smclen, pk);
+  verifycache_get_stats(cache, &stats);
+  if (stats.rejected != 4 || stats.entries > stats.capacity || stats.evictions == 0) {
+    printf("Verification cache holds %u entries of %u after %llu evictions. \n", stats.entries, stats.capacity, stats.evictions);
+    verifycache_destroy(cache);
+    return -1;
+  }
+  verifycache_clear(cache);
+  verifycache_open(cache, mo, &mlen, smc[0], smclen, pk);
+  verifycache_get_stats(cache, &stats);
+  verifycache_destroy(cache);
+  if (stats.entries != 1) {
+    printf("Verification cache clearing FAILED. \n");
+    return -1;
+  }
+
+  printf("Verification cache tests PASSED... \n");
+  printf("hits: %llu, misses: %llu, hit rate: %.2f, hit: %.0f ns, verification: %.0f ns, saved: %.2f ms\n\n", stats.hits, stats.misses, 
+         stats.hit_rate, stats.hit_ns, stats.verify_ns, stats.saved_ns/1e6);
+  return 0;
+}
+
+
+static void flip_bit(const char *path, long offset)
+{
+  FILE *f = fopen(path, "r+b");
+  int c;
+
+  fseek(f, offset, SEEK_SET);
+  c = fgetc(f);
+  fseek(f, offset, SEEK_SET);
+  fputc(c ^ 1, f);
+  fclose(f);
+}
+
+
+static int test_keystore()
+{ // Writes a store of key pairs, one of them verification only, signs and verifies with the mapped keys, and checks that
+  // corrupted records and headers are rejected and that a stale "path.tmp" does not change the mode of the store
+  static unsigned char pks[NKEYSTORE][CRYPTO_PUBLICKEYBYTES], sks[NKEYSTORE][CRYPTO_SECRETKEYBYTES];
+  const unsigned char *pkp[NKEYSTORE], *skp[NKEYSTORE];
+  char path[] = "/tmp/qtesla-keystore-XXXXXX", tmp[sizeof(path) + 4], pattern[sizeof(path) + 2];
+  struct stat st;
+  glob_t g;
+  keystore_t *ks;
+  unsigned int i;
+  int fd, rsp = -1;
+
+  for (i = 0; i < NKEYSTORE; i++) {
+    crypto_sign_keypair(pks[i], sks[i]);
+    pkp[i] = pks[i];
+    skp[i] = sks[i];
+  }
+  fd = mkstemp(path);
+  if (fd < 0) {
+    printf("Key store file creation FAILED. \n");
+    return -1;
+  }
+  close(fd);
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL, 0644);
+  if (fd < 0 || fchmod(fd, 0644) != 0) {
+    printf("Key store file creation FAILED. \n");
+    goto out;
+  }
+  close(fd);
+  skp[0] = sks[1];
+  snprintf(pattern, sizeof(pattern), "%s.*", path);
+  if (keystore_write(path, pkp, skp, NKEYSTORE) == 0 || glob(pattern, 0, NULL, &g) != 0 || g.gl_pathc != 1) {
+    printf("Key store with mismatched key pair WRITTEN. \n");
+    goto out;
+  }
+  globfree(&g);
+  skp[0] = sks[0];
+  skp[NKEYSTORE-1] = NULL;
+  if (keystore_write(path, pkp, skp, NKEYSTORE) != 0 || stat(path, &st) != 0 || (st.st_mode & 0777) != 0600) {
+    printf("Key store writing FAILED, or the store is readable by others. \n");
+    goto out;
+  }
+  if ((ks = keystore_open(path, KEYSTORE_VERIFY_ALL | KEYSTORE_POPULATE)) == NULL) {
+    printf("Key store opening FAILED. \n");
+    goto out;
+  }
+
+  for (i = 0; i < NKEYSTORE; i++) {
+    randombytes(mi, MLEN);
+    if (i < NKEYSTORE-1) {
+      if (keystore_sign(ks, i, sm, &smlen, mi, MLEN) != 0 || crypto_sign_open(mo, &mlen, sm, smlen, pks[i]) != 0) {
+        printf("Signature with stored key FAILED. \n");
+        keystore_close(ks);
+        goto out;
+      }
+    } else if (keystore_sign(ks, i, sm, &smlen, mi, MLEN) == 0) {
+      printf("Signature with verification-only key ACCEPTED. \n");
+      keystore_close(ks);
+      goto out;
+    }
+    crypto_sign(sm, &smlen, mi, MLEN, sks[i]);
+    if (keystore_verify(ks, i, mo, &mlen, sm, smlen) != 0 || mlen != MLEN || memcmp(mo, mi, MLEN) != 0) {
+      printf("Signature verification with stored key FAILED. \n");
+      keystore_close(ks);
+      goto out;
+    }
+    sm[i] ^= 1;
+    if (keystore_verify(ks, i, mo, &mlen, sm, smlen) == 0 || keystore_verify(ks, (i+1) % NKEYSTORE, mo, &mlen, sm, smlen) == 0) {
+      printf("Invalid signature VERIFIED with stored key. \n");
+      keystore_close(ks);
+      goto out;
+    }
+  }
+  // Rewriting the store replaces the file, so the mapping of the open store stays valid
+  crypto_sign(sm, &smlen, mi, MLEN, sks[0]);
+  if (keystore_write(path, pkp, skp, NKEYSTORE) != 0 || keystore_verify(ks, 0, mo, &mlen, sm, smlen) != 0) {
+    printf("Key store rewrite under an open store FAILED. \n");
+    keystore_close(ks);
+    goto out;
+  }
+  keystore_close(ks);
+
+  // A corrupted record is only rejected when used, unless the whole store is checked when opening
+  flip_bit(path, KEYSTORE_DATA_OFFSET + sizeof(keystore_record_t) + 100);
+  ks = keystore_open(path, 0);
+  if (ks == NULL || keystore_get(ks, 1) != NULL || keystore_get(ks, 0) == NULL || keystore_verify(ks, 1, mo, &mlen, sm, smlen) == 0) {
+    printf("Corrupted key store record ACCEPTED. \n");
+    if (ks != NULL)
+      keystore_close(ks);
+    goto out;
+  }
+  keystore_close(ks);
+  flip_bit(path, 20);
+  if (keystore_open(path, KEYSTORE_VERIFY_ALL) != NULL || keystore_open(path, 0) != NULL) {
+    printf("Corrupted key store OPENED. \n");
+    goto out;
+  }
+  rsp = 0;
+  printf("Key store tests PASSED... \n");
+  printf("%u keys, %u-byte records\n\n", NKEYSTORE, (unsigned int)sizeof(keystore_record_t));
+
+out:
+  unlink(path);
+  unlink(tmp);
+  return rsp;
+}
+
+
+static int test_threadpool()
+{ // Signs and verifies a batch of messages on a thread pool
+  static unsigned char m[NTHREADPOOL][MLEN], sm[NTHREADPOOL][MLEN+CRYPTO_BYTES], mo[NTHREADPOOL][MLEN+CRYPTO_BYTES];
+  unsigned long long smlen[NTHREADPOOL], mlen[NTHREADPOOL];
+  int res[NTHREADPOOL];
+  threadpool_t *pool;
+  threadpool_batch_t batch;
+  unsigned int i;
+
+  pool = threadpool_create(2, 0);
+  if (pool == NULL) {
+    printf("Thread pool creation FAILED. \n");
+    return -1;
+  }
+  crypto_sign_keypair(pk, sk);
+  randombytes(m[0], NTHREADPOOL*MLEN);
+
+  threadpool_batch_init(&batch);
+  for (i = 0; i < NTHREADPOOL; i++)
+    threadpool_submit_sign(pool, &batch, sm[i], &smlen[i], m[i], MLEN, sk, NULL);
+  threadpool_wait(pool, &batch);
+  for (i = 0; i < NTHREADPOOL; i++)
+    threadpool_submit_open(pool, &batch, mo[i], &mlen[i], sm[i], smlen[i], pk, &res[i]);
+  threadpool_wait(pool, &batch);
+  threadpool_destroy(pool);
+
+  for (i = 0; i < NTHREADPOOL; i++) {
+    if (res[i] != 0 || mlen[i] != MLEN || memcmp(m[i], mo[i], MLEN) != 0) {
+      printf("Batch signature verification FAILED. \n");
+      return -1;
+    }
+  }
+  printf("Thread pool tests PASSED... \n\n");
+  return 0;
+}
+
+
+static int test_parallel()
+{ // Runs key generation, signing and verification with helper threads splitting the loops over the K polynomials
+  unsigned int i;
+
+  if (parallel_enable(2, NULL) != 0) {
+    printf("Helper thread creation FAILED. \n");
+    return -1;
+  }
+  for (i = 0; i < NPARALLEL; i++) {
+    randombytes(mi, MLEN);
+    crypto_sign_keypair(pk, sk);
+    crypto_sign(sm, &smlen, mi, MLEN, sk);
+    if (crypto_sign_open(mo, &mlen, sm, smlen, pk) != 0 || mlen != MLEN || memcmp(mi, mo, MLEN) != 0) {
+      printf("Signature verification with helper threads FAILED. \n");
+      parallel_disable();
+      return -1;
+    }
+    sm[i % CRYPTO_BYTES] ^= 1;
+    if (crypto_sign_open(mo, &mlen, sm, smlen, pk) == 0) {
+      printf("Corrupted signature VERIFIED with helper threads. \n");
+      parallel_disable();
+      return -1;
+    }
+  }
+  parallel_disable();
+
+  printf("Parallel loop tests PASSED... \n\n");
+  return 0;
+}
+
+
+static int test_stream()
+{ // Signs with crypto_sign_stream_ws, reusing one workspace, and verifies with crypto_sign_open
+  void *ws;
+  unsigned int i;
+
+  if (posix_memalign(&ws, CRYPTO_WORKSPACEALIGN, CRYPTO_STREAM_WORKSPACEBYTES) != 0)
+    return -1;
+  for (i = 0; i < NSTREAM; i++) {
+    randombytes(mi, MLEN);
+    crypto_sign_keypair(pk, sk);
+    crypto_sign_stream_ws(sm, &smlen, mi, MLEN, sk, ws);
+    if (crypto_sign_open(mo, &mlen, sm, smlen, pk) != 0 || mlen != MLEN || memcmp(mi, mo, MLEN) != 0) {
+      printf("Streaming signature verification FAILED. \n");
+      free(ws);
+      return -1;
+    }
+    sm[i % CRYPTO_BYTES] ^= 1;
+    if (crypto_sign_open(mo, &mlen, sm, smlen, pk) == 0) {
+      printf("Corrupted streaming signature VERIFIED. \n");
+      free(ws);
+      return -1;
+    }
+  }
+  free(ws);
+
+  printf("Streaming signature tests PASSED... \n\n");
+  return 0;
+}
+
+
+static int test_step()
+{ // Signs one rejection iteration at a time with qtesla_sign_step and verifies with crypto_sign_open
+  qtesla_sign_t st;
+  void *ws;
+  unsigned int i, steps;
+
+  if (posix_memalign(&ws, CRYPTO_WORKSPACEALIGN, CRYPTO_WORKSPACEBYTES) != 0)
+    return -1;
+  for (i = 0; i < NSTEP; i++) {
+    randombytes(mi, MLEN);
+    crypto_sign_keypair(pk, sk);
+    qtesla_sign_begin(&st, mi, MLEN, sk, ws);
+    for (steps = 1; qtesla_sign_step(&st, 1) == QTESLA_SIGN_AGAIN; steps++) {
+      if (qtesla_sign_finish(&st, sm, &smlen) == 0) {
+        printf("Unfinished step-wise signature RETURNED. \n");
+        free(ws);
+        return -1;
+      }
+    }
+    if (steps != (unsigned int)st.nonce || qtesla_sign_finish(&st, sm, &smlen) != 0 ||
+        crypto_sign_open(mo, &mlen, sm, smlen, pk) != 0 || mlen != MLEN || memcmp(mi, mo, MLEN) != 0) {
+      printf("Step-wise signature verification FAILED. \n");
+      free(ws);
+      return -1;
+    }
+  }
+  free(ws);
+
+  printf("Step-wise signature tests PASSED... \n\n");
+  return 0;
+}
+
+
+static int test_bounded()
+{ // Signs with an expired deadline and with a budget of one iteration, resumes and verifies. Also forces the nonce ceiling
+  qtesla_sign_t st;
+  void *ws;
+  unsigned int i;
+  int res;
+
+  if (posix_memalign(&ws, CRYPTO_WORKSPACEALIGN, CRYPTO_WORKSPACEBYTES) != 0)
+    return -1;
+  for (i = 0; i < NBOUNDED; i++) {
+    randombytes(mi, MLEN);
+    crypto_sign_keypair(pk, sk);
+    if (qtesla_sign_bounded(sm, &smlen, mi, MLEN, sk, &st, ws, 0, 1) != QTESLA_SIGN_AGAIN || st.nonce != 0) {
+      printf("Signing with an expired deadline RAN. \n");
+      free(ws);
+      return -1;
+    }
+    res = qtesla_sign_bounded(sm, &smlen, mi, MLEN, sk, &st, ws, 1, 0);
+    if (res == QTESLA_SIGN_AGAIN) {
+      if (i % 2 == 0)
+        st.nonce = QTESLA_SIGN_NONCE_LIMIT;   // As if all nonces had been rejected
+      res = (qtesla_sign_step_deadline(&st, 0, qtesla_time_ns() + 60000000000ULL) == 0) ? qtesla_sign_finish(&st, sm, &smlen) : -1;
+      if (i % 2 == 0 && st.restarts != 1)
+        res = -1;
+    }
+    if (res != 0 || st.nonce > QTESLA_SIGN_NONCE_LIMIT || crypto_sign_open(mo, &mlen, sm, smlen, pk) != 0 ||
+        mlen != MLEN || memcmp(mi, mo, MLEN) != 0) {
+      printf("Bounded signature verification FAILED. \n");
+      free(ws);
+      return -1;
+    }
+  }
+  free(ws);
+
+  printf("Bounded signature tests PASSED... \n\n");
+  return 0;
+}
+
+
 int main(void)
 {
   unsigned int i, j;
@@ -290,6 +948,10 @@ int main(void)
   printf("CRYPTO_SECRETKEY_BYTES: %d\n", (int)CRYPTO_SECRETKEYBYTES);
   printf("CRYPTO_SIGNATURE_BYTES: %d\n\n", CRYPTO_BYTES);
 
+#ifdef REPLAY
+  if (print_replay() != 0)
+    return -1;
+#endif
 #ifdef STATS
   print_accrates();
   test_functions();
@@ -346,6 +1008,9 @@ int main(void)
   }
   printf("Signature tests PASSED... \n\n");
 
+  if (test_keypool() != 0 || test_commitpool() != 0 || test_merkle() != 0 || test_prehash() != 0 || test_verifycache() != 0 || test_keystore() != 0 || test_threadpool() != 0 || test_parallel() != 0 || test_stream() != 0 || test_step() != 0 || test_bounded() != 0)
+    return -1;
+
   print_results("qTESLA keygen: ", cycles0, NRUNS);
   print_results("qTESLA sign: ", cycles1, NRUNS);
   print_results("qTESLA verify: ", cycles2, NRUNS);
@@ -0,0 +1,287 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: bounded, sharded cache of verified signatures, for verifiers that see the
+*           same signed messages many times
+*
+* An entry is the SHAKE256 digest of H(m), the SHAKE256 digest of the public key and the
+* signature, so another triple can only hit it through a collision of SHAKE256 or of H.
+* Callers that hold a verifycache_pk_t hash the public key once, not on every lookup. H(m) is
+* the hash that verification computes anyway, and a miss passes it to qtesla_verify_hm()
+* so that m is hashed once. The first bytes of the digest pick the shard and the set
+* of VERIFYCACHE_WAYS entries that may hold it, so a lookup compares at most that many
+* entries under the lock of one shard.
+**************************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "api.h"
+#include "params.h"
+#include "sign_step.h"
+#include "verifycache.h"
+#include "sha3/fips202.h"
+
+typedef struct {
+  unsigned char key[VERIFYCACHE_KEY_BYTES];
+  uint64_t used;   // Time of the last hit or insertion in the clock of the shard; 0 if the entry is empty
+} verifycache_entry_t;
+
+typedef struct {
+  _Alignas(64) pthread_mutex_t lock;   // Shards sit on separate cache lines
+  verifycache_entry_t *entries;
+  uint64_t clock;
+  unsigned int fill;
+} verifycache_shard_t;
+
+struct verifycache {
+  verifycache_shard_t *shards;
+  unsigned int nshards, nsets;   // Sets per shard
+  atomic_ullong hits, misses, rejected, evictions, hit_ns, verify_ns;
+};
+
+
+static uint32_t load32(const unsigned char *p)
+{
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+
+verifycache_t *verifycache_create(unsigned int capacity, unsigned int nshards)
+{
+  verifycache_t *cache;
+  unsigned int i, n = 1;
+
+  if (capacity == 0 || nshards == 0 || nshards > (1U << 16))
+    return NULL;
+  while (n < nshards)
+    n <<= 1;
+  cache = calloc(1, sizeof(verifycache_t));
+  if (cache == NULL)
+    return NULL;
+  cache->nshards = n;
+  cache->nsets = (capacity + n*VERIFYCACHE_WAYS - 1)/(n*VERIFYCACHE_WAYS);
+  if (posix_memalign((void **)&cache->shards, 64, n*sizeof(verifycache_shard_t)) != 0) {
+    free(cache);
+    return NULL;
+  }
+  for (i = 0; i < n; i++) {
+    cache->shards[i].entries = calloc((size_t)cache->nsets*VERIFYCACHE_WAYS, sizeof(verifycache_entry_t));
+    if (cache->shards[i].entries == NULL) {
+      cache->nshards = i;
+      verifycache_destroy(cache);
+      return NULL;
+    }
+    pthread_mutex_init(&cache->shards[i].lock, NULL);
+    cache->shards[i].clock = 0;
+    cache->shards[i].fill = 0;
+  }
+  return cache;
+}
+
+
+static verifycache_entry_t *find_set(verifycache_t *cache, const unsigned char *key, verifycache_shard_t **shard)
+{
+  *shard = &cache->shards[load32(key) & (cache->nshards - 1)];
+  return &(*shard)->entries[(size_t)(load32(&key[4]) % cache->nsets)*VERIFYCACHE_WAYS];
+}
+
+
+static int lookup(verifycache_t *cache, const unsigned char *key)
+{ // Returns 1 and marks the entry as used if key is stored
+  verifycache_shard_t *shard;
+  verifycache_entry_t *set = find_set(cache, key, &shard);
+  int found = 0;
+
+  pthread_mutex_lock(&shard->lock);
+  for (unsigned int i = 0; i < VERIFYCACHE_WAYS; i++) {
+    if (set[i].used != 0 && memcmp(set[i].key, key, VERIFYCACHE_KEY_BYTES) == 0) {
+      set[i].used = ++shard->clock;
+      found = 1;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&shard->lock);
+  return found;
+}
+
+
+static void insert(verifycache_t *cache, const unsigned char *key)
+{ // Stores key in an empty entry of its set, or else in place of the least recently used one
+  verifycache_shard_t *shard;
+  verifycache_entry_t *set = find_set(cache, key, &shard), *victim = &set[0];
+
+  pthread_mutex_lock(&shard->lock);
+  for (unsigned int i = 0; i < VERIFYCACHE_WAYS; i++) {
+    if (set[i].used != 0 && memcmp(set[i].key, key, VERIFYCACHE_KEY_BYTES) == 0) {
+      victim = NULL;   // Another thread verified the same signature meanwhile
+      break;
+    }
+    if (set[i].used < victim->used)
+      victim = &set[i];
+  }
+  if (victim != NULL) {
+    if (victim->used != 0)
+      atomic_fetch_add(&cache->evictions, 1);
+    else
+      shard->fill++;
+    memcpy(victim->key, key, VERIFYCACHE_KEY_BYTES);
+    victim->used = ++shard->clock;
+  }
+  pthread_mutex_unlock(&shard->lock);
+}
+
+
+void verifycache_pk_init(verifycache_pk_t *key, const unsigned char *pk)
+{
+  key->pk = pk;
+  shake256(key->digest, VERIFYCACHE_PK_DIGEST_BYTES, pk, CRYPTO_PUBLICKEYBYTES);
+}
+
+
+static int cached_open(verifycache_t *cache, unsigned char *m, unsigned long long *mlen, const unsigned char *sm, unsigned long long smlen, 
+                       const verifycache_pk_t *key, void *ws, unsigned long long t0)
+{ // Looks up or verifies sm under key; t0 is the time the caller started, so that a hit also pays for hashing pk if the caller did
+  unsigned char hm[HM_BYTES], entry[VERIFYCACHE_KEY_BYTES], buf[SHAKE256_RATE];
+  uint64_t s[26];
+  int rsp;
+
+  SHAKE(hm, HM_BYTES, &sm[CRYPTO_BYTES], smlen-CRYPTO_BYTES);
+  shake256_inc_init(s);
+  shake256_inc_absorb(s, hm, HM_BYTES);
+  shake256_inc_absorb(s, key->digest, VERIFYCACHE_PK_DIGEST_BYTES);
+  shake256_inc_absorb(s, sm, CRYPTO_BYTES);
+  shake256_inc_finalize(s);
+  shake256_squeezeblocks(buf, 1, s);
+  memcpy(entry, buf, VERIFYCACHE_KEY_BYTES);
+
+  if (lookup(cache, entry)) {
+    rsp = 0;
+    atomic_fetch_add(&cache->hits, 1);
+    atomic_fetch_add(&cache->hit_ns, qtesla_time_ns() - t0);
+  } else {
+    rsp = qtesla_verify_hm(sm, CRYPTO_BYTES, hm, key->pk, ws);
+    if (rsp == 0)
+      insert(cache, entry);
+    else
+      atomic_fetch_add(&cache->rejected, 1);
+    atomic_fetch_add(&cache->misses, 1);
+    atomic_fetch_add(&cache->verify_ns, qtesla_time_ns() - t0);
+  }
+  if (rsp != 0)
+    return rsp;
+
+  *mlen = smlen-CRYPTO_BYTES;
+  memmove(m, &sm[CRYPTO_BYTES], *mlen);
+  return 0;
+}
+
+
+/************************************************************
+* Name:        verifycache_open_ws
+* Description: verification of a signature sm, skipped if the
+*              cache holds it for pk
+* Parameters:  inputs:
+*              - verifycache_t *cache: cache, or NULL
+*              - const unsigned char *sm: signed message
+*              - unsigned long long smlen: signed message length
+*              - const unsigned char* pk: public Key
+*              - void *ws: workspace of CRYPTO_WORKSPACEBYTES bytes
+*              outputs:
+*              - unsigned char *m: original (signed) message
+*              - unsigned long long *mlen: message length*
+* Returns:     0 for valid signature
+*              <0 for invalid signature
+************************************************************/
+int verifycache_open_ws(verifycache_t *cache, unsigned char *m, unsigned long long *mlen, const unsigned char *sm, unsigned long long smlen, 
+                        const unsigned char *pk, void *ws)
+{
+  verifycache_pk_t key;
+  unsigned long long t0;
+
+  if (cache == NULL)
+    return crypto_sign_open_ws(m, mlen, sm, smlen, pk, ws);
+  if (smlen < CRYPTO_BYTES)
+    return -1;
+
+  t0 = qtesla_time_ns();
+  verifycache_pk_init(&key, pk);
+  return cached_open(cache, m, mlen, sm, smlen, &key, ws, t0);
+}
+
+
+int verifycache_open_pk_ws(verifycache_t *cache, unsigned char *m, unsigned long long *mlen, const unsigned char *sm, unsigned long long smlen, 
+                           const verifycache_pk_t *key, void *ws)
+{
+  if (cache == NULL)
+    return crypto_sign_open_ws(m, mlen, sm, smlen, key->pk, ws);
+  if (smlen < CRYPTO_BYTES)
+    return -1;
+  return cached_open(cache, m, mlen, sm, smlen, key, ws, qtesla_time_ns());
+}
+
+
+int verifycache_open(verifycache_t *cache, unsigned char *m, unsigned long long *mlen, const unsigned char *sm, unsigned long long smlen, const unsigned char *pk)
+{
+  _Alignas(CRYPTO_WORKSPACEALIGN) unsigned char ws[CRYPTO_WORKSPACEBYTES];
+
+  return verifycache_open_ws(cache, m, mlen, sm, smlen, pk, ws);
+}
+
+
+int verifycache_open_pk(verifycache_t *cache, unsigned char *m, unsigned long long *mlen, const unsigned char *sm, unsigned long long smlen, 
+                        const verifycache_pk_t *key)
+{
+  _Alignas(CRYPTO_WORKSPACEALIGN) unsigned char ws[CRYPTO_WORKSPACEBYTES];
+
+  return verifycache_open_pk_ws(cache, m, mlen, sm, smlen, key, ws);
+}
+
+
+void verifycache_clear(verifycache_t *cache)
+{
+  for (unsigned int i = 0; i < cache->nshards; i++) {
+    pthread_mutex_lock(&cache->shards[i].lock);
+    memset(cache->shards[i].entries, 0, (size_t)cache->nsets*VERIFYCACHE_WAYS*sizeof(verifycache_entry_t));
+    cache->shards[i].fill = 0;
+    pthread_mutex_unlock(&cache->shards[i].lock);
+  }
+}
+
+
+void verifycache_get_stats(verifycache_t *cache, verifycache_stats_t *stats)
+{
+  unsigned long long hit_ns = atomic_load(&cache->hit_ns), verify_ns = atomic_load(&cache->verify_ns);
+  unsigned int i;
+
+  stats->capacity = cache->nshards*cache->nsets*VERIFYCACHE_WAYS;
+  stats->nshards = cache->nshards;
+  stats->entries = 0;
+  for (i = 0; i < cache->nshards; i++) {
+    pthread_mutex_lock(&cache->shards[i].lock);
+    stats->entries += cache->shards[i].fill;
+    pthread_mutex_unlock(&cache->shards[i].lock);
+  }
+  stats->hits = atomic_load(&cache->hits);
+  stats->misses = atomic_load(&cache->misses);
+  stats->rejected = atomic_load(&cache->rejected);
+  stats->evictions = atomic_load(&cache->evictions);
+  stats->hit_rate = (stats->hits + stats->misses != 0) ? (double)stats->hits/(double)(stats->hits + stats->misses) : 0.0;
+  stats->hit_ns = (stats->hits != 0) ? (double)hit_ns/(double)stats->hits : 0.0;
+  // A miss that verifies also pays for the lookup, so this slightly overestimates a plain crypto_sign_open()
+  stats->verify_ns = (stats->misses != 0) ? (double)verify_ns/(double)stats->misses : 0.0;
+  stats->saved_ns = (stats->hits != 0 && stats->verify_ns > stats->hit_ns) ? (double)stats->hits*(stats->verify_ns - stats->hit_ns) : 0.0;
+}
+
+
+void verifycache_destroy(verifycache_t *cache)
+{
+  for (unsigned int i = 0; i < cache->nshards; i++) {
+    pthread_mutex_destroy(&cache->shards[i].lock);
+    free(cache->shards[i].entries);
+  }
+  free(cache->shards);
+  free(cache);
+}
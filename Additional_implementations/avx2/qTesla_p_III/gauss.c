@@ -5,32 +5,102 @@
 **************************************************************************************/
 
 #include <string.h>
+#include <stdatomic.h>
 #include "api.h"
 #include "sha3/fips202.h"
+#include "sha3/fips202x8.h"
 #include "gauss.h"
+#include "parallel.h"
 #include "CDT32.h"
 
+typedef struct {
+    int32_t **z;
+    const int32_t *samp;
+    int (*check)(poly, unsigned int);
+    const unsigned int *bound;
+    atomic_uint first_reject;
+} gauss_batch_t;
 
-void sample_gauss_poly(poly z, const unsigned char *seed, int nonce)
-{
-    int dmsp = nonce<<8;
-    int32_t samp[CHUNK_SIZE*CDT_COLS], c[CDT_COLS], borrow, sign;
+_Static_assert(GAUSS_BATCH_BYTES == GAUSS_BATCH*PARAM_N*CDT_COLS*sizeof(int32_t), "GAUSS_BATCH_BYTES does not match CDT32.h");
+
+
+static void sample_gauss_chunk(int32_t *z, const int32_t *samp)
+{ // CDT sampling of CHUNK_SIZE coefficients from CHUNK_SIZE*CDT_COLS random words
+    int32_t c[CDT_COLS], borrow, sign, zi;
     const int32_t mask = (int32_t)((uint32_t)(-1) >> 1);
-  
-    for (int chunk = 0; chunk < PARAM_N; chunk += CHUNK_SIZE) {
-        cSHAKE((uint8_t *)samp, CHUNK_SIZE*CDT_COLS*sizeof(int32_t), (int16_t)dmsp++, seed, CRYPTO_RANDOMBYTES);
-        for (int i = 0; i < CHUNK_SIZE; i++) {
-            z[chunk+i] = 0;
-            for (int j = 1; j < CDT_ROWS; j++) {
-                borrow = 0;
-                for (int k = CDT_COLS-1; k >= 0; k--) {
-                    c[k] = (samp[i*CDT_COLS+k] & mask) - (cdt_v[j*CDT_COLS+k] + borrow);
-                    borrow = c[k] >> (RADIX32-1);
-                }
-                z[chunk+i] += ~borrow & 1;
+
+    for (int i = 0; i < CHUNK_SIZE; i++) {
+        zi = 0;
+        for (int j = 1; j < CDT_ROWS; j++) {
+            borrow = 0;
+            for (int k = CDT_COLS-1; k >= 0; k--) {
+                c[k] = (samp[i*CDT_COLS+k] & mask) - (cdt_v[j*CDT_COLS+k] + borrow);
+                borrow = c[k] >> (RADIX32-1);
             }
-            sign = samp[i*CDT_COLS] >> (RADIX32-1); 
-            z[chunk+i] = (sign & -z[chunk+i]) | (~sign & z[chunk+i]);
+            zi += ~borrow & 1;
         }
+        sign = samp[i*CDT_COLS] >> (RADIX32-1); 
+        z[i] = (sign & -zi) | (~sign & zi);
+    }
+}
+
+
+static void sample_gauss_expand(int32_t *samp, const unsigned char *seed[], int nonce, unsigned int n)
+{ // Expands the randomness of n <= GAUSS_BATCH polynomials, where polynomial j uses seed[j] and the domain 
+  // separator nonce+j. The chunks of all polynomials are independent cSHAKE instances and are computed at once
+    unsigned char *out[GAUSS_BATCH*GAUSS_CHUNKS];
+    const unsigned char *in[GAUSS_BATCH*GAUSS_CHUNKS];
+    uint16_t cstm[GAUSS_BATCH*GAUSS_CHUNKS];
+    unsigned int j, k, l = 0;
+
+    for (j = 0; j < n; j++) {
+        int dmsp = (nonce+j)<<8;
+        for (k = 0; k < GAUSS_CHUNKS; k++, l++) {
+            out[l] = (uint8_t *)&samp[l*CHUNK_SIZE*CDT_COLS];
+            in[l] = seed[j];
+            cstm[l] = (int16_t)dmsp++;
+        }
+    }
+    cSHAKE_BATCH(out, CHUNK_SIZE*CDT_COLS*sizeof(int32_t), cstm, in, CRYPTO_RANDOMBYTES, n*GAUSS_CHUNKS);
+}
+
+
+void sample_gauss_poly(poly z, const unsigned char *seed, int nonce)
+{
+    int32_t samp[PARAM_N*CDT_COLS];
+
+    sample_gauss_expand(samp, &seed, nonce, 1);
+    for (int k = 0; k < GAUSS_CHUNKS; k++)
+        sample_gauss_chunk(&z[k*CHUNK_SIZE], &samp[k*CHUNK_SIZE*CDT_COLS]);
+}
+
+
+static void gauss_batch_task(void *arg, unsigned int j)
+{ // Runs the CDT sampler on the expanded randomness of polynomial j and checks it, unless a polynomial 
+  // before it has already been rejected
+    gauss_batch_t *b = arg;
+    unsigned int first;
+
+    if (j > atomic_load(&b->first_reject))
+        return;
+    for (int k = 0; k < GAUSS_CHUNKS; k++)
+        sample_gauss_chunk(&b->z[j][k*CHUNK_SIZE], &b->samp[(j*GAUSS_CHUNKS+k)*CHUNK_SIZE*CDT_COLS]);
+    if (b->check(b->z[j], b->bound[j]) != 0) {
+        first = atomic_load(&b->first_reject);
+        while (j < first && !atomic_compare_exchange_weak(&b->first_reject, &first, j));
     }
-}
\ No newline at end of file
+}
+
+
+unsigned int sample_gauss_poly_batch(int32_t *z[], const unsigned char *seed[], int nonce, unsigned int n, 
+                                     int (*check)(poly, unsigned int), const unsigned int bound[], int32_t *samp)
+{ // Samples z[0..n-1] as sample_gauss_poly(z[j], seed[j], nonce+j) and stops at the first z[j] for which
+  // check(z[j], bound[j]) != 0. Returns the number of polynomials accepted before it. Without helper threads 
+  // (see parallel.h) the randomness of the remaining ones is discarded without running the CDT sampler.
+  // "samp" holds GAUSS_BATCH_BYTES bytes
+    gauss_batch_t b = { z, samp, check, bound, n };
+
+    sample_gauss_expand(samp, seed, nonce, n);
+    parallel_for(n, gauss_batch_task, &b);
+    return atomic_load(&b.first_reject);
+}
@@ -0,0 +1,161 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: opt-in fork-join helper threads for the per-polynomial loops inside a
+*           single key generation, signature or verification
+*
+* A fork publishes the job in one atomic word holding a generation number, the number
+* of iterations and the next free iteration. The caller and the helpers claim
+* iterations with compare-and-swap, so a helper that wakes up late can never run an
+* iteration of a newer job. Idle helpers spin briefly before they sleep, which keeps
+* back-to-back forks within one operation cheap.
+**************************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include "parallel.h"
+
+#define SPIN_ITERATIONS (1 << 14)   // Checks for a new job before a helper goes to sleep
+
+#if defined(__x86_64__) || defined(__i386__)
+  #define cpu_relax() __builtin_ia32_pause()
+#else
+  #define cpu_relax()
+#endif
+
+// Job word: generation (32 bits) | number of iterations (16 bits) | next iteration (16 bits)
+#define JOB_GEN(w)  ((uint32_t)((w) >> 32))
+#define JOB_N(w)    ((unsigned int)(((w) >> 16) & 0xFFFF))
+#define JOB_NEXT(w) ((unsigned int)((w) & 0xFFFF))
+
+static struct {
+  pthread_t *threads;
+  unsigned int nhelpers;
+  atomic_flag busy;                         // Held by the thread currently forking
+  _Atomic uint64_t job;
+  void (*fn)(void *, unsigned int);
+  void *arg;
+  atomic_uint remaining;                    // Iterations of the current job not yet completed
+  atomic_uint sleepers;
+  atomic_int stop;
+  pthread_mutex_t lock;
+  pthread_cond_t wakeup;
+} helpers = { NULL, 0, ATOMIC_FLAG_INIT, 0, NULL, NULL, 0, 0, 0, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+
+static void run_iterations(uint32_t gen)
+{ // Claims and runs iterations of job "gen" until none are left
+  uint64_t w = atomic_load(&helpers.job);
+
+  while (JOB_GEN(w) == gen && JOB_NEXT(w) < JOB_N(w)) {
+    if (atomic_compare_exchange_weak(&helpers.job, &w, w + 1)) {
+      helpers.fn(helpers.arg, JOB_NEXT(w));
+      atomic_fetch_sub(&helpers.remaining, 1);
+      w = atomic_load(&helpers.job);
+    }
+  }
+}
+
+
+static void *helper_main(void *arg)
+{
+  uint32_t gen = JOB_GEN(atomic_load(&helpers.job));
+  unsigned int spin;
+  (void)arg;
+
+  while (!atomic_load(&helpers.stop)) {
+    for (spin = 0; spin < SPIN_ITERATIONS && JOB_GEN(atomic_load(&helpers.job)) == gen; spin++)
+      cpu_relax();
+    if (JOB_GEN(atomic_load(&helpers.job)) == gen) {
+      pthread_mutex_lock(&helpers.lock);
+      atomic_fetch_add(&helpers.sleepers, 1);
+      while (JOB_GEN(atomic_load(&helpers.job)) == gen && !atomic_load(&helpers.stop))
+        pthread_cond_wait(&helpers.wakeup, &helpers.lock);
+      atomic_fetch_sub(&helpers.sleepers, 1);
+      pthread_mutex_unlock(&helpers.lock);
+      continue;
+    }
+    gen = JOB_GEN(atomic_load(&helpers.job));
+    run_iterations(gen);
+  }
+  return NULL;
+}
+
+
+int parallel_enable(unsigned int nhelpers, const int *cpus)
+{
+  cpu_set_t set;
+  unsigned int i;
+
+  if (helpers.nhelpers != 0 || nhelpers == 0)
+    return -1;
+  helpers.threads = calloc(nhelpers, sizeof(pthread_t));
+  if (helpers.threads == NULL)
+    return -1;
+  atomic_store(&helpers.stop, 0);
+
+  for (i = 0; i < nhelpers; i++) {
+    if (pthread_create(&helpers.threads[i], NULL, helper_main, NULL) != 0) {
+      parallel_disable();
+      return -1;
+    }
+    helpers.nhelpers++;
+    if (cpus != NULL) {
+      CPU_ZERO(&set);
+      CPU_SET(cpus[i], &set);
+      pthread_setaffinity_np(helpers.threads[i], sizeof(cpu_set_t), &set);
+    }
+  }
+  return 0;
+}
+
+
+void parallel_disable(void)
+{
+  unsigned int i;
+
+  pthread_mutex_lock(&helpers.lock);
+  atomic_store(&helpers.stop, 1);
+  pthread_cond_broadcast(&helpers.wakeup);
+  pthread_mutex_unlock(&helpers.lock);
+  for (i = 0; i < helpers.nhelpers; i++)
+    pthread_join(helpers.threads[i], NULL);
+  free(helpers.threads);
+  helpers.threads = NULL;
+  helpers.nhelpers = 0;
+}
+
+
+void parallel_for(unsigned int n, void (*fn)(void *arg, unsigned int i), void *arg)
+{
+  uint64_t w;
+  unsigned int i;
+
+  // Run in order on this thread if there are no helpers, or if they are working for another thread
+  if (helpers.nhelpers == 0 || n < 2 || n > 0xFFFF || atomic_flag_test_and_set(&helpers.busy)) {
+    for (i = 0; i < n; i++)
+      fn(arg, i);
+    return;
+  }
+
+  helpers.fn = fn;
+  helpers.arg = arg;
+  atomic_store(&helpers.remaining, n);
+  w = atomic_load(&helpers.job);
+  w = ((uint64_t)(JOB_GEN(w) + 1) << 32) | ((uint64_t)n << 16);
+  atomic_store(&helpers.job, w);
+  if (atomic_load(&helpers.sleepers) != 0) {
+    pthread_mutex_lock(&helpers.lock);
+    pthread_cond_broadcast(&helpers.wakeup);
+    pthread_mutex_unlock(&helpers.lock);
+  }
+
+  run_iterations(JOB_GEN(w));
+  while (atomic_load(&helpers.remaining) != 0)
+    cpu_relax();
+  atomic_flag_clear(&helpers.busy);
+}
@@ -0,0 +1,29 @@
+#ifndef FIPS202X8_H
+#define FIPS202X8_H
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#if defined(__AVX512F__)
+void cshake128_simple_absorb8x(__m512i *s, const uint16_t cstm[8], const unsigned char *in[8], unsigned long long inlen);
+
+void cshake128_simple_squeezeblocks8x(unsigned char *output[8], unsigned long long outlen, __m512i *s);
+
+/* N is assumed to be empty; S is assumed to have at most 2 characters */
+void cshake128_simple8x(unsigned char *output[8], unsigned long long outlen, const uint16_t cstm[8], const unsigned char *in[8], unsigned long long inlen);
+
+void cshake256_simple_absorb8x(__m512i *s, const uint16_t cstm[8], const unsigned char *in[8], unsigned long long inlen);
+
+void cshake256_simple_squeezeblocks8x(unsigned char *output[8], unsigned long long outlen, __m512i *s);
+
+/* N is assumed to be empty; S is assumed to have at most 2 characters */
+void cshake256_simple8x(unsigned char *output[8], unsigned long long outlen, const uint16_t cstm[8], const unsigned char *in[8], unsigned long long inlen);
+#endif
+
+/* Computes n independent cSHAKE instances, output[j] = cSHAKE(in[j], cstm[j]), using the
+   widest Keccak available (8-way with AVX-512, 4-way otherwise) */
+void cshake128_simple_batch(unsigned char **output, unsigned long long outlen, const uint16_t *cstm, const unsigned char **in, unsigned long long inlen, unsigned int n);
+
+void cshake256_simple_batch(unsigned char **output, unsigned long long outlen, const uint16_t *cstm, const unsigned char **in, unsigned long long inlen, unsigned int n);
+
+#endif
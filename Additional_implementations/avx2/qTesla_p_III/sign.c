@@ -6,44 +6,49 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <stdatomic.h>
+#include <time.h>
 #include "api.h"
 #include "params.h"
 #include "poly.h"
 #include "pack.h"
 #include "sample.h"
 #include "gauss.h"
+#include "parallel.h"
+#include "sign_step.h"
+#include "commitpool.h"
+#include "keystore.h"
+#include "stats.h"
+#include "probes.h"
 #include "sha3/fips202.h"
 #include "random/random.h"
 
-#ifdef STATS
-unsigned long long rejwctr;
-unsigned long long rejyzctr;
-unsigned long long ctr_keygen;
-unsigned long long ctr_sign;
-#endif
-
-
-void hash_H(unsigned char *c_bin, poly_k v, const unsigned char *hm)
-{ // Hash-based function H to generate c'
-  unsigned char t[PARAM_K*PARAM_N + 2*HM_BYTES];
+static void hash_H_round(unsigned char *t, const int32_t *v)
+{ // Rounded form of one polynomial v_k, as hashed by H
   int32_t mask, cL, temp;
-  unsigned int i, k, index;
-
-  for (k=0; k<PARAM_K; k++) {
-    index = k*PARAM_N;
-    for (i=0; i<PARAM_N; i++) {
-      temp = (int32_t)v[index];
-      // If v[i] > PARAM_Q/2 then v[i] -= PARAM_Q
-      mask = (PARAM_Q/2 - temp) >> (RADIX32-1);                    
-      temp = ((temp-PARAM_Q) & mask) | (temp & ~mask);
+  unsigned int i;
+
+  for (i=0; i<PARAM_N; i++) {
+    temp = (int32_t)v[i];
+    // If v[i] > PARAM_Q/2 then v[i] -= PARAM_Q
+    mask = (PARAM_Q/2 - temp) >> (RADIX32-1);                    
+    temp = ((temp-PARAM_Q) & mask) | (temp & ~mask);
     
-      cL = temp & ((1<<PARAM_D)-1);
-      // If cL > 2^(d-1) then cL -= 2^d
-      mask = ((1<<(PARAM_D-1)) - cL) >> (RADIX32-1);                    
-      cL = ((cL-(1<<PARAM_D)) & mask) | (cL & ~mask); 
-      t[index++] = (unsigned char)((temp - cL) >> PARAM_D);
-    }
-  }  
+    cL = temp & ((1<<PARAM_D)-1);
+    // If cL > 2^(d-1) then cL -= 2^d
+    mask = ((1<<(PARAM_D-1)) - cL) >> (RADIX32-1);                    
+    cL = ((cL-(1<<PARAM_D)) & mask) | (cL & ~mask); 
+    t[i] = (unsigned char)((temp - cL) >> PARAM_D);
+  }
+}
+
+
+void hash_H(unsigned char *c_bin, poly_k v, const unsigned char *hm, unsigned char *t)
+{ // Hash-based function H to generate c'. "t" holds HASH_H_BYTES bytes
+  unsigned int k;
+
+  for (k=0; k<PARAM_K; k++)
+    hash_H_round(&t[k*PARAM_N], &v[k*PARAM_N]);
   memcpy(&t[PARAM_K*PARAM_N], hm, 2*HM_BYTES);
   SHAKE(c_bin, CRYPTO_C_BYTES, t, PARAM_K*PARAM_N + 2*HM_BYTES);
 }
@@ -108,7 +113,7 @@ static int test_z(poly z)
 }
 
 
-static int check_ES(poly p, unsigned int bound)
+int check_ES(poly p, unsigned int bound)
 { // Checks the generated polynomial e or s
   // Returns 0 if ok, otherwise returns 1
   unsigned int i, j, sum = 0, limit = PARAM_N;
@@ -135,91 +140,697 @@ static int check_ES(poly p, unsigned int bound)
 }
 
 
+typedef union {   // Large temporaries of one operation, held in the workspace passed to the _ws functions
+  struct {
+    poly s;
+    poly2x s_ntt;
+    poly_k e, a, t;
+    union {
+      unsigned char uniform[POLY_UNIFORM_BYTES];
+      int32_t samp[GAUSS_BATCH_BYTES/sizeof(int32_t)];
+    } scratch;
+  } keypair;
+  struct {
+    poly y, Sc, z;
+    poly2x y_ntt;
+    poly_k v, Ec, a;
+    union {
+      unsigned char uniform[POLY_UNIFORM_BYTES];
+      unsigned char hash[HASH_H_BYTES];
+    } scratch;
+  } sign;
+  struct {
+    int32_t pk_t[PARAM_N*PARAM_K];
+    poly_k w, a, Tc;
+    poly z;
+    poly2x z_ntt;
+    union {
+      unsigned char uniform[POLY_UNIFORM_BYTES];
+      unsigned char hash[HASH_H_BYTES];
+    } scratch;
+  } open;
+} workspace_t;
+
+_Static_assert(sizeof(workspace_t) <= CRYPTO_WORKSPACEBYTES, "CRYPTO_WORKSPACEBYTES is too small");
+
+
+typedef struct {   // Temporaries of crypto_sign_stream_ws(), which hold one of the K polynomials at a time
+  poly y, z, Sc;   // Sc also holds e_k*c
+  poly2x y_ntt;
+  poly a, v;
+  unsigned char t[PARAM_N];
+  uint64_t hash[26];
+  poly_uniform_t gen;
+} stream_workspace_t;
+
+_Static_assert(sizeof(stream_workspace_t) <= CRYPTO_STREAM_WORKSPACEBYTES, "CRYPTO_STREAM_WORKSPACEBYTES is too small");
+
+
+typedef struct {   // Arguments of the loops over the K polynomials that run through parallel_for()
+  int32_t *out, *tmp;
+  const int32_t *a, *x_ntt, *in;
+  const unsigned char *sk;
+  const uint32_t *pos_list;
+  const int16_t *sign_list;
+  atomic_uint first_reject;
+#ifdef STATS
+  atomic_ullong cycles[QTESLA_NPHASES];   // Cycles of the callbacks, from every thread that ran them
+#endif
+} kloop_t;
+
+
+#ifdef STATS
+static void kloop_stats_init(kloop_t *l)
+{
+  for (unsigned int i = 0; i < QTESLA_NPHASES; i++)
+    atomic_init(&l->cycles[i], 0);
+}
+
+static void kloop_stats_merge(kloop_t *l)
+{ // Add the cycles of the last parallel_for() to the statistics of the calling thread
+  for (unsigned int i = 0; i < QTESLA_NPHASES; i++)
+    qtesla_stats_local.cycles[i] += atomic_exchange(&l->cycles[i], 0);
+}
+#endif
+
+
+static void keygen_t_k(void *arg, unsigned int k)
+{ // t_k = a_k*s + e_k
+  kloop_t *l = arg;
+  STATS_CLOCK(clk);
+
+  poly_mul(&l->out[k*PARAM_N], &l->a[k*PARAM_N], l->x_ntt);
+  poly_add_correct(&l->out[k*PARAM_N], &l->out[k*PARAM_N], &l->in[k*PARAM_N]);
+  STATS_MARK_SHARED(l->cycles, clk, QTESLA_PHASE_NTT_MUL);
+}
+
+
+static void sign_v_k(void *arg, unsigned int k)
+{ // v_k = a_k*y
+  kloop_t *l = arg;
+  STATS_CLOCK(clk);
+
+  poly_mul(&l->out[k*PARAM_N], &l->a[k*PARAM_N], l->x_ntt);
+  STATS_MARK_SHARED(l->cycles, clk, QTESLA_PHASE_NTT_MUL);
+}
+
+
+static void sign_w_k(void *arg, unsigned int k)
+{ // v_k = v_k - e_k*c and its correctness check, unless a polynomial before it has already failed
+  kloop_t *l = arg;
+  unsigned int first;
+  int rsp;
+  STATS_CLOCK(clk);
+
+  if (k > atomic_load(&l->first_reject))
+    return;
+  sparse_mul8(&l->tmp[k*PARAM_N], &l->sk[(k+1)*PARAM_N], l->pos_list, l->sign_list);
+  poly_sub(&l->out[k*PARAM_N], &l->out[k*PARAM_N], &l->tmp[k*PARAM_N]);
+  STATS_MARK_SHARED(l->cycles, clk, QTESLA_PHASE_SPARSE_MUL);
+  rsp = test_correctness(&l->out[k*PARAM_N]);
+  STATS_MARK_SHARED(l->cycles, clk, QTESLA_PHASE_CHECK);
+  if (rsp != 0) {
+    first = atomic_load(&l->first_reject);
+    while (k < first && !atomic_compare_exchange_weak(&l->first_reject, &first, k));
+  }
+}
+
+
+static void verify_w_k(void *arg, unsigned int k)
+{ // w_k = a_k*z - t_k*c
+  kloop_t *l = arg;
+  STATS_CLOCK(clk);
+
+  sparse_mul32(&l->tmp[k*PARAM_N], &l->in[k*PARAM_N], l->pos_list, l->sign_list);
+  STATS_MARK_SHARED(l->cycles, clk, QTESLA_PHASE_SPARSE_MUL);
+  poly_mul(&l->out[k*PARAM_N], &l->a[k*PARAM_N], l->x_ntt);
+  poly_sub_reduce(&l->out[k*PARAM_N], &l->out[k*PARAM_N], &l->tmp[k*PARAM_N]);
+  STATS_MARK_SHARED(l->cycles, clk, QTESLA_PHASE_NTT_MUL);
+}
+
+
 /*********************************************************
-* Name:        crypto_sign_keypair
+* Name:        crypto_sign_keypair_ws
 * Description: generates a public and private key pair
-* Parameters:  inputs:  none
+* Parameters:  inputs:
+*              - void *ws: workspace of CRYPTO_WORKSPACEBYTES bytes
 *              outputs:
 *              - unsigned char *pk: public key
 *              - unsigned char *sk: secret key
 * Returns:     0 for successful execution
 **********************************************************/
-int crypto_sign_keypair(unsigned char *pk, unsigned char *sk)
+int crypto_sign_keypair_ws(unsigned char *pk, unsigned char *sk, void *ws)
 {
   unsigned char randomness[CRYPTO_RANDOMBYTES], randomness_extended[(PARAM_K+3)*CRYPTO_SEEDBYTES], hash_pk[HM_BYTES];
-  poly s;
-  poly_k e, a, t;
-  poly2x s_ntt;
+  workspace_t *work = ws;
+  int32_t *s = work->keypair.s, *s_ntt = work->keypair.s_ntt;
+  int32_t *e = work->keypair.e, *a = work->keypair.a, *t = work->keypair.t;
+  int32_t *es[PARAM_K+1];
+  const unsigned char *seeds[PARAM_K+1];
+  unsigned int bounds[PARAM_K+1], j, n;
+  kloop_t l;
   int k, nonce = 0;  // Initialize domain separator for error and secret polynomials
-#ifdef STATS
-  ctr_keygen=0;  
-#endif
+  STATS_CLOCK(clk);
+
+  QTESLA_PROBE(keygen_entry);
 
   // Get randomness_extended <- seed_e, seed_s, seed_a, seed_y
   randombytes(randomness, CRYPTO_RANDOMBYTES);
   SHAKE(randomness_extended, (PARAM_K+3)*CRYPTO_SEEDBYTES, randomness, CRYPTO_RANDOMBYTES);
 
-  for (k=0; k<PARAM_K; k++) {
-    do {  // Sample the error polynomials
-#ifdef STATS
-  ctr_keygen++;
-#endif
-      sample_gauss_poly(&e[k*PARAM_N], &randomness_extended[k*CRYPTO_SEEDBYTES], ++nonce);       
-    } while(check_ES(&e[k*PARAM_N], PARAM_KEYGEN_BOUND_E) != 0); 
+  // Sample the error polynomials e_1..e_K and the secret polynomial s, GAUSS_BATCH at a time.
+  // The randomness of consecutive polynomials is expanded speculatively with consecutive nonces; when one 
+  // is rejected, the ones after it are resampled, so nonces are assigned exactly as in sequential sampling
+  for (k=0; k<=PARAM_K; k++) {
+    es[k] = (k < PARAM_K) ? &e[k*PARAM_N] : s;
+    seeds[k] = &randomness_extended[k*CRYPTO_SEEDBYTES];
+    bounds[k] = (k < PARAM_K) ? PARAM_KEYGEN_BOUND_E : PARAM_KEYGEN_BOUND_S;
   }
-  
-  do {  // Sample the secret polynomial 
-#ifdef STATS
-  ctr_keygen++;
-#endif
-    sample_gauss_poly(s, &randomness_extended[PARAM_K*CRYPTO_SEEDBYTES], ++nonce);
-  } while(check_ES(s, PARAM_KEYGEN_BOUND_S) != 0);
+  for (k=0; k<=PARAM_K; k+=j) {
+    n = (PARAM_K+1-k < GAUSS_BATCH) ? PARAM_K+1-k : GAUSS_BATCH;
+    j = sample_gauss_poly_batch(&es[k], &seeds[k], nonce+1, n, check_ES, &bounds[k], work->keypair.scratch.samp);
+    if (j < n)
+      QTESLA_PROBE2(reject, QTESLA_REJECT_ES, nonce+1+j);
+    nonce += j + (j < n);
+  }
+  STATS_MARK(clk, QTESLA_PHASE_GAUSS);
 
   // Generate uniform polynomial "a"
-  poly_uniform(a, &randomness_extended[(PARAM_K+1)*CRYPTO_SEEDBYTES]);
+  QTESLA_PROBE1(phase_entry, QTESLA_PHASE_GEN_A);
+  poly_uniform(a, &randomness_extended[(PARAM_K+1)*CRYPTO_SEEDBYTES], work->keypair.scratch.uniform);
+  QTESLA_PROBE1(phase_return, QTESLA_PHASE_GEN_A);
+  STATS_MARK(clk, QTESLA_PHASE_GEN_A);
   poly_ntt(s_ntt, s);
+  STATS_MARK(clk, QTESLA_PHASE_NTT_MUL);
   
   // Compute the public key t = as+e
-  for (k=0; k<PARAM_K; k++) {
-    poly_mul(&t[k*PARAM_N], &a[k*PARAM_N], s_ntt);
-    poly_add_correct(&t[k*PARAM_N], &t[k*PARAM_N], &e[k*PARAM_N]);
-  }
+  l.out = t;
+  l.a = a;
+  l.x_ntt = s_ntt;
+  l.in = e;
+#ifdef STATS
+  kloop_stats_init(&l);
+#endif
+  parallel_for(PARAM_K, keygen_t_k, &l);
+#ifdef STATS
+  kloop_stats_merge(&l);
+  clk = qtesla_stats_cycles();
+#endif
   
   // Pack public and private keys
   encode_pk(pk, t, &randomness_extended[(PARAM_K+1)*CRYPTO_SEEDBYTES]);
   SHAKE(hash_pk, HM_BYTES, pk, CRYPTO_PUBLICKEYBYTES-CRYPTO_SEEDBYTES);
   encode_sk(sk, s, e, &randomness_extended[(PARAM_K+1)*CRYPTO_SEEDBYTES], hash_pk);
+  STATS_MARK(clk, QTESLA_PHASE_PACK);
+#ifdef STATS
+  qtesla_stats_local.keypairs++;
+  qtesla_stats_local.gauss_samples += nonce;
+  qtesla_stats_hist(QTESLA_REJECT_ES, nonce - (PARAM_K+1));
+#endif
+  QTESLA_PROBE1(keygen_return, nonce - (PARAM_K+1));
 
   return 0;
 }
 
 
+static void sign_seed_y(qtesla_sign_t *st)
+{ // Draw a fresh r and restart the nonces of sample_y from the seed H(seed_y, r, H(m))
+  randombytes(&st->randomness_input[CRYPTO_RANDOMBYTES], CRYPTO_RANDOMBYTES);
+  SHAKE(st->randomness, CRYPTO_SEEDBYTES, st->randomness_input, CRYPTO_RANDOMBYTES+CRYPTO_SEEDBYTES+HM_BYTES);
+  st->nonce = 0;  // Initialize domain separator for sampling y 
+}
+
+
+static void sign_begin(qtesla_sign_t *st, const unsigned char *m, unsigned long long mlen, const unsigned char *hm, const unsigned char* sk, 
+                       const int32_t *a, void *ws)
+{ // Starts a signature of m, or of the message whose H(m) is hm if hm is not NULL. The polynomials a_k are expanded
+  // into the workspace, unless they are given in a
+  workspace_t *work = ws;
+  STATS_CLOCK(clk);
+
+  st->m = m;
+  st->mlen = mlen;
+  st->sk = sk;
+  st->ws = ws;
+  st->restarts = 0;
+  st->rejected_z = 0;
+  st->rejected_w = 0;
+  st->done = 0;
+
+  // Get H(seed_y, r, H(m)) to sample y
+  memcpy(st->randomness_input, &sk[CRYPTO_SECRETKEYBYTES-HM_BYTES-CRYPTO_SEEDBYTES], CRYPTO_SEEDBYTES);
+  if (hm == NULL)
+    SHAKE(&st->randomness_input[CRYPTO_RANDOMBYTES+CRYPTO_SEEDBYTES], HM_BYTES, m, mlen);
+  else
+    memcpy(&st->randomness_input[CRYPTO_RANDOMBYTES+CRYPTO_SEEDBYTES], hm, HM_BYTES);
+  sign_seed_y(st);
+  memcpy(&st->randomness_input[CRYPTO_RANDOMBYTES+CRYPTO_SEEDBYTES+HM_BYTES], &sk[CRYPTO_SECRETKEYBYTES-HM_BYTES], HM_BYTES);
+  STATS_MARK(clk, QTESLA_PHASE_PACK);
+  if (a != NULL) {
+    st->a = a;
+    return;
+  }
+  
+  st->a = work->sign.a;
+  QTESLA_PROBE1(phase_entry, QTESLA_PHASE_GEN_A);
+  poly_uniform(work->sign.a, &sk[CRYPTO_SECRETKEYBYTES-HM_BYTES-2*CRYPTO_SEEDBYTES], work->sign.scratch.uniform);
+  QTESLA_PROBE1(phase_return, QTESLA_PHASE_GEN_A);
+  STATS_MARK(clk, QTESLA_PHASE_GEN_A);
+}
+
+
 /***************************************************************
-* Name:        crypto_sign
+* Name:        qtesla_sign_begin
+* Description: starts a signature of message m (see sign_step.h)
+* Parameters:  inputs:
+*              - const unsigned char *m: message to be signed
+*              - unsigned long long mlen: message length
+*              - const unsigned char* sk: secret key
+*              - void *ws: workspace of CRYPTO_WORKSPACEBYTES bytes
+*              outputs:
+*              - qtesla_sign_t *st: signing state
+***************************************************************/
+void qtesla_sign_begin(qtesla_sign_t *st, const unsigned char *m, unsigned long long mlen, const unsigned char* sk, void *ws)
+{
+  QTESLA_PROBE1(sign_entry, mlen);
+  sign_begin(st, m, mlen, NULL, sk, NULL, ws);
+}
+
+
+/***************************************************************
+* Name:        qtesla_sign_begin_hm
+* Description: starts a detached signature of the message whose 
+*              hash H(m) is hm (see sign_step.h)
+* Parameters:  inputs:
+*              - const unsigned char *hm: HM_BYTES bytes
+*              - const unsigned char* sk: secret key
+*              - void *ws: workspace of CRYPTO_WORKSPACEBYTES bytes
+*              outputs:
+*              - qtesla_sign_t *st: signing state
+***************************************************************/
+void qtesla_sign_begin_hm(qtesla_sign_t *st, const unsigned char *hm, const unsigned char* sk, void *ws)
+{
+  QTESLA_PROBE1(sign_entry, 0);
+  sign_begin(st, NULL, 0, hm, sk, NULL, ws);
+}
+
+
+/***************************************************************
+* Name:        qtesla_sign_begin_a
+* Description: starts a signature of message m with the 
+*              polynomials a_k of sk already expanded (see 
+*              keystore.h)
+* Parameters:  inputs:
+*              - const unsigned char *m: message to be signed
+*              - unsigned long long mlen: message length
+*              - const unsigned char* sk: secret key
+*              - const int32_t *a: polynomials a_k of sk
+*              - void *ws: workspace of CRYPTO_WORKSPACEBYTES bytes
+*              outputs:
+*              - qtesla_sign_t *st: signing state
+***************************************************************/
+void qtesla_sign_begin_a(qtesla_sign_t *st, const unsigned char *m, unsigned long long mlen, const unsigned char* sk, const int32_t *a, void *ws)
+{
+  QTESLA_PROBE1(sign_entry, mlen);
+  sign_begin(st, m, mlen, NULL, sk, a, ws);
+}
+
+
+static int sign_iteration(qtesla_sign_t *st)
+{ // One rejection iteration of the signing loop. Returns 0 if it produced a valid (c, z), otherwise 1
+  uint32_t pos_list[PARAM_H];
+  int16_t sign_list[PARAM_H];
+  workspace_t *work = st->ws;
+  int32_t *y = work->sign.y, *y_ntt = work->sign.y_ntt, *Sc = work->sign.Sc, *z = work->sign.z;
+  int32_t *v = work->sign.v, *Ec = work->sign.Ec;
+  const int32_t *a = st->a;
+  kloop_t l;
+  int rsp;
+  STATS_CLOCK(clk);
+
+#ifdef STATS
+  qtesla_stats_local.sign_iterations++;
+  kloop_stats_init(&l);
+#endif
+  if (st->nonce == QTESLA_SIGN_NONCE_LIMIT) {   // Never reuse the domain separators of sample_y
+    sign_seed_y(st);
+    st->restarts++;
+  }
+  QTESLA_PROBE1(phase_entry, QTESLA_PHASE_SAMPLE_Y);
+  sample_y(y, st->randomness, ++st->nonce);   // Sample y uniformly at random from [-B,B]
+  QTESLA_PROBE1(phase_return, QTESLA_PHASE_SAMPLE_Y);
+  STATS_MARK(clk, QTESLA_PHASE_SAMPLE_Y);
+  poly_ntt (y_ntt, y);
+  STATS_MARK(clk, QTESLA_PHASE_NTT_MUL);
+  l.out = v;
+  l.a = a;
+  l.x_ntt = y_ntt;
+  parallel_for(PARAM_K, sign_v_k, &l);
+#ifdef STATS
+  kloop_stats_merge(&l);
+  clk = qtesla_stats_cycles();
+#endif
+  QTESLA_PROBE1(phase_entry, QTESLA_PHASE_HASH_H);
+  hash_H(st->c, v, &st->randomness_input[CRYPTO_RANDOMBYTES+CRYPTO_SEEDBYTES], work->sign.scratch.hash);
+  QTESLA_PROBE1(phase_return, QTESLA_PHASE_HASH_H);
+  STATS_MARK(clk, QTESLA_PHASE_HASH_H);
+  encode_c(pos_list, sign_list, st->c);       // Generate c = Enc(c'), where c' is the hashing of v together with m
+  STATS_MARK(clk, QTESLA_PHASE_ENCODE_C);
+  sparse_mul8(Sc, st->sk, pos_list, sign_list);
+  poly_add(z, y, Sc);                         // Compute z = y + sc
+  STATS_MARK(clk, QTESLA_PHASE_SPARSE_MUL);
+  rsp = test_rejection(z);
+  STATS_MARK(clk, QTESLA_PHASE_CHECK);
+    
+  if (rsp != 0) {                             // Rejection sampling
+    st->rejected_z++;
+    QTESLA_PROBE2(reject, QTESLA_REJECT_Z, st->nonce);
+    return 1;
+  }        
+ 
+  l.tmp = Ec;
+  l.sk = st->sk;
+  l.pos_list = pos_list;
+  l.sign_list = sign_list;
+  atomic_init(&l.first_reject, PARAM_K);
+  parallel_for(PARAM_K, sign_w_k, &l);
+#ifdef STATS
+  kloop_stats_merge(&l);
+#endif
+  if (atomic_load(&l.first_reject) < PARAM_K) {
+    st->rejected_w++;
+    QTESLA_PROBE2(reject, QTESLA_REJECT_W, st->nonce);
+    return 1;
+  }
+  return 0;
+}
+
+
+/***************************************************************
+* Name:        qtesla_sign_step
+* Description: runs up to "iterations" rejection iterations of 
+*              the signature started by qtesla_sign_begin
+* Parameters:  inputs:
+*              - qtesla_sign_t *st: signing state
+*              - unsigned int iterations: 0 for no limit
+* Returns:     0 when the signature is ready
+*              QTESLA_SIGN_AGAIN if all iterations were rejected
+***************************************************************/
+int qtesla_sign_step(qtesla_sign_t *st, unsigned int iterations)
+{
+  return qtesla_sign_step_deadline(st, iterations, 0);
+}
+
+
+/***************************************************************
+* Name:        qtesla_sign_step_deadline
+* Description: runs rejection iterations of the signature started 
+*              by qtesla_sign_begin until it is ready, "iterations"
+*              have run or CLOCK_MONOTONIC reaches "deadline_ns"
+* Parameters:  inputs:
+*              - qtesla_sign_t *st: signing state
+*              - unsigned int iterations: 0 for no limit
+*              - uint64_t deadline_ns: 0 for no deadline
+* Returns:     0 when the signature is ready
+*              QTESLA_SIGN_AGAIN if the budget ran out first
+***************************************************************/
+int qtesla_sign_step_deadline(qtesla_sign_t *st, unsigned int iterations, uint64_t deadline_ns)
+{
+  unsigned int n;
+
+  for (n = 0; !st->done; n++) {
+    if ((iterations != 0 && n == iterations) || (deadline_ns != 0 && qtesla_time_ns() >= deadline_ns))
+      return QTESLA_SIGN_AGAIN;
+    st->done = (sign_iteration(st) == 0);
+  }
+#ifdef STATS
+  if (n != 0) {   // Count the signature once, in the call that completed it
+    qtesla_stats_local.signatures++;
+    qtesla_stats_hist(QTESLA_REJECT_Z, st->rejected_z);
+    qtesla_stats_hist(QTESLA_REJECT_W, st->rejected_w);
+  }
+#endif
+  return 0;
+}
+
+
+/***************************************************************
+* Name:        qtesla_sign_finish
+* Description: outputs the signature computed by qtesla_sign_step
+* Parameters:  inputs:
+*              - qtesla_sign_t *st: signing state
+*              outputs:
+*              - unsigned char *sm: signature
+*              - unsigned long long *smlen: signature length*
+* Returns:     0 for successful execution
+*              -1 if the signature is not ready
+***************************************************************/
+int qtesla_sign_finish(qtesla_sign_t *st, unsigned char *sm, unsigned long long *smlen)
+{
+  workspace_t *work = st->ws;
+  STATS_CLOCK(clk);
+
+  if (!st->done)
+    return -1;
+
+  // Copy message to signature package, and pack signature
+  for (unsigned long long i = 0; i < st->mlen; i++)
+     sm[CRYPTO_BYTES+i] = st->m[i];
+  *smlen = CRYPTO_BYTES + st->mlen; 
+  encode_sig(sm, st->c, work->sign.z);
+  STATS_MARK(clk, QTESLA_PHASE_PACK);
+  QTESLA_PROBE1(sign_return, st->rejected_z + st->rejected_w + 1);
+
+  return 0;
+}
+
+
+/***************************************************************
+* Name:        qtesla_sign_bounded
+* Description: outputs a signature for a given message m within 
+*              an iteration and deadline budget (see sign_step.h)
+* Parameters:  inputs:
+*              - const unsigned char *m: message to be signed
+*              - unsigned long long mlen: message length
+*              - const unsigned char* sk: secret key
+*              - void *ws: workspace of CRYPTO_WORKSPACEBYTES bytes
+*              - unsigned int iterations: 0 for no limit
+*              - uint64_t deadline_ns: 0 for no deadline
+*              outputs:
+*              - unsigned char *sm: signature
+*              - unsigned long long *smlen: signature length*
+*              - qtesla_sign_t *st: signing state, to resume
+* Returns:     0 for successful execution
+*              QTESLA_SIGN_AGAIN if the budget ran out first
+***************************************************************/
+int qtesla_sign_bounded(unsigned char *sm, unsigned long long *smlen, const unsigned char *m, unsigned long long mlen, 
+                        const unsigned char *sk, qtesla_sign_t *st, void *ws, unsigned int iterations, uint64_t deadline_ns)
+{
+  qtesla_sign_begin(st, m, mlen, sk, ws);
+  if (qtesla_sign_step_deadline(st, iterations, deadline_ns) != 0)
+    return QTESLA_SIGN_AGAIN;
+  return qtesla_sign_finish(st, sm, smlen);
+}
+
+
+/***************************************************************
+* Name:        crypto_sign_ws
 * Description: outputs a signature for a given message m
 * Parameters:  inputs:
 *              - const unsigned char *m: message to be signed
 *              - unsigned long long mlen: message length
 *              - const unsigned char* sk: secret key
+*              - void *ws: workspace of CRYPTO_WORKSPACEBYTES bytes
 *              outputs:
 *              - unsigned char *sm: signature
 *              - unsigned long long *smlen: signature length*
 * Returns:     0 for successful execution
 ***************************************************************/
-int crypto_sign(unsigned char *sm, unsigned long long *smlen, const unsigned char *m, unsigned long long mlen, const unsigned char* sk)
+int crypto_sign_ws(unsigned char *sm, unsigned long long *smlen, const unsigned char *m, unsigned long long mlen, const unsigned char* sk, void *ws)
 {    
-  unsigned char c[CRYPTO_C_BYTES], randomness[CRYPTO_SEEDBYTES], randomness_input[CRYPTO_RANDOMBYTES+CRYPTO_SEEDBYTES+2*HM_BYTES];
+  qtesla_sign_t st;
+
+  qtesla_sign_begin(&st, m, mlen, sk, ws);
+  qtesla_sign_step(&st, 0);
+  return qtesla_sign_finish(&st, sm, smlen);
+}
+
+
+/***************************************************************
+* Name:        qtesla_commit_a
+* Description: expands the polynomials a_k of a secret key for
+*              the offline phase (see commitpool.h)
+* Parameters:  inputs:
+*              - const unsigned char* sk: secret key
+*              - void *ws: workspace of CRYPTO_WORKSPACEBYTES bytes
+*              outputs:
+*              - int32_t *a: polynomials a_k
+***************************************************************/
+void qtesla_commit_a(int32_t *a, const unsigned char *sk, void *ws)
+{
+  workspace_t *work = ws;
+
+  poly_uniform(a, &sk[CRYPTO_SECRETKEYBYTES-HM_BYTES-2*CRYPTO_SEEDBYTES], work->sign.scratch.uniform);
+}
+
+
+/***************************************************************
+* Name:        qtesla_commit
+* Description: offline phase of a signature, which does not depend 
+*              on the message: samples y from H(seed_y, r) for a 
+*              fresh r and computes v = a*y
+* Parameters:  inputs:
+*              - const int32_t *a: polynomials a_k of sk
+*              - const unsigned char* sk: secret key
+*              - void *ws: workspace of CRYPTO_WORKSPACEBYTES bytes
+*              outputs:
+*              - int32_t *y, *v: commitment
+***************************************************************/
+void qtesla_commit(int32_t *y, int32_t *v, const int32_t *a, const unsigned char *sk, void *ws)
+{
+  unsigned char randomness[CRYPTO_SEEDBYTES], randomness_input[CRYPTO_SEEDBYTES+CRYPTO_RANDOMBYTES];
+  workspace_t *work = ws;
+  kloop_t l;
+  STATS_CLOCK(clk);
+
+#ifdef STATS
+  kloop_stats_init(&l);
+#endif
+  memcpy(randomness_input, &sk[CRYPTO_SECRETKEYBYTES-HM_BYTES-CRYPTO_SEEDBYTES], CRYPTO_SEEDBYTES);
+  randombytes(&randomness_input[CRYPTO_SEEDBYTES], CRYPTO_RANDOMBYTES);
+  SHAKE(randomness, CRYPTO_SEEDBYTES, randomness_input, CRYPTO_SEEDBYTES+CRYPTO_RANDOMBYTES);
+  QTESLA_PROBE1(phase_entry, QTESLA_PHASE_SAMPLE_Y);
+  sample_y(y, randomness, 1);   // Each y has its own seed, so the nonce is always 1
+  QTESLA_PROBE1(phase_return, QTESLA_PHASE_SAMPLE_Y);
+  STATS_MARK(clk, QTESLA_PHASE_SAMPLE_Y);
+  poly_ntt (work->sign.y_ntt, y);
+  STATS_MARK(clk, QTESLA_PHASE_NTT_MUL);
+  l.out = v;
+  l.a = a;
+  l.x_ntt = work->sign.y_ntt;
+  parallel_for(PARAM_K, sign_v_k, &l);
+#ifdef STATS
+  kloop_stats_merge(&l);
+#endif
+}
+
+
+void qtesla_sign_hm(unsigned char *hm, const unsigned char *m, unsigned long long mlen, const unsigned char *sk)
+{ // H(m) and the hash of the public key, as qtesla_sign_begin() puts them in randomness_input
+  SHAKE(hm, HM_BYTES, m, mlen);
+  memcpy(&hm[HM_BYTES], &sk[CRYPTO_SECRETKEYBYTES-HM_BYTES], HM_BYTES);
+}
+
+
+/***************************************************************
+* Name:        qtesla_sign_commit
+* Description: online phase of a signature: one rejection iteration 
+*              of the signing loop with a commitment computed by 
+*              qtesla_commit
+* Parameters:  inputs:
+*              - const unsigned char *m: message to be signed
+*              - unsigned long long mlen: message length
+*              - const unsigned char *hm: output of qtesla_sign_hm
+*              - const unsigned char* sk: secret key
+*              - int32_t *y, *v: commitment, v is overwritten
+*              - void *ws: workspace of CRYPTO_WORKSPACEBYTES bytes
+*              outputs:
+*              - unsigned char *sm: signature
+*              - unsigned long long *smlen: signature length*
+* Returns:     0 for successful execution
+*              QTESLA_SIGN_AGAIN if the signature was rejected
+***************************************************************/
+int qtesla_sign_commit(unsigned char *sm, unsigned long long *smlen, const unsigned char *m, unsigned long long mlen,
+                       const unsigned char *hm, const unsigned char *sk, int32_t *y, int32_t *v, void *ws)
+{
+  unsigned char c[CRYPTO_C_BYTES];
   uint32_t pos_list[PARAM_H];
   int16_t sign_list[PARAM_H];
-  poly y, Sc, z; 
-  poly_k v, Ec, a;
-  poly2x y_ntt;
-  int k, rsp, nonce = 0;  // Initialize domain separator for sampling y 
+  workspace_t *work = ws;
+  int32_t *Sc = work->sign.Sc, *z = work->sign.z;
+  kloop_t l;
+  int rsp;
+  STATS_CLOCK(clk);
+
 #ifdef STATS
-  ctr_sign=0;
-  rejwctr=0;
-  rejyzctr=0;
+  qtesla_stats_local.sign_iterations++;
+  kloop_stats_init(&l);
 #endif
+  QTESLA_PROBE1(phase_entry, QTESLA_PHASE_HASH_H);
+  hash_H(c, v, hm, work->sign.scratch.hash);
+  QTESLA_PROBE1(phase_return, QTESLA_PHASE_HASH_H);
+  STATS_MARK(clk, QTESLA_PHASE_HASH_H);
+  encode_c(pos_list, sign_list, c);
+  STATS_MARK(clk, QTESLA_PHASE_ENCODE_C);
+  sparse_mul8(Sc, sk, pos_list, sign_list);
+  poly_add(z, y, Sc);
+  STATS_MARK(clk, QTESLA_PHASE_SPARSE_MUL);
+  rsp = test_rejection(z);
+  STATS_MARK(clk, QTESLA_PHASE_CHECK);
+  if (rsp != 0) {
+    QTESLA_PROBE2(reject, QTESLA_REJECT_Z, 1);
+    return QTESLA_SIGN_AGAIN;
+  }
+
+  l.out = v;
+  l.tmp = work->sign.Ec;
+  l.sk = sk;
+  l.pos_list = pos_list;
+  l.sign_list = sign_list;
+  atomic_init(&l.first_reject, PARAM_K);
+  parallel_for(PARAM_K, sign_w_k, &l);
+#ifdef STATS
+  kloop_stats_merge(&l);
+  clk = qtesla_stats_cycles();
+#endif
+  if (atomic_load(&l.first_reject) < PARAM_K) {
+    QTESLA_PROBE2(reject, QTESLA_REJECT_W, 1);
+    return QTESLA_SIGN_AGAIN;
+  }
+
+  for (unsigned long long i = 0; i < mlen; i++)
+     sm[CRYPTO_BYTES+i] = m[i];
+  *smlen = CRYPTO_BYTES + mlen;
+  encode_sig(sm, c, z);
+  STATS_MARK(clk, QTESLA_PHASE_PACK);
+#ifdef STATS
+  qtesla_stats_local.signatures++;
+#endif
+  return 0;
+}
+
+
+/***************************************************************
+* Name:        crypto_sign_stream_ws
+* Description: outputs the same signature as crypto_sign_ws without 
+*              holding the K polynomials a_k, v_k and e_k*c at once. 
+*              Each attempt generates a_k on the fly and absorbs the 
+*              rounded v_k = a_k*y into H; attempts that pass the 
+*              rejection test on z generate a_k and v_k again for the 
+*              correctness test on v_k - e_k*c
+* Parameters:  inputs:
+*              - const unsigned char *m: message to be signed
+*              - unsigned long long mlen: message length
+*              - const unsigned char* sk: secret key
+*              - void *ws: workspace of CRYPTO_STREAM_WORKSPACEBYTES bytes
+*              outputs:
+*              - unsigned char *sm: signature
+*              - unsigned long long *smlen: signature length*
+* Returns:     0 for successful execution
+***************************************************************/
+int crypto_sign_stream_ws(unsigned char *sm, unsigned long long *smlen, const unsigned char *m, unsigned long long mlen, const unsigned char* sk, void *ws)
+{    
+  unsigned char c[CRYPTO_C_BYTES], randomness[CRYPTO_SEEDBYTES], randomness_input[CRYPTO_RANDOMBYTES+CRYPTO_SEEDBYTES+2*HM_BYTES];
+  const unsigned char *seed_a = &sk[CRYPTO_SECRETKEYBYTES-HM_BYTES-2*CRYPTO_SEEDBYTES];
+  uint32_t pos_list[PARAM_H];
+  int16_t sign_list[PARAM_H];
+  stream_workspace_t *work = ws;
+  int32_t *y = work->y, *y_ntt = work->y_ntt, *Sc = work->Sc, *z = work->z, *a = work->a, *v = work->v;
+  int k, rsp = 0, nonce = 0;  // Initialize domain separator for sampling y 
+  int rejected_z = 0, rejected_w = 0;
+  STATS_CLOCK(clk);
+
+  QTESLA_PROBE1(sign_entry, mlen);
 
   // Get H(seed_y, r, H(m)) to sample y
   memcpy(randomness_input, &sk[CRYPTO_SECRETKEYBYTES-HM_BYTES-CRYPTO_SEEDBYTES], CRYPTO_SEEDBYTES);
@@ -227,98 +838,158 @@ int crypto_sign(unsigned char *sm, unsigned long long *smlen, const unsigned cha
   SHAKE(&randomness_input[CRYPTO_RANDOMBYTES+CRYPTO_SEEDBYTES], HM_BYTES, m, mlen);
   SHAKE(randomness, CRYPTO_SEEDBYTES, randomness_input, CRYPTO_RANDOMBYTES+CRYPTO_SEEDBYTES+HM_BYTES);
   memcpy(&randomness_input[CRYPTO_RANDOMBYTES+CRYPTO_SEEDBYTES+HM_BYTES], &sk[CRYPTO_SECRETKEYBYTES-HM_BYTES], HM_BYTES);
-  
-  poly_uniform(a, &sk[CRYPTO_SECRETKEYBYTES-HM_BYTES-2*CRYPTO_SEEDBYTES]);
+  STATS_MARK(clk, QTESLA_PHASE_PACK);
 
   while (1) {
 #ifdef STATS
-  ctr_sign++;
+  qtesla_stats_local.sign_iterations++;
 #endif
+    if (nonce == QTESLA_SIGN_NONCE_LIMIT) {     // Never reuse the domain separators of sample_y
+      randombytes(&randomness_input[CRYPTO_RANDOMBYTES], CRYPTO_RANDOMBYTES);
+      SHAKE(randomness, CRYPTO_SEEDBYTES, randomness_input, CRYPTO_RANDOMBYTES+CRYPTO_SEEDBYTES+HM_BYTES);
+      nonce = 0;
+    }
+    QTESLA_PROBE1(phase_entry, QTESLA_PHASE_SAMPLE_Y);
     sample_y(y, randomness, ++nonce);           // Sample y uniformly at random from [-B,B]
+    QTESLA_PROBE1(phase_return, QTESLA_PHASE_SAMPLE_Y);
+    STATS_MARK(clk, QTESLA_PHASE_SAMPLE_Y);
     poly_ntt (y_ntt, y);
-    for (k=0; k<PARAM_K; k++)
-      poly_mul(&v[k*PARAM_N], &a[k*PARAM_N], y_ntt);
-    hash_H(c, v, &randomness_input[CRYPTO_RANDOMBYTES+CRYPTO_SEEDBYTES]);
+    STATS_MARK(clk, QTESLA_PHASE_NTT_MUL);
+    poly_uniform_init(&work->gen, seed_a);
+    SHAKE_INC_INIT(work->hash);
+    for (k=0; k<PARAM_K; k++) {                 // Compute v_k = a_k*y and absorb its rounded form into H
+      poly_uniform_next(a, &work->gen);
+      STATS_MARK(clk, QTESLA_PHASE_GEN_A);
+      poly_mul(v, a, y_ntt);
+      STATS_MARK(clk, QTESLA_PHASE_NTT_MUL);
+      hash_H_round(work->t, v);
+      SHAKE_INC_ABSORB(work->hash, work->t, PARAM_N);
+      STATS_MARK(clk, QTESLA_PHASE_HASH_H);
+    }
+    SHAKE_INC_ABSORB(work->hash, &randomness_input[CRYPTO_RANDOMBYTES+CRYPTO_SEEDBYTES], 2*HM_BYTES);
+    SHAKE_INC_FINALIZE(work->hash);
+    SHAKE_SQUEEZEBLOCKS(work->t, 1, work->hash);
+    memcpy(c, work->t, CRYPTO_C_BYTES);
+    STATS_MARK(clk, QTESLA_PHASE_HASH_H);
     encode_c(pos_list, sign_list, c);           // Generate c = Enc(c'), where c' is the hashing of v together with m
+    STATS_MARK(clk, QTESLA_PHASE_ENCODE_C);
     sparse_mul8(Sc, sk, pos_list, sign_list);
     poly_add(z, y, Sc);                         // Compute z = y + sc
+    STATS_MARK(clk, QTESLA_PHASE_SPARSE_MUL);
+    rsp = test_rejection(z);
+    STATS_MARK(clk, QTESLA_PHASE_CHECK);
     
-    if (test_rejection(z) != 0) {               // Rejection sampling
-#ifdef STATS
-  rejyzctr++;
-#endif
+    if (rsp != 0) {                             // Rejection sampling
+      rejected_z++;
+      QTESLA_PROBE2(reject, QTESLA_REJECT_Z, nonce);
       continue;
     }        
- 
-    for (k=0; k<PARAM_K; k++) {
-      sparse_mul8(&Ec[k*PARAM_N], &sk[(k+1)*PARAM_N], pos_list, sign_list);
-      poly_sub(&v[k*PARAM_N], &v[k*PARAM_N], &Ec[k*PARAM_N]);
-      rsp = test_correctness(&v[k*PARAM_N]);
-      if (rsp != 0) {
-#ifdef STATS
-  rejwctr++;
-#endif
+
+    poly_uniform_init(&work->gen, seed_a);
+    for (k=0; k<PARAM_K; k++) {                 // Check v_k - e_k*c
+      poly_uniform_next(a, &work->gen);
+      STATS_MARK(clk, QTESLA_PHASE_GEN_A);
+      poly_mul(v, a, y_ntt);
+      STATS_MARK(clk, QTESLA_PHASE_NTT_MUL);
+      sparse_mul8(Sc, &sk[(k+1)*PARAM_N], pos_list, sign_list);
+      poly_sub(v, v, Sc);
+      STATS_MARK(clk, QTESLA_PHASE_SPARSE_MUL);
+      rsp = test_correctness(v);
+      STATS_MARK(clk, QTESLA_PHASE_CHECK);
+      if (rsp != 0)
         break;
-      }
     }
-    if (rsp != 0)
-	  continue;
+    if (rsp != 0) {
+      rejected_w++;
+      QTESLA_PROBE2(reject, QTESLA_REJECT_W, nonce);
+      continue;
+    }
 
     // Copy message to signature package, and pack signature
     for (unsigned long long i = 0; i < mlen; i++)
        sm[CRYPTO_BYTES+i] = m[i];
     *smlen = CRYPTO_BYTES + mlen; 
     encode_sig(sm, c, z);
+    STATS_MARK(clk, QTESLA_PHASE_PACK);
+#ifdef STATS
+    qtesla_stats_local.signatures++;
+    qtesla_stats_hist(QTESLA_REJECT_Z, rejected_z);
+    qtesla_stats_hist(QTESLA_REJECT_W, rejected_w);
+#endif
+    QTESLA_PROBE1(sign_return, rejected_z + rejected_w + 1);
 
     return 0;
   }
 }
 
 
-/************************************************************
-* Name:        crypto_sign_open
-* Description: verification of a signature sm
-* Parameters:  inputs:
-*              - const unsigned char *sm: signature
-*              - unsigned long long smlen: signature length
-*              - const unsigned char* pk: public Key
-*              outputs:
-*              - unsigned char *m: original (signed) message
-*              - unsigned long long *mlen: message length*
-* Returns:     0 for valid signature
-*              <0 for invalid signature
-************************************************************/
-int crypto_sign_open(unsigned char *m, unsigned long long *mlen, const unsigned char *sm, unsigned long long smlen, const unsigned char *pk)
-{
+static int sign_open(unsigned char *m, unsigned long long *mlen, const unsigned char *sm, unsigned long long smlen, const unsigned char *hm_m, 
+                     const unsigned char *pk, const qtesla_pk_expanded_t *x, void *ws)
+{ // Verification proper, run between the probes of crypto_sign_open_ws, or of qtesla_verify_hm with the H(m) given in hm_m.
+  // With x, the public key is taken expanded from x instead of pk
   unsigned char c[CRYPTO_C_BYTES], c_sig[CRYPTO_C_BYTES], seed[CRYPTO_SEEDBYTES], hm[2*HM_BYTES];
   uint32_t pos_list[PARAM_H];
   int16_t sign_list[PARAM_H]; 
-  int32_t pk_t[PARAM_N*PARAM_K];
-  poly_k w, a, Tc;
-  poly z;
-  poly2x z_ntt;
-  int k;
+  workspace_t *work = ws;
+  int32_t *pk_t = work->open.pk_t, *w = work->open.w, *a = work->open.a, *Tc = work->open.Tc;
+  int32_t *z = work->open.z, *z_ntt = work->open.z_ntt;
+  kloop_t l;
+  int rsp;
+  STATS_CLOCK(clk);
 
+#ifdef STATS
+  qtesla_stats_local.verifications++;
+  kloop_stats_init(&l);
+#endif
   if (smlen < CRYPTO_BYTES) return -1;
 
   decode_sig(c, z, sm);
-  if (test_z(z) != 0) return -2;   // Check norm of z
-  decode_pk(pk_t, seed, pk);
+  STATS_MARK(clk, QTESLA_PHASE_PACK);
+  rsp = test_z(z);
+  STATS_MARK(clk, QTESLA_PHASE_CHECK);
+  if (rsp != 0) return -2;         // Check norm of z
+  if (x == NULL)
+    decode_pk(pk_t, seed, pk);
   
   // Get H(m) and hash_pk
-  SHAKE(hm, HM_BYTES, &sm[CRYPTO_BYTES], smlen-CRYPTO_BYTES);
-  SHAKE(&hm[HM_BYTES], HM_BYTES, pk, CRYPTO_PUBLICKEYBYTES-CRYPTO_SEEDBYTES);
+  if (hm_m == NULL)
+    SHAKE(hm, HM_BYTES, &sm[CRYPTO_BYTES], smlen-CRYPTO_BYTES);
+  else
+    memcpy(hm, hm_m, HM_BYTES);
+  if (x == NULL)
+    SHAKE(&hm[HM_BYTES], HM_BYTES, pk, CRYPTO_PUBLICKEYBYTES-CRYPTO_SEEDBYTES);
+  else
+    memcpy(&hm[HM_BYTES], x->hash_pk, HM_BYTES);
+  STATS_MARK(clk, QTESLA_PHASE_PACK);
 
-  poly_uniform(a, seed);
+  if (x == NULL) {
+    QTESLA_PROBE1(phase_entry, QTESLA_PHASE_GEN_A);
+    poly_uniform(a, seed, work->open.scratch.uniform);
+    QTESLA_PROBE1(phase_return, QTESLA_PHASE_GEN_A);
+    STATS_MARK(clk, QTESLA_PHASE_GEN_A);
+  }
   encode_c(pos_list, sign_list, c);
+  STATS_MARK(clk, QTESLA_PHASE_ENCODE_C);
   poly_ntt(z_ntt, z);
+  STATS_MARK(clk, QTESLA_PHASE_NTT_MUL);
 
-  for (k=0; k<PARAM_K; k++) {      // Compute w = az - tc
-    sparse_mul32(&Tc[k*PARAM_N], &pk_t[k*PARAM_N], pos_list, sign_list);
-    poly_mul(&w[k*PARAM_N], &a[k*PARAM_N], z_ntt);
-    poly_sub_reduce(&w[k*PARAM_N], &w[k*PARAM_N], &Tc[k*PARAM_N]);
-  }    
-  hash_H(c_sig, w, hm);
+  // Compute w = az - tc
+  l.out = w;
+  l.tmp = Tc;
+  l.a = (x == NULL) ? a : x->a;
+  l.x_ntt = z_ntt;
+  l.in = (x == NULL) ? pk_t : x->t;
+  l.pos_list = pos_list;
+  l.sign_list = sign_list;
+  parallel_for(PARAM_K, verify_w_k, &l);
+#ifdef STATS
+  kloop_stats_merge(&l);
+  clk = qtesla_stats_cycles();
+#endif
+  QTESLA_PROBE1(phase_entry, QTESLA_PHASE_HASH_H);
+  hash_H(c_sig, w, hm, work->open.scratch.hash);
+  QTESLA_PROBE1(phase_return, QTESLA_PHASE_HASH_H);
+  STATS_MARK(clk, QTESLA_PHASE_HASH_H);
 
   // Check if the calculated c matches c from the signature
   if (memcmp(c, c_sig, CRYPTO_C_BYTES)) return -3;
@@ -329,3 +1000,158 @@ int crypto_sign_open(unsigned char *m, unsigned long long *mlen, const unsigned
 
   return 0;
 }
+
+
+/************************************************************
+* Name:        crypto_sign_open_ws
+* Description: verification of a signature sm
+* Parameters:  inputs:
+*              - const unsigned char *sm: signature
+*              - unsigned long long smlen: signature length
+*              - const unsigned char* pk: public Key
+*              - void *ws: workspace of CRYPTO_WORKSPACEBYTES bytes
+*              outputs:
+*              - unsigned char *m: original (signed) message
+*              - unsigned long long *mlen: message length*
+* Returns:     0 for valid signature
+*              <0 for invalid signature
+************************************************************/
+int crypto_sign_open_ws(unsigned char *m, unsigned long long *mlen, const unsigned char *sm, unsigned long long smlen, const unsigned char *pk, void *ws)
+{
+  int rsp;
+
+  QTESLA_PROBE1(verify_entry, smlen);
+  rsp = sign_open(m, mlen, sm, smlen, NULL, pk, NULL, ws);
+  QTESLA_PROBE1(verify_return, rsp);
+  return rsp;
+}
+
+
+/************************************************************
+* Name:        qtesla_verify_hm
+* Description: verification of a detached signature of the 
+*              message whose hash H(m) is hm
+* Parameters:  inputs:
+*              - const unsigned char *sig: signature
+*              - unsigned long long siglen: signature length
+*              - const unsigned char *hm: HM_BYTES bytes
+*              - const unsigned char* pk: public Key
+*              - void *ws: workspace of CRYPTO_WORKSPACEBYTES bytes
+* Returns:     0 for valid signature
+*              <0 for invalid signature
+************************************************************/
+int qtesla_verify_hm(const unsigned char *sig, unsigned long long siglen, const unsigned char *hm, const unsigned char *pk, void *ws)
+{
+  unsigned long long mlen;
+  int rsp;
+
+  if (siglen != CRYPTO_BYTES)
+    return -1;
+  QTESLA_PROBE1(verify_entry, siglen);
+  rsp = sign_open(NULL, &mlen, sig, siglen, hm, pk, NULL, ws);
+  QTESLA_PROBE1(verify_return, rsp);
+  return rsp;
+}
+
+
+/************************************************************
+* Name:        qtesla_expand_pk
+* Description: expands a public key for verification (see
+*              keystore.h)
+* Parameters:  inputs:
+*              - const unsigned char* pk: public Key
+*              - void *ws: workspace of CRYPTO_WORKSPACEBYTES bytes
+*              outputs:
+*              - qtesla_pk_expanded_t *x: expanded public key
+************************************************************/
+void qtesla_expand_pk(qtesla_pk_expanded_t *x, const unsigned char *pk, void *ws)
+{
+  unsigned char seed[CRYPTO_SEEDBYTES];
+  workspace_t *work = ws;
+
+  decode_pk(x->t, seed, pk);
+  SHAKE(x->hash_pk, HM_BYTES, pk, CRYPTO_PUBLICKEYBYTES-CRYPTO_SEEDBYTES);
+  poly_uniform(x->a, seed, work->open.scratch.uniform);
+}
+
+
+/************************************************************
+* Name:        qtesla_open_expanded
+* Description: verification of a signature sm with an expanded
+*              public key
+* Parameters:  inputs:
+*              - const unsigned char *sm: signature
+*              - unsigned long long smlen: signature length
+*              - const qtesla_pk_expanded_t *x: expanded public key
+*              - void *ws: workspace of CRYPTO_WORKSPACEBYTES bytes
+*              outputs:
+*              - unsigned char *m: original (signed) message
+*              - unsigned long long *mlen: message length*
+* Returns:     0 for valid signature
+*              <0 for invalid signature
+************************************************************/
+int qtesla_open_expanded(unsigned char *m, unsigned long long *mlen, const unsigned char *sm, unsigned long long smlen, const qtesla_pk_expanded_t *x, void *ws)
+{
+  int rsp;
+
+  QTESLA_PROBE1(verify_entry, smlen);
+  rsp = sign_open(m, mlen, sm, smlen, NULL, NULL, x, ws);
+  QTESLA_PROBE1(verify_return, rsp);
+  return rsp;
+}
+
+
+/*********************************************************
+* crypto_sign_keypair, crypto_sign and crypto_sign_open
+* run the _ws functions with a workspace on the stack
+**********************************************************/
+int crypto_sign_keypair(unsigned char *pk, unsigned char *sk)
+{
+  workspace_t ws;
+
+  return crypto_sign_keypair_ws(pk, sk, &ws);
+}
+
+
+int crypto_sign(unsigned char *sm, unsigned long long *smlen, const unsigned char *m, unsigned long long mlen, const unsigned char* sk)
+{
+  workspace_t ws;
+
+  return crypto_sign_ws(sm, smlen, m, mlen, sk, &ws);
+}
+
+
+int crypto_sign_open(unsigned char *m, unsigned long long *mlen, const unsigned char *sm, unsigned long long smlen, const unsigned char *pk)
+{
+  workspace_t ws;
+
+  return crypto_sign_open_ws(m, mlen, sm, smlen, pk, &ws);
+}
+
+
+int crypto_sign_stream(unsigned char *sm, unsigned long long *smlen, const unsigned char *m, unsigned long long mlen, const unsigned char* sk)
+{
+  stream_workspace_t ws;
+
+  return crypto_sign_stream_ws(sm, smlen, m, mlen, sk, &ws);
+}
+
+
+/**********************************************************
+* qtesla_time_ns and qtesla_clear, helpers shared with
+* the other modules (see sign_step.h)
+**********************************************************/
+uint64_t qtesla_time_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec*1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+
+void qtesla_clear(void *mem, size_t n)
+{ // The barrier keeps the compiler from dropping the memset of memory that is not read again
+  memset(mem, 0, n);
+  __asm__ __volatile__("" : : "r"(mem) : "memory");
+}
@@ -0,0 +1,99 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: per-thread statistics of key generation, signing and verification,
+*           collected when the library is built with STATS=TRUE
+**************************************************************************************/
+
+#ifndef __STATS_H
+#define __STATS_H
+
+#include <stdint.h>
+#include "config.h"
+
+#define QTESLA_STATS_HIST 16   // Buckets of the rejection histograms; the last one also counts larger values
+
+typedef enum {
+  QTESLA_PHASE_GAUSS,        // Gaussian sampling and checks of e_1..e_K and s
+  QTESLA_PHASE_GEN_A,        // Generation of the polynomials a_k
+  QTESLA_PHASE_SAMPLE_Y,     // Sampling of y
+  QTESLA_PHASE_NTT_MUL,      // NTTs and polynomial multiplications
+  QTESLA_PHASE_HASH_H,       // Hash-based function H
+  QTESLA_PHASE_ENCODE_C,     // Encoding of c
+  QTESLA_PHASE_SPARSE_MUL,   // Sparse multiplications by c and the additions that follow them
+  QTESLA_PHASE_CHECK,        // Bound checks on z and w
+  QTESLA_PHASE_PACK,         // Packing and unpacking of keys and signatures, hashing of messages and keys
+  QTESLA_NPHASES
+} qtesla_phase_t;
+
+typedef enum {
+  QTESLA_REJECT_ES,          // e or s rejected by check_ES, per key pair
+  QTESLA_REJECT_Z,           // z rejected by the bound check, per signature
+  QTESLA_REJECT_W,           // w = v - ec rejected by the correctness check, per signature
+  QTESLA_NREJECTS
+} qtesla_reject_t;
+
+typedef struct {
+  unsigned long long keypairs, signatures, verifications;
+  unsigned long long gauss_samples;     // Polynomials e and s sampled, including the rejected ones
+  unsigned long long sign_iterations;   // Rejection iterations of signing, including the accepted ones
+  unsigned long long rejections[QTESLA_NREJECTS];
+  unsigned long long rejection_hist[QTESLA_NREJECTS][QTESLA_STATS_HIST];   // Operations by number of rejections
+  unsigned long long cycles[QTESLA_NPHASES];   // Cycles per phase, including those run by parallel_for() helpers
+} qtesla_stats_t;
+
+// Copies the statistics of the calling thread. Returns 0, or -1 (with zeroed statistics) without STATS=TRUE
+int qtesla_stats_snapshot(qtesla_stats_t *stats);
+
+// Clears the statistics of the calling thread
+void qtesla_stats_reset(void);
+
+// Adds the statistics in "stats" to "total", e.g. to combine the snapshots of several threads
+void qtesla_stats_merge(qtesla_stats_t *total, const qtesla_stats_t *stats);
+
+
+#ifdef STATS
+
+#include <stdatomic.h>
+#if (TARGET != TARGET_AMD64 && TARGET != TARGET_x86)
+  #include <time.h>
+#endif
+
+extern __thread qtesla_stats_t qtesla_stats_local;
+
+static __inline uint64_t qtesla_stats_cycles(void)
+{
+#if (TARGET == TARGET_AMD64 || TARGET == TARGET_x86)
+  unsigned int hi, lo;
+
+  asm volatile ("rdtsc\n\t" : "=a" (lo), "=d"(hi));
+  return ((uint64_t)lo) | (((uint64_t)hi) << 32);
+#else
+  struct timespec time;
+
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (uint64_t)time.tv_sec*1000000000ULL + (uint64_t)time.tv_nsec;
+#endif
+}
+
+static __inline void qtesla_stats_hist(qtesla_reject_t reason, unsigned long long n)
+{
+  qtesla_stats_local.rejections[reason] += n;
+  qtesla_stats_local.rejection_hist[reason][(n < QTESLA_STATS_HIST) ? n : QTESLA_STATS_HIST-1]++;
+}
+
+// STATS_CLOCK(t) starts a clock; STATS_MARK(t, phase) adds the cycles since then to "phase" and restarts it.
+// STATS_MARK_SHARED does the same on an array of atomic counters shared by the threads of parallel_for()
+#define STATS_CLOCK(t)                  uint64_t t = qtesla_stats_cycles()
+#define STATS_MARK(t, phase)            do { uint64_t now_ = qtesla_stats_cycles(); qtesla_stats_local.cycles[phase] += now_ - (t); (t) = now_; } while (0)
+#define STATS_MARK_SHARED(c, t, phase)  do { uint64_t now_ = qtesla_stats_cycles(); atomic_fetch_add(&(c)[phase], now_ - (t)); (t) = now_; } while (0)
+
+#else
+
+#define STATS_CLOCK(t)
+#define STATS_MARK(t, phase)
+#define STATS_MARK_SHARED(c, t, phase)
+
+#endif
+
+#endif
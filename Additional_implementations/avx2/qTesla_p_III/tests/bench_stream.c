@@ -0,0 +1,146 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: memory and speed of crypto_sign_ws against the streaming crypto_sign_stream_ws.
+*           Peak stack is measured by signing on a thread whose stack is filled with a
+*           pattern beforehand and counting the bytes that were overwritten
+*
+* Usage: bench_stream [nruns]
+**************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "../random/random.h"
+#include "../api.h"
+#include "cpucycles.h"
+
+#define MLEN 59
+#define NRUNS 1000
+#define STACK_BYTES (1 << 20)
+#define STACK_PATTERN 0xA5
+
+typedef int (*sign_ws_t)(unsigned char *, unsigned long long *, const unsigned char *, unsigned long long, const unsigned char *, void *);
+
+typedef struct {
+  sign_ws_t sign;
+  void *ws;
+  const unsigned char *sk;
+  unsigned int nruns;
+  unsigned long long *cycles;
+  double seconds;
+} run_t;
+
+
+static int cmp_llu(const void *a, const void*b)
+{
+  if (*(unsigned long long *)a < *(unsigned long long *)b) return -1;
+  if (*(unsigned long long *)a > *(unsigned long long *)b) return 1;
+  return 0;
+}
+
+
+static double wall_time(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + 1e-9*(double)ts.tv_nsec;
+}
+
+
+static void *run_sign(void *arg)
+{ // Signs nruns random messages, recording the cycles of each signature
+  run_t *r = arg;
+  unsigned char m[MLEN], sm[MLEN+CRYPTO_BYTES];
+  unsigned long long smlen, t0;
+  unsigned int i;
+  double t;
+
+  t = wall_time();
+  for (i = 0; i < r->nruns; i++) {
+    randombytes(m, MLEN);
+    t0 = cpucycles();
+    r->sign(sm, &smlen, m, MLEN, r->sk, r->ws);
+    r->cycles[i] = cpucycles() - t0;
+  }
+  r->seconds = wall_time() - t;
+  return NULL;
+}
+
+
+static size_t run_on_painted_stack(run_t *r)
+{ // Runs run_sign on a thread with a painted stack and returns the number of stack bytes it touched
+  pthread_attr_t attr;
+  pthread_t thread;
+  unsigned char *stack;
+  size_t used;
+
+  if (posix_memalign((void **)&stack, 4096, STACK_BYTES) != 0)
+    return 0;
+  memset(stack, STACK_PATTERN, STACK_BYTES);
+  pthread_attr_init(&attr);
+  pthread_attr_setstack(&attr, stack, STACK_BYTES);
+  if (pthread_create(&thread, &attr, run_sign, r) != 0) {
+    pthread_attr_destroy(&attr);
+    free(stack);
+    return 0;
+  }
+  pthread_join(thread, NULL);
+  pthread_attr_destroy(&attr);
+
+  for (used = STACK_BYTES; used > 0 && stack[STACK_BYTES-used] == STACK_PATTERN; used--);
+  free(stack);
+  return used;
+}
+
+
+int main(int argc, char **argv)
+{
+  static const char *names[2] = { "crypto_sign_ws", "crypto_sign_stream_ws" };
+  static const sign_ws_t signs[2] = { crypto_sign_ws, crypto_sign_stream_ws };
+  static const size_t ws_bytes[2] = { CRYPTO_WORKSPACEBYTES, CRYPTO_STREAM_WORKSPACEBYTES };
+  unsigned char pk[CRYPTO_PUBLICKEYBYTES], sk[CRYPTO_SECRETKEYBYTES];
+  unsigned int nruns, i;
+  size_t stack;
+  run_t r;
+
+  nruns = (argc > 1) ? (unsigned int)atoi(argv[1]) : NRUNS;
+  if (nruns == 0)
+    return -1;
+  r.cycles = malloc(nruns*sizeof(unsigned long long));
+  if (r.cycles == NULL)
+    return -1;
+  crypto_sign_keypair(pk, sk);
+
+  printf("\n");
+  printf("===========================================================================================\n");
+  printf("Memory and speed of signing for %s, %u signatures\n", CRYPTO_ALGNAME, nruns);
+  printf("===========================================================================================\n\n");
+  printf("function                 workspace   peak stack   total bytes   median ");
+  print_unit;
+  printf("   sign/s\n");
+
+  for (i = 0; i < 2; i++) {
+    if (posix_memalign(&r.ws, CRYPTO_WORKSPACEALIGN, ws_bytes[i]) != 0)
+      return -1;
+    r.sign = signs[i];
+    r.sk = sk;
+    r.nruns = nruns;
+    stack = run_on_painted_stack(&r);
+    if (stack == 0) {
+      printf("Thread creation FAILED. \n");
+      return -1;
+    }
+    qsort(r.cycles, nruns, sizeof(unsigned long long), cmp_llu);
+    printf("%-22s %11zu %12zu %13zu %13llu %8.0f\n", names[i], ws_bytes[i], stack, ws_bytes[i] + stack,
+           r.cycles[nruns/2], nruns/r.seconds);
+    free(r.ws);
+  }
+  printf("\n");
+
+  free(r.cycles);
+  return 0;
+}
@@ -0,0 +1,450 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: differential test of the AVX2 kernels against the reference implementation.
+*           Every kernel runs on the same random inputs in both implementations, the
+*           first output that differs is reported with its trial and position, and
+*           the median cycles of both give the speedup of each kernel
+*
+* Usage: diff_kernels [-n trials] [-seed hex]
+*        Inputs of trial i are derived from SHAKE256(seed || i). The seed is random
+*        unless given as 64 hex digits, and is printed so that a mismatch can be
+*        reproduced. Returns 1 if any kernel differs
+*
+* The reference library is linked from objs/ref_qtesla.o, with all of its global
+* symbols renamed with the prefix "ref_" (see "make diff")
+**************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../random/random.h"
+#include "../api.h"
+#include "../params.h"
+#include "../poly.h"
+#include "../pack.h"
+#include "../sample.h"
+#include "../gauss.h"
+#include "../sha3/fips202.h"
+#include "../sha3/fips202x8.h"
+#include "cpucycles.h"
+
+#if (TARGET == TARGET_ARM || TARGET == TARGET_ARM64)
+  #define UNIT "nsec"
+#else
+  #define UNIT "cycles"
+#endif
+
+#define IMPLEMENTATION "avx2"
+#define NTRIALS 1000
+#define REF_POLY_UNIFORM_BYTES (SHAKE128_RATE*PARAM_GEN_A)
+#define BPLUS1BYTES (((PARAM_B_BITS+1)+7)/8)
+#define REF_(f) ref_##f
+#define REF(f) REF_(f)   // REF(cSHAKE) is the reference cSHAKE of this parameter set
+#define OUT_BYTES (sizeof(poly_k) + CRYPTO_PUBLICKEYBYTES + CRYPTO_SECRETKEYBYTES)
+
+// Reference implementation, with the types of "poly.h" spelled out
+void ref_shake128(unsigned char *output, unsigned long long outlen, const unsigned char *input, unsigned long long inlen);
+void ref_shake256(unsigned char *output, unsigned long long outlen, const unsigned char *input, unsigned long long inlen);
+void ref_cshake128_simple(unsigned char *output, unsigned long long outlen, uint16_t cstm, const unsigned char *in, unsigned long long inlen);
+void ref_cshake256_simple(unsigned char *output, unsigned long long outlen, uint16_t cstm, const unsigned char *in, unsigned long long inlen);
+void ref_poly_uniform(int32_t *a, const unsigned char *seed, unsigned char *buf);
+void ref_sample_y(int32_t *y, const unsigned char *seed, int nonce);
+void ref_sample_gauss_poly(int32_t *z, const unsigned char *seed, int nonce);
+int ref_check_ES(int32_t *p, unsigned int bound);
+unsigned int ref_sample_gauss_poly_batch(int32_t *z[], const unsigned char *seed[], int nonce, unsigned int n,
+                                         int (*check)(int32_t *, unsigned int), const unsigned int bound[]);
+void ref_poly_ntt(int32_t *x_ntt, const int32_t *x);
+void ref_poly_mul(int32_t *result, const int32_t *x, const int32_t *y);
+void ref_poly_add(int32_t *result, const int32_t *x, const int32_t *y);
+void ref_poly_add_correct(int32_t *result, const int32_t *x, const int32_t *y);
+void ref_poly_sub(int32_t *result, const int32_t *x, const int32_t *y);
+void ref_poly_sub_reduce(int32_t *result, const int32_t *x, const int32_t *y);
+void ref_sparse_mul8(int32_t *prod, const unsigned char *s, const uint32_t pos_list[PARAM_H], const int16_t sign_list[PARAM_H]);
+void ref_sparse_mul32(int32_t *prod, const int32_t *pk, const uint32_t pos_list[PARAM_H], const int16_t sign_list[PARAM_H]);
+void ref_hash_H(unsigned char *c_bin, int32_t *v, const unsigned char *hm, unsigned char *t);
+void ref_encode_c(uint32_t *pos_list, int16_t *sign_list, unsigned char *c_bin);
+void ref_encode_sk(unsigned char *sk, const int32_t *s, const int32_t *e, const unsigned char *seeds, const unsigned char *hash_pk);
+void ref_encode_pk(unsigned char *pk, const int32_t *t, const unsigned char *seedA);
+void ref_decode_pk(int32_t *pk, unsigned char *seedA, const unsigned char *pk_in);
+void ref_encode_sig(unsigned char *sm, unsigned char *c, int32_t *z);
+void ref_decode_sig(unsigned char *c, int32_t *z, const unsigned char *sm);
+
+typedef struct {   // Inputs of one trial, and the output of the kernel that runs on them
+  poly_k a, e, t, v;
+  poly s, y, z, sc;
+  poly2x y_ntt;
+  unsigned char seed[CRYPTO_RANDOMBYTES], seeds[(PARAM_K+3)*CRYPTO_SEEDBYTES];
+  unsigned char hm[2*HM_BYTES], c[CRYPTO_C_BYTES];
+  unsigned char pk[CRYPTO_PUBLICKEYBYTES], sk[CRYPTO_SECRETKEYBYTES], sm[CRYPTO_BYTES];
+  unsigned char uniform_buf[(POLY_UNIFORM_BYTES > REF_POLY_UNIFORM_BYTES) ? POLY_UNIFORM_BYTES : REF_POLY_UNIFORM_BYTES];
+  unsigned char hash_buf[HASH_H_BYTES];
+  int32_t pk_t[PARAM_N*PARAM_K];
+  uint32_t pos_list[PARAM_H];
+  int16_t sign_list[PARAM_H];
+  int32_t samp[GAUSS_BATCH_BYTES/sizeof(int32_t)];
+  unsigned int bound;
+  int nonce;
+  unsigned char out[OUT_BYTES] __attribute__((aligned(32)));
+} data_t;
+
+typedef struct {
+  const char *name;
+  void (*ref)(data_t *);
+  void (*opt)(data_t *);
+  size_t outlen;    // Bytes of d->out written by both
+  size_t width;     // Compared and reported as words of this many bytes: 4 for coefficients, 1 for bytes
+} kernel_t;
+
+static data_t in, d_ref, d_opt;
+
+
+static void k_shake128_ref(data_t *d)      { ref_shake128(d->out, (PARAM_K+3)*CRYPTO_SEEDBYTES, d->seed, CRYPTO_RANDOMBYTES); }
+static void k_shake128_opt(data_t *d)      { shake128(d->out, (PARAM_K+3)*CRYPTO_SEEDBYTES, d->seed, CRYPTO_RANDOMBYTES); }
+static void k_shake256_ref(data_t *d)      { ref_shake256(d->out, (PARAM_K+3)*CRYPTO_SEEDBYTES, d->seed, CRYPTO_RANDOMBYTES); }
+static void k_shake256_opt(data_t *d)      { shake256(d->out, (PARAM_K+3)*CRYPTO_SEEDBYTES, d->seed, CRYPTO_RANDOMBYTES); }
+static void k_cshake128_ref(data_t *d)     { ref_cshake128_simple(d->out, SHAKE128_RATE, (uint16_t)d->nonce, d->seed, CRYPTO_RANDOMBYTES); }
+static void k_cshake128_opt(data_t *d)     { cshake128_simple(d->out, SHAKE128_RATE, (uint16_t)d->nonce, d->seed, CRYPTO_RANDOMBYTES); }
+
+static void k_cshake128_batch_ref(data_t *d)
+{ // One block of each lane, one lane at a time
+  for (int j = 0; j < KECCAK_LANES; j++)
+    ref_cshake128_simple(&d->out[j*SHAKE128_RATE], SHAKE128_RATE, (uint16_t)(d->nonce+j), &d->seeds[(j % (PARAM_K+3))*CRYPTO_SEEDBYTES], CRYPTO_SEEDBYTES);
+}
+
+static void k_cshake128_batch_opt(data_t *d)
+{
+  unsigned char *out[KECCAK_LANES];
+  const unsigned char *seeds[KECCAK_LANES];
+  uint16_t cstm[KECCAK_LANES];
+
+  for (int j = 0; j < KECCAK_LANES; j++) {
+    out[j] = &d->out[j*SHAKE128_RATE];
+    seeds[j] = &d->seeds[(j % (PARAM_K+3))*CRYPTO_SEEDBYTES];
+    cstm[j] = (uint16_t)(d->nonce+j);
+  }
+  cshake128_simple_batch(out, SHAKE128_RATE, cstm, seeds, CRYPTO_SEEDBYTES, KECCAK_LANES);
+}
+
+static void k_poly_uniform_ref(data_t *d)  { ref_poly_uniform((int32_t *)d->out, d->seed, d->uniform_buf); }
+static void k_poly_uniform_opt(data_t *d)  { poly_uniform((int32_t *)d->out, d->seed, d->uniform_buf); }
+
+static void sample_y_4x(int32_t *y, const unsigned char *seed, int nonce)
+{ // The AVX2 sample_y reads its first PARAM_N values from four cSHAKE128 streams, with customizations nonce<<8
+  // to (nonce<<8)+3, so its output differs from that of the reference sample_y by design (see KAT/avx2).
+  // This is the same layout computed with the reference cSHAKE, one stream at a time
+  unsigned char buf[PARAM_N*BPLUS1BYTES + 1];
+  unsigned int i = 0, pos = 0, nblocks = PARAM_N, nbytes = BPLUS1BYTES;
+  int16_t dmsp = (int16_t)(nonce<<8);
+  int32_t v;
+
+  for (int j = 0; j < 4; j++)
+    ref_cshake128_simple(&buf[j*(PARAM_N*nbytes/4)], PARAM_N*nbytes/4, (uint16_t)(dmsp+j), seed, CRYPTO_RANDOMBYTES);
+  dmsp += 4;
+  while (i < PARAM_N) {
+    if (pos > nblocks*nbytes - 4*nbytes) {
+      nblocks = SHAKE_RATE/nbytes;
+      REF(cSHAKE)(buf, SHAKE_RATE, (uint16_t)dmsp++, seed, CRYPTO_RANDOMBYTES);
+      pos = 0;
+    }
+    for (int j = 0; j < 4; j++) {
+      v = (int32_t)((*(uint32_t *)(buf+pos+j*nbytes)) & ((1<<(PARAM_B_BITS+1))-1)) - PARAM_B;
+      if (i < PARAM_N && v != (1<<PARAM_B_BITS))
+        y[i++] = v;
+    }
+    pos += 4*nbytes;
+  }
+}
+
+static void k_sample_y_ref(data_t *d)      { sample_y_4x((int32_t *)d->out, d->seed, d->nonce); }
+static void k_sample_y_opt(data_t *d)      { sample_y((int32_t *)d->out, d->seed, d->nonce); }
+static void k_sample_gauss_ref(data_t *d)  { ref_sample_gauss_poly((int32_t *)d->out, d->seed, d->nonce); }
+static void k_sample_gauss_opt(data_t *d)  { sample_gauss_poly((int32_t *)d->out, d->seed, d->nonce); }
+static void k_check_ES_ref(data_t *d)      { *(int32_t *)d->out = ref_check_ES(d->s, d->bound); }
+static void k_check_ES_opt(data_t *d)      { *(int32_t *)d->out = check_ES(d->s, d->bound); }
+
+static void k_sample_gauss_batch(data_t *d, int ref)
+{ // Output: the polynomials up to the first rejected one, then the number accepted
+  int32_t *z[GAUSS_BATCH];
+  const unsigned char *seeds[GAUSS_BATCH];
+  unsigned int bounds[GAUSS_BATCH], n;
+
+  for (int j = 0; j < GAUSS_BATCH; j++) {
+    z[j] = &((int32_t *)d->out)[j*PARAM_N];
+    seeds[j] = &d->seeds[(j % (PARAM_K+1))*CRYPTO_SEEDBYTES];
+    bounds[j] = d->bound;
+  }
+  if (ref)
+    n = ref_sample_gauss_poly_batch(z, seeds, d->nonce, GAUSS_BATCH, ref_check_ES, bounds);
+  else
+    n = sample_gauss_poly_batch(z, seeds, d->nonce, GAUSS_BATCH, check_ES, bounds, d->samp);
+  if (n+1 < GAUSS_BATCH)   // The polynomials after the rejected one are unspecified
+    memset(z[n+1], 0, (GAUSS_BATCH-n-1)*sizeof(poly));
+  ((int32_t *)d->out)[GAUSS_BATCH*PARAM_N] = (int32_t)n;
+}
+
+static void k_sample_gauss_batch_ref(data_t *d) { k_sample_gauss_batch(d, 1); }
+static void k_sample_gauss_batch_opt(data_t *d) { k_sample_gauss_batch(d, 0); }
+
+static void k_ntt_pmul_ref(data_t *d)
+{ // poly_ntt followed by poly_mul, since the NTT forms of the two implementations differ
+  ref_poly_ntt(d->y_ntt, d->y);
+  ref_poly_mul((int32_t *)d->out, d->a, d->y_ntt);
+}
+
+static void k_ntt_pmul_opt(data_t *d)
+{
+  poly_ntt(d->y_ntt, d->y);
+  poly_mul((int32_t *)d->out, d->a, d->y_ntt);
+}
+
+static void k_poly_add_ref(data_t *d)         { ref_poly_add((int32_t *)d->out, d->y, d->sc); }
+static void k_poly_add_opt(data_t *d)         { poly_add((int32_t *)d->out, d->y, d->sc); }
+static void k_poly_add_correct_ref(data_t *d) { ref_poly_add_correct((int32_t *)d->out, d->v, d->e); }
+static void k_poly_add_correct_opt(data_t *d) { poly_add_correct((int32_t *)d->out, d->v, d->e); }
+static void k_poly_sub_ref(data_t *d)         { ref_poly_sub((int32_t *)d->out, d->v, d->sc); }
+static void k_poly_sub_opt(data_t *d)         { poly_sub((int32_t *)d->out, d->v, d->sc); }
+static void k_poly_sub_reduce_ref(data_t *d)  { ref_poly_sub_reduce((int32_t *)d->out, d->v, d->sc); }
+static void k_poly_sub_reduce_opt(data_t *d)  { poly_sub_reduce((int32_t *)d->out, d->v, d->sc); }
+static void k_sparse_mul8_ref(data_t *d)      { ref_sparse_mul8((int32_t *)d->out, d->sk, d->pos_list, d->sign_list); }
+static void k_sparse_mul8_opt(data_t *d)      { sparse_mul8((int32_t *)d->out, d->sk, d->pos_list, d->sign_list); }
+static void k_sparse_mul32_ref(data_t *d)     { ref_sparse_mul32((int32_t *)d->out, d->pk_t, d->pos_list, d->sign_list); }
+static void k_sparse_mul32_opt(data_t *d)     { sparse_mul32((int32_t *)d->out, d->pk_t, d->pos_list, d->sign_list); }
+static void k_hash_H_ref(data_t *d)           { ref_hash_H(d->out, d->v, d->hm, d->hash_buf); }
+static void k_hash_H_opt(data_t *d)           { hash_H(d->out, d->v, d->hm, d->hash_buf); }
+
+static void k_encode_c(data_t *d, int ref)
+{ // Output: pos_list, then sign_list widened to 32 bits
+  uint32_t *pos_list = (uint32_t *)d->out;
+  int16_t sign_list[PARAM_H];
+
+  if (ref)
+    ref_encode_c(pos_list, sign_list, d->c);
+  else
+    encode_c(pos_list, sign_list, d->c);
+  for (int i = 0; i < PARAM_H; i++)
+    ((int32_t *)d->out)[PARAM_H+i] = sign_list[i];
+}
+
+static void k_encode_c_ref(data_t *d)         { k_encode_c(d, 1); }
+static void k_encode_c_opt(data_t *d)         { k_encode_c(d, 0); }
+static void k_encode_sk_ref(data_t *d)        { ref_encode_sk(d->out, d->s, d->e, &d->seeds[(PARAM_K+1)*CRYPTO_SEEDBYTES], d->hm); }
+static void k_encode_sk_opt(data_t *d)        { encode_sk(d->out, d->s, d->e, &d->seeds[(PARAM_K+1)*CRYPTO_SEEDBYTES], d->hm); }
+static void k_encode_pk_ref(data_t *d)        { ref_encode_pk(d->out, d->t, d->seeds); }
+static void k_encode_pk_opt(data_t *d)        { encode_pk(d->out, d->t, d->seeds); }
+static void k_decode_pk_ref(data_t *d)        { ref_decode_pk((int32_t *)d->out, &d->out[sizeof(poly_k)], d->pk); }
+static void k_decode_pk_opt(data_t *d)        { decode_pk((int32_t *)d->out, &d->out[sizeof(poly_k)], d->pk); }
+static void k_encode_sig_ref(data_t *d)       { ref_encode_sig(d->out, d->c, d->z); }
+static void k_encode_sig_opt(data_t *d)       { encode_sig(d->out, d->c, d->z); }
+static void k_decode_sig_ref(data_t *d)       { ref_decode_sig(d->out, (int32_t *)&d->out[CRYPTO_C_BYTES], d->sm); }
+static void k_decode_sig_opt(data_t *d)       { decode_sig(d->out, (int32_t *)&d->out[CRYPTO_C_BYTES], d->sm); }
+
+static const kernel_t kernels[] = {
+  {"shake128", k_shake128_ref, k_shake128_opt, (PARAM_K+3)*CRYPTO_SEEDBYTES, 1},
+  {"shake256", k_shake256_ref, k_shake256_opt, (PARAM_K+3)*CRYPTO_SEEDBYTES, 1},
+  {"cshake128_block", k_cshake128_ref, k_cshake128_opt, SHAKE128_RATE, 1},
+  {"cshake128_batch", k_cshake128_batch_ref, k_cshake128_batch_opt, KECCAK_LANES*SHAKE128_RATE, 1},
+  {"poly_uniform", k_poly_uniform_ref, k_poly_uniform_opt, sizeof(poly_k), 4},
+  {"sample_y", k_sample_y_ref, k_sample_y_opt, sizeof(poly), 4},
+  {"sample_gauss_poly", k_sample_gauss_ref, k_sample_gauss_opt, sizeof(poly), 4},
+  {"sample_gauss_batch", k_sample_gauss_batch_ref, k_sample_gauss_batch_opt, GAUSS_BATCH*sizeof(poly)+4, 4},
+  {"check_ES", k_check_ES_ref, k_check_ES_opt, 4, 4},
+  {"ntt_pmul", k_ntt_pmul_ref, k_ntt_pmul_opt, sizeof(poly), 4},
+  {"poly_add", k_poly_add_ref, k_poly_add_opt, sizeof(poly), 4},
+  {"poly_add_correct", k_poly_add_correct_ref, k_poly_add_correct_opt, sizeof(poly), 4},
+  {"poly_sub", k_poly_sub_ref, k_poly_sub_opt, sizeof(poly), 4},
+  {"poly_sub_reduce", k_poly_sub_reduce_ref, k_poly_sub_reduce_opt, sizeof(poly), 4},
+  {"sparse_mul8", k_sparse_mul8_ref, k_sparse_mul8_opt, sizeof(poly), 4},
+  {"sparse_mul32", k_sparse_mul32_ref, k_sparse_mul32_opt, sizeof(poly), 4},
+  {"hash_H", k_hash_H_ref, k_hash_H_opt, CRYPTO_C_BYTES, 1},
+  {"encode_c", k_encode_c_ref, k_encode_c_opt, 2*PARAM_H*4, 4},
+  {"encode_sk", k_encode_sk_ref, k_encode_sk_opt, CRYPTO_SECRETKEYBYTES, 1},
+  {"encode_pk", k_encode_pk_ref, k_encode_pk_opt, CRYPTO_PUBLICKEYBYTES, 1},
+  {"decode_pk", k_decode_pk_ref, k_decode_pk_opt, sizeof(poly_k)+CRYPTO_SEEDBYTES, 4},
+  {"encode_sig", k_encode_sig_ref, k_encode_sig_opt, CRYPTO_BYTES, 1},
+  {"decode_sig", k_decode_sig_ref, k_decode_sig_opt, CRYPTO_C_BYTES+sizeof(poly), 4},
+};
+
+#define NKERNELS (sizeof(kernels)/sizeof(kernels[0]))
+
+typedef struct {
+  unsigned long long *ref_cycles, *opt_cycles;
+  unsigned int mismatches;
+  unsigned int trial;          // Of the first mismatch
+  size_t offset;               // Of the first differing word, in bytes
+  int32_t ref_value, opt_value;
+} result_t;
+
+
+static int cmp_llu(const void *a, const void*b)
+{
+  if (*(unsigned long long *)a < *(unsigned long long *)b) return -1;
+  if (*(unsigned long long *)a > *(unsigned long long *)b) return 1;
+  return 0;
+}
+
+
+static uint32_t uniform(const unsigned char **r, uint32_t range)
+{ // Next value in [0, range) from the trial's random bytes
+  uint32_t x = (uint32_t)(*r)[0] | (uint32_t)(*r)[1] << 8 | (uint32_t)(*r)[2] << 16 | (uint32_t)(*r)[3] << 24;
+
+  *r += 4;
+  return x % range;
+}
+
+
+static void init_trial(data_t *d, const unsigned char master[32], unsigned int trial)
+{ // Inputs in the ranges the kernels see when signing, derived from SHAKE256(master || trial) with the reference code
+  static unsigned char rnd[4*(4*PARAM_K+3)*PARAM_N + 1024];
+  unsigned char seed[36];
+  const unsigned char *r = rnd;
+  int k;
+
+  memcpy(seed, master, 32);
+  for (k = 0; k < 4; k++)
+    seed[32+k] = (unsigned char)(trial >> 8*k);
+  ref_shake256(rnd, sizeof(rnd), seed, sizeof(seed));
+  memcpy(d->seed, r, CRYPTO_RANDOMBYTES);     r += CRYPTO_RANDOMBYTES;
+  memcpy(d->hm, r, 2*HM_BYTES);               r += 2*HM_BYTES;
+  memcpy(d->c, r, CRYPTO_C_BYTES);            r += CRYPTO_C_BYTES;
+  d->nonce = 1 + (int)uniform(&r, 250);       // sample_y takes nonces up to 255
+  ref_shake128(d->seeds, (PARAM_K+3)*CRYPTO_SEEDBYTES, d->seed, CRYPTO_RANDOMBYTES);
+
+  ref_poly_uniform(d->a, &d->seeds[(PARAM_K+1)*CRYPTO_SEEDBYTES], d->uniform_buf);
+  for (k = 0; k < PARAM_K; k++)
+    ref_sample_gauss_poly(&d->e[k*PARAM_N], &d->seeds[k*CRYPTO_SEEDBYTES], k+1);
+  ref_sample_gauss_poly(d->s, &d->seeds[PARAM_K*CRYPTO_SEEDBYTES], PARAM_K+1);
+  ref_sample_y(d->y, d->seed, d->nonce);
+  for (k = 0; k < PARAM_K*PARAM_N; k++) {
+    d->t[k] = (int32_t)uniform(&r, PARAM_Q);
+    d->v[k] = (int32_t)uniform(&r, PARAM_Q);
+  }
+  for (k = 0; k < PARAM_N; k++)
+    d->z[k] = (int32_t)uniform(&r, 2*(PARAM_B-PARAM_S)+1) - (PARAM_B-PARAM_S);
+  d->bound = (uniform(&r, 2) == 0) ? PARAM_KEYGEN_BOUND_S : uniform(&r, PARAM_KEYGEN_BOUND_S);   // Half the trials reject more often
+
+  ref_encode_c(d->pos_list, d->sign_list, d->c);
+  ref_encode_sk(d->sk, d->s, d->e, &d->seeds[(PARAM_K+1)*CRYPTO_SEEDBYTES], d->hm);
+  ref_encode_pk(d->pk, d->t, d->seeds);
+  ref_decode_pk(d->pk_t, d->seeds, d->pk);
+  ref_encode_sig(d->sm, d->c, d->z);
+  ref_sparse_mul8(d->sc, d->sk, d->pos_list, d->sign_list);
+  memset(d->out, 0, sizeof(d->out));
+}
+
+
+static void run_trial(const kernel_t *k, unsigned int trial, result_t *res)
+{ // Runs the kernel of both implementations on copies of the trial's inputs and compares their outputs
+  unsigned long long t0;
+  size_t i;
+
+  d_ref = in;
+  d_opt = in;
+  t0 = cpucycles();
+  k->ref(&d_ref);
+  res->ref_cycles[trial] = cpucycles() - t0;
+  t0 = cpucycles();
+  k->opt(&d_opt);
+  res->opt_cycles[trial] = cpucycles() - t0;
+
+  if (memcmp(d_ref.out, d_opt.out, k->outlen) == 0)
+    return;
+  if (res->mismatches++ > 0)
+    return;
+  for (i = 0; i < k->outlen; i += k->width)
+    if (memcmp(&d_ref.out[i], &d_opt.out[i], k->width) != 0)
+      break;
+  res->trial = trial;
+  res->offset = i;
+  res->ref_value = (k->width == 4) ? *(int32_t *)&d_ref.out[i] : d_ref.out[i];
+  res->opt_value = (k->width == 4) ? *(int32_t *)&d_opt.out[i] : d_opt.out[i];
+}
+
+
+static int parse_seed(unsigned char seed[32], const char *hex)
+{
+  unsigned int i, b;
+
+  if (strlen(hex) != 64)
+    return -1;
+  for (i = 0; i < 32; i++) {
+    if (sscanf(&hex[2*i], "%2x", &b) != 1)
+      return -1;
+    seed[i] = (unsigned char)b;
+  }
+  return 0;
+}
+
+
+int main(int argc, char **argv)
+{
+  unsigned int ntrials = NTRIALS, i, j, failed = 0;
+  unsigned char master[32];
+  result_t *results;
+  int seeded = 0;
+
+  for (i = 1; i < (unsigned int)argc; i++) {
+    if (strcmp(argv[i], "-n") == 0 && i+1 < (unsigned int)argc)
+      ntrials = (unsigned int)atoi(argv[++i]);
+    else if (strcmp(argv[i], "-seed") == 0 && i+1 < (unsigned int)argc && parse_seed(master, argv[i+1]) == 0) {
+      seeded = 1;
+      i++;
+    } else {
+      printf("Usage: %s [-n trials] [-seed hex]\n", argv[0]);
+      return -1;
+    }
+  }
+  if (ntrials == 0)
+    return -1;
+  if (!seeded)
+    randombytes(master, sizeof(master));
+  results = calloc(NKERNELS, sizeof(result_t));
+  if (results == NULL)
+    return -1;
+  for (j = 0; j < NKERNELS; j++) {
+    results[j].ref_cycles = malloc(ntrials*sizeof(unsigned long long));
+    results[j].opt_cycles = malloc(ntrials*sizeof(unsigned long long));
+    if (results[j].ref_cycles == NULL || results[j].opt_cycles == NULL)
+      return -1;
+  }
+
+  printf("\n");
+  printf("===========================================================================================\n");
+  printf("Differential test of the %s kernels of %s against the reference, %u trials\n", IMPLEMENTATION, CRYPTO_ALGNAME, ntrials);
+  printf("===========================================================================================\n\n");
+  printf("Seed: ");
+  for (i = 0; i < 32; i++)
+    printf("%02x", master[i]);
+  printf("\n\n");
+
+  for (i = 0; i < ntrials; i++) {
+    init_trial(&in, master, i);
+    for (j = 0; j < NKERNELS; j++)
+      run_trial(&kernels[j], i, &results[j]);
+  }
+
+  printf("kernel               ref " UNIT "   %s " UNIT "   speedup   result\n", IMPLEMENTATION);
+  for (j = 0; j < NKERNELS; j++) {
+    result_t *r = &results[j];
+
+    qsort(r->ref_cycles, ntrials, sizeof(unsigned long long), cmp_llu);
+    qsort(r->opt_cycles, ntrials, sizeof(unsigned long long), cmp_llu);
+    printf("%-20s %10llu %12llu %8.2fx   ", kernels[j].name, r->ref_cycles[ntrials/2], r->opt_cycles[ntrials/2],
+           (double)r->ref_cycles[ntrials/2]/(double)(r->opt_cycles[ntrials/2] ? r->opt_cycles[ntrials/2] : 1));
+    if (r->mismatches == 0) {
+      printf("ok\n");
+      continue;
+    }
+    failed++;
+    printf("MISMATCH in %u trials, first in trial %u at %s %zu: ref %d, %s %d\n", r->mismatches, r->trial,
+           (kernels[j].width == 4) ? "word" : "byte", r->offset/kernels[j].width, r->ref_value, IMPLEMENTATION, r->opt_value);
+  }
+  printf("\n%u of %u kernels differ from the reference\n\n", failed, (unsigned int)NKERNELS);
+
+  for (j = 0; j < NKERNELS; j++) {
+    free(results[j].ref_cycles);
+    free(results[j].opt_cycles);
+  }
+  free(results);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,77 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: interleaves signatures on one thread with the coroutine wrapper in
+*           sign_coro.hpp and verifies them
+**************************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "../sign_coro.hpp"
+extern "C" {
+#include "../random/random.h"
+}
+
+#define MLEN 59
+#define NCORO 32
+
+
+int main(void)
+{
+  static unsigned char pk[CRYPTO_PUBLICKEYBYTES], sk[CRYPTO_SECRETKEYBYTES];
+  static unsigned char m[NCORO][MLEN], sm[NCORO][MLEN+CRYPTO_BYTES], mo[MLEN+CRYPTO_BYTES];
+  unsigned long long smlen[NCORO], mlen;
+  unsigned int i;
+  qtesla::round_robin sched;
+  std::vector<qtesla::task<int>> tasks;
+
+  printf("\n");
+  printf("===========================================================================================\n");
+  printf("Coroutine signing for %s, %d signatures interleaved on one thread\n", CRYPTO_ALGNAME, NCORO);
+  printf("===========================================================================================\n\n");
+
+  crypto_sign_keypair(pk, sk);
+  tasks.reserve(NCORO);
+  for (i = 0; i < NCORO; i++) {
+    randombytes(m[i], MLEN);
+    tasks.push_back(qtesla::sign(sched, sm[i], &smlen[i], m[i], MLEN, sk));
+    sched.spawn(tasks.back());
+  }
+  sched.run();
+
+  if (qtesla::workspaces_in_use != 0) {
+    printf("%lu workspaces held after the tasks completed. \n", qtesla::workspaces_in_use.load());
+    return -1;
+  }
+  for (i = 0; i < NCORO; i++) {
+    if (!tasks[i].done() || tasks[i].result() != 0 || crypto_sign_open(mo, &mlen, sm[i], smlen[i], pk) != 0 ||
+        mlen != MLEN || memcmp(m[i], mo, MLEN) != 0) {
+      printf("Coroutine signature verification FAILED. \n");
+      return -1;
+    }
+  }
+
+  {   // Tasks destroyed before they complete must release their workspaces
+    qtesla::round_robin abandoned;
+    std::vector<qtesla::task<int>> partial;
+    unsigned long suspended = 0;
+
+    partial.reserve(NCORO);
+    for (i = 0; i < NCORO; i++) {
+      partial.push_back(qtesla::sign(abandoned, sm[i], &smlen[i], m[i], MLEN, sk));
+      partial.back().handle().resume();
+      suspended += !partial.back().done();
+    }
+    if (suspended == 0 || qtesla::workspaces_in_use != suspended) {
+      printf("%lu workspaces held by %lu suspended tasks. \n", qtesla::workspaces_in_use.load(), suspended);
+      return -1;
+    }
+  }
+  if (qtesla::workspaces_in_use != 0) {
+    printf("%lu workspaces held after the tasks were destroyed. \n", qtesla::workspaces_in_use.load());
+    return -1;
+  }
+  printf("Coroutine signing tests PASSED... \n\n");
+  return 0;
+}
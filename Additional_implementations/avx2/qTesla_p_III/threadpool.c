@@ -0,0 +1,378 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: work-stealing thread pool for batches of key generations, signatures and
+*           verifications
+*
+* Every worker owns a deque of jobs. Submitted jobs are dealt round-robin to the deques;
+* a worker takes the newest job from its own deque and, when it runs dry, steals the
+* oldest job from another worker, so the variable cost of rejection sampling does not
+* leave cores idle. Each worker runs on a small stack and keeps its large temporaries in a
+* workspace (see crypto_sign_ws), both allocated and touched once at start-up. An
+* inaccessible guard page below each stack turns an overflow into a fault.
+**************************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "api.h"
+#include "threadpool.h"
+
+enum { JOB_KEYPAIR, JOB_SIGN, JOB_OPEN };
+
+typedef struct job {
+  int type;
+  threadpool_batch_t *batch;
+  int *result;
+  unsigned char *out, *out2;
+  unsigned long long *outlen;
+  const unsigned char *in;
+  unsigned long long inlen;
+  const unsigned char *key;
+} job_t;
+
+typedef struct {
+  pthread_mutex_t lock;
+  job_t **jobs;             // Circular buffer: oldest job at "top", newest at "top+count-1"
+  size_t size, top, count;
+} deque_t;
+
+typedef struct {
+  threadpool_t *pool;
+  unsigned int id;
+  pthread_t thread;
+  void *stack;              // Mapping of the guard page and the stack above it
+  void *ws;                 // Workspace for the _ws functions
+} worker_t;
+
+struct threadpool {
+  worker_t *workers;
+  deque_t *deques;          // One per worker
+  unsigned int nthreads, started;
+  size_t guard_bytes, stack_bytes;
+  atomic_uint next;         // Round-robin position for submissions
+  atomic_uint queued;       // Jobs in all deques
+  atomic_int stop;
+  pthread_mutex_t lock;     // Protects the sleep/wake-up of idle threads
+  pthread_cond_t work, done;
+  unsigned int sleepers;
+};
+
+
+static int deque_push(deque_t *d, job_t *job)
+{ // Adds "job" as the newest entry of the deque
+  job_t **jobs;
+  size_t i;
+
+  pthread_mutex_lock(&d->lock);
+  if (d->count == d->size) {
+    jobs = malloc(2*d->size*sizeof(job_t *));
+    if (jobs == NULL) {
+      pthread_mutex_unlock(&d->lock);
+      return -1;
+    }
+    for (i = 0; i < d->count; i++)
+      jobs[i] = d->jobs[(d->top + i) % d->size];
+    free(d->jobs);
+    d->jobs = jobs;
+    d->top = 0;
+    d->size *= 2;
+  }
+  d->jobs[(d->top + d->count) % d->size] = job;
+  d->count++;
+  pthread_mutex_unlock(&d->lock);
+  return 0;
+}
+
+
+static job_t *deque_pop(deque_t *d, int steal)
+{ // Removes the newest job, or the oldest one when stealing from another thread
+  job_t *job = NULL;
+
+  pthread_mutex_lock(&d->lock);
+  if (d->count != 0) {
+    if (steal) {
+      job = d->jobs[d->top];
+      d->top = (d->top + 1) % d->size;
+    } else {
+      job = d->jobs[(d->top + d->count - 1) % d->size];
+    }
+    d->count--;
+  }
+  pthread_mutex_unlock(&d->lock);
+  return job;
+}
+
+
+static job_t *find_job(threadpool_t *pool, unsigned int id)
+{ // Takes a job from deque "id" or steals one from the others. Threads helping in threadpool_wait() 
+  // pass id = nthreads and only steal
+  job_t *job = NULL;
+  unsigned int i, n = pool->nthreads;
+
+  if (atomic_load(&pool->queued) == 0)
+    return NULL;
+  if (id < n)
+    job = deque_pop(&pool->deques[id], 0);
+  for (i = 1; job == NULL && i <= n; i++)
+    job = deque_pop(&pool->deques[(id + i) % n], 1);
+  if (job != NULL)
+    atomic_fetch_sub(&pool->queued, 1);
+  return job;
+}
+
+
+static void run_job(threadpool_t *pool, job_t *job, void *ws)
+{ // Runs "job" with the workspace "ws", or with the temporaries on the stack if "ws" is NULL
+  int r = 0;
+
+  switch (job->type) {
+    case JOB_KEYPAIR:
+      r = (ws != NULL) ? crypto_sign_keypair_ws(job->out, job->out2, ws) : crypto_sign_keypair(job->out, job->out2);
+      break;
+    case JOB_SIGN:
+      r = (ws != NULL) ? crypto_sign_ws(job->out, job->outlen, job->in, job->inlen, job->key, ws)
+                       : crypto_sign(job->out, job->outlen, job->in, job->inlen, job->key);
+      break;
+    case JOB_OPEN:
+      r = (ws != NULL) ? crypto_sign_open_ws(job->out, job->outlen, job->in, job->inlen, job->key, ws)
+                       : crypto_sign_open(job->out, job->outlen, job->in, job->inlen, job->key);
+      break;
+  }
+  if (job->result != NULL)
+    *job->result = r;
+
+  if (atomic_fetch_sub(&job->batch->pending, 1) == 1) {
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_broadcast(&pool->done);
+    pthread_mutex_unlock(&pool->lock);
+  }
+  free(job);
+}
+
+
+static void *worker_main(void *arg)
+{
+  worker_t *w = arg;
+  threadpool_t *pool = w->pool;
+  job_t *job;
+
+  for (;;) {
+    job = find_job(pool, w->id);
+    if (job != NULL) {
+      run_job(pool, job, w->ws);
+      continue;
+    }
+    pthread_mutex_lock(&pool->lock);
+    while (atomic_load(&pool->queued) == 0 && !atomic_load(&pool->stop)) {
+      pool->sleepers++;
+      pthread_cond_wait(&pool->work, &pool->lock);
+      pool->sleepers--;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    if (atomic_load(&pool->stop) && atomic_load(&pool->queued) == 0)
+      break;
+  }
+  return NULL;
+}
+
+
+static int submit(threadpool_t *pool, threadpool_batch_t *batch, job_t *job)
+{
+  unsigned int id = atomic_fetch_add(&pool->next, 1) % pool->nthreads;
+
+  job->batch = batch;
+  atomic_fetch_add(&batch->pending, 1);
+  if (deque_push(&pool->deques[id], job) != 0) {
+    atomic_fetch_sub(&batch->pending, 1);
+    free(job);
+    return -1;
+  }
+  atomic_fetch_add(&pool->queued, 1);
+
+  pthread_mutex_lock(&pool->lock);
+  if (pool->sleepers != 0)
+    pthread_cond_signal(&pool->work);
+  pthread_mutex_unlock(&pool->lock);
+  return 0;
+}
+
+
+threadpool_t *threadpool_create(unsigned int nthreads, size_t stack_bytes)
+{
+  threadpool_t *pool;
+  pthread_attr_t attr;
+  long page = sysconf(_SC_PAGESIZE);
+  unsigned int i;
+
+  if (nthreads == 0 || page <= 0)
+    return NULL;
+  if (stack_bytes == 0)
+    stack_bytes = THREADPOOL_STACK_BYTES;
+  if (stack_bytes < PTHREAD_STACK_MIN)
+    stack_bytes = PTHREAD_STACK_MIN;
+  if (stack_bytes > ((size_t)-1)/2)
+    return NULL;
+  pool = calloc(1, sizeof(threadpool_t));
+  if (pool == NULL)
+    return NULL;
+  pool->nthreads = nthreads;
+  pool->guard_bytes = (size_t)page;
+  pool->stack_bytes = (stack_bytes + (size_t)page-1) & ~((size_t)page-1);
+  pool->workers = calloc(nthreads, sizeof(worker_t));
+  pool->deques = calloc(nthreads, sizeof(deque_t));
+  if (pool->workers == NULL || pool->deques == NULL) {
+    free(pool->workers);
+    free(pool->deques);
+    free(pool);
+    return NULL;
+  }
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->work, NULL);
+  pthread_cond_init(&pool->done, NULL);
+  for (i = 0; i < nthreads; i++) {
+    pthread_mutex_init(&pool->deques[i].lock, NULL);
+    pool->deques[i].size = 16;
+    pool->deques[i].jobs = malloc(16*sizeof(job_t *));
+    if (pool->deques[i].jobs == NULL) {
+      threadpool_destroy(pool);
+      return NULL;
+    }
+  }
+
+  pthread_attr_init(&attr);
+  for (i = 0; i < nthreads; i++) {
+    worker_t *w = &pool->workers[i];
+    w->pool = pool;
+    w->id = i;
+    w->stack = mmap(NULL, pool->guard_bytes+pool->stack_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (w->stack == MAP_FAILED) {
+      w->stack = NULL;
+      break;
+    }
+    if (mprotect(w->stack, pool->guard_bytes, PROT_NONE) != 0)   // Stacks grow down, into the guard page
+      break;
+    memset((unsigned char *)w->stack+pool->guard_bytes, 0, pool->stack_bytes);   // Fault in the pages once
+    if (posix_memalign(&w->ws, CRYPTO_WORKSPACEALIGN, CRYPTO_WORKSPACEBYTES) != 0) {
+      w->ws = NULL;
+      break;
+    }
+    memset(w->ws, 0, CRYPTO_WORKSPACEBYTES);
+    pthread_attr_setstack(&attr, (unsigned char *)w->stack+pool->guard_bytes, pool->stack_bytes);
+    if (pthread_create(&w->thread, &attr, worker_main, w) != 0)
+      break;
+    pool->started++;
+  }
+  pthread_attr_destroy(&attr);
+  if (pool->started != nthreads) {
+    threadpool_destroy(pool);
+    return NULL;
+  }
+  return pool;
+}
+
+
+void threadpool_destroy(threadpool_t *pool)
+{
+  unsigned int i;
+
+  pthread_mutex_lock(&pool->lock);
+  atomic_store(&pool->stop, 1);
+  pthread_cond_broadcast(&pool->work);
+  pthread_mutex_unlock(&pool->lock);
+  for (i = 0; i < pool->started; i++)
+    pthread_join(pool->workers[i].thread, NULL);
+
+  for (i = 0; i < pool->nthreads; i++) {
+    if (pool->workers[i].stack != NULL)
+      munmap(pool->workers[i].stack, pool->guard_bytes+pool->stack_bytes);
+    free(pool->workers[i].ws);
+  }
+  for (i = 0; i < pool->nthreads; i++) {
+    pthread_mutex_destroy(&pool->deques[i].lock);
+    free(pool->deques[i].jobs);
+  }
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->work);
+  pthread_cond_destroy(&pool->done);
+  free(pool->workers);
+  free(pool->deques);
+  free(pool);
+}
+
+
+void threadpool_batch_init(threadpool_batch_t *batch)
+{
+  atomic_init(&batch->pending, 0);
+}
+
+
+int threadpool_submit_keypair(threadpool_t *pool, threadpool_batch_t *batch, unsigned char *pk, unsigned char *sk, int *result)
+{
+  job_t *job = calloc(1, sizeof(job_t));
+
+  if (job == NULL)
+    return -1;
+  job->type = JOB_KEYPAIR;
+  job->result = result;
+  job->out = pk;
+  job->out2 = sk;
+  return submit(pool, batch, job);
+}
+
+
+int threadpool_submit_sign(threadpool_t *pool, threadpool_batch_t *batch, unsigned char *sm, unsigned long long *smlen, 
+                           const unsigned char *m, unsigned long long mlen, const unsigned char *sk, int *result)
+{
+  job_t *job = calloc(1, sizeof(job_t));
+
+  if (job == NULL)
+    return -1;
+  job->type = JOB_SIGN;
+  job->result = result;
+  job->out = sm;
+  job->outlen = smlen;
+  job->in = m;
+  job->inlen = mlen;
+  job->key = sk;
+  return submit(pool, batch, job);
+}
+
+
+int threadpool_submit_open(threadpool_t *pool, threadpool_batch_t *batch, unsigned char *m, unsigned long long *mlen, 
+                           const unsigned char *sm, unsigned long long smlen, const unsigned char *pk, int *result)
+{
+  job_t *job = calloc(1, sizeof(job_t));
+
+  if (job == NULL)
+    return -1;
+  job->type = JOB_OPEN;
+  job->result = result;
+  job->out = m;
+  job->outlen = mlen;
+  job->in = sm;
+  job->inlen = smlen;
+  job->key = pk;
+  return submit(pool, batch, job);
+}
+
+
+void threadpool_wait(threadpool_t *pool, threadpool_batch_t *batch)
+{
+  job_t *job;
+
+  while (atomic_load(&batch->pending) != 0) {
+    job = find_job(pool, pool->nthreads);
+    if (job != NULL) {
+      run_job(pool, job, NULL);   // The caller's own stack is large enough
+      continue;
+    }
+    pthread_mutex_lock(&pool->lock);
+    while (atomic_load(&batch->pending) != 0 && atomic_load(&pool->queued) == 0)
+      pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+  }
+}
@@ -21,6 +21,12 @@
 #define CRYPTO_SECRETKEYBYTES ((PARAM_K+1)*PARAM_S_BITS*PARAM_N/8 + 2*CRYPTO_SEEDBYTES + HM_BYTES)
 // Contains seed_a and polynomials t
 #define CRYPTO_PUBLICKEYBYTES ((PARAM_K*PARAM_Q_LOG*PARAM_N+7)/8 + CRYPTO_SEEDBYTES)
+// Size of the workspace taken by the _ws functions, which must be aligned to CRYPTO_WORKSPACEALIGN bytes. 
+// A workspace holds the large temporaries of one operation at a time and can be reused for any number of operations
+#define CRYPTO_WORKSPACEBYTES (4*(4*PARAM_K+3)*PARAM_N + 168*PARAM_GEN_A)   // 4 poly_k, 3 poly and the poly_uniform buffer
+#define CRYPTO_WORKSPACEALIGN 64
+// Size of the workspace taken by crypto_sign_stream_ws, which holds none of the K polynomials a_k, v_k and e_k*c at once
+#define CRYPTO_STREAM_WORKSPACEBYTES ((4*7+1)*PARAM_N + 1024)   // 7 poly, the rounded v_k and the hash and poly_uniform states
 
 int crypto_sign_keypair(
     unsigned char *,
@@ -39,4 +45,38 @@ int crypto_sign_open(
     const unsigned char *
     );
 
+// Same as above, with the large temporaries kept in the workspace "ws" instead of on the stack
+int crypto_sign_keypair_ws(
+    unsigned char *,
+    unsigned char *,
+    void *
+    );
+
+int crypto_sign_ws(
+    unsigned char *,unsigned long long *,
+    const unsigned char *,unsigned long long,
+    const unsigned char *,
+    void *
+    );
 
+int crypto_sign_open_ws(
+    unsigned char *,unsigned long long *,
+    const unsigned char *,unsigned long long,
+    const unsigned char *,
+    void *
+    );
+
+// Same signatures as crypto_sign, computed with the polynomials a_k generated on the fly (see sign.c).
+// crypto_sign_stream_ws takes a workspace of CRYPTO_STREAM_WORKSPACEBYTES bytes
+int crypto_sign_stream(
+    unsigned char *,unsigned long long *,
+    const unsigned char *,unsigned long long,
+    const unsigned char *
+    );
+
+int crypto_sign_stream_ws(
+    unsigned char *,unsigned long long *,
+    const unsigned char *,unsigned long long,
+    const unsigned char *,
+    void *
+    );
@@ -0,0 +1,301 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: online/offline signing with a pool of commitments (y, v = a*y)
+*           precomputed for one secret key by background threads
+*
+* Commitments are kept in the same bounded MPMC ring as in keypool.c. The background
+* threads compute a commitment directly in the slot they reserved, and the signer uses
+* it in place before erasing and releasing the slot, so no commitment is ever copied.
+**************************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "api.h"
+#include "sign_step.h"
+#include "commitpool.h"
+
+typedef struct {
+  _Alignas(CRYPTO_WORKSPACEALIGN) int32_t y[PARAM_N];
+  _Alignas(CRYPTO_WORKSPACEALIGN) int32_t v[PARAM_K*PARAM_N];
+} commit_t;
+
+typedef struct {
+  atomic_size_t seq;
+  commit_t c;
+} commitpool_slot_t;
+
+struct commitpool {
+  commitpool_slot_t *slots;
+  int32_t *a;
+  unsigned char sk[CRYPTO_SECRETKEYBYTES];
+  size_t capacity, low_watermark;
+  atomic_size_t head, tail;
+  atomic_int refilling, stop;
+  atomic_ullong generated, served, misses, rejected, signatures, busy_ns;
+  pthread_mutex_t lock;
+  pthread_cond_t wakeup;
+  pthread_t *threads;
+  void **ws;                // Workspace of each background thread, allocated with the pool
+  atomic_uint next_ws;      // Index of the workspace the next thread to start takes
+  unsigned int nthreads, nws;
+};
+
+
+static size_t fill_level(commitpool_t *pool)
+{
+  size_t tail = atomic_load_explicit(&pool->tail, memory_order_relaxed);
+  size_t head = atomic_load_explicit(&pool->head, memory_order_relaxed);
+
+  return (tail > head) ? tail - head : 0;
+}
+
+
+static commitpool_slot_t *reserve(commitpool_t *pool, size_t *pos)
+{ // Reserves the slot at the tail for a producer. Returns NULL if the pool is full
+  commitpool_slot_t *slot;
+  size_t seq;
+  intptr_t diff;
+
+  *pos = atomic_load_explicit(&pool->tail, memory_order_relaxed);
+  for (;;) {
+    slot = &pool->slots[*pos % pool->capacity];
+    seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    diff = (intptr_t)seq - (intptr_t)*pos;
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&pool->tail, pos, *pos+1, memory_order_relaxed, memory_order_relaxed))
+        return slot;
+    } else if (diff < 0) {
+      return NULL;
+    } else {
+      *pos = atomic_load_explicit(&pool->tail, memory_order_relaxed);
+    }
+  }
+}
+
+
+static commitpool_slot_t *take(commitpool_t *pool, size_t *pos)
+{ // Takes the slot at the head for a consumer. Returns NULL if the pool is empty
+  commitpool_slot_t *slot;
+  size_t seq;
+  intptr_t diff;
+
+  *pos = atomic_load_explicit(&pool->head, memory_order_relaxed);
+  for (;;) {
+    slot = &pool->slots[*pos % pool->capacity];
+    seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    diff = (intptr_t)seq - (intptr_t)(*pos+1);
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&pool->head, pos, *pos+1, memory_order_relaxed, memory_order_relaxed))
+        return slot;
+    } else if (diff < 0) {
+      return NULL;
+    } else {
+      *pos = atomic_load_explicit(&pool->head, memory_order_relaxed);
+    }
+  }
+}
+
+
+static void *commitpool_worker(void *arg)
+{ // Background thread: computes commitments until the pool is full, then sleeps until it drops below the low watermark
+  commitpool_t *pool = arg;
+  commitpool_slot_t *slot;
+  unsigned long long t0;
+  size_t pos;
+  void *ws = pool->ws[atomic_fetch_add(&pool->next_ws, 1)];
+
+  while (!atomic_load(&pool->stop)) {
+    if (!atomic_load(&pool->refilling)) {
+      pthread_mutex_lock(&pool->lock);
+      while (!atomic_load(&pool->refilling) && !atomic_load(&pool->stop))
+        pthread_cond_wait(&pool->wakeup, &pool->lock);
+      pthread_mutex_unlock(&pool->lock);
+      continue;
+    }
+
+    slot = reserve(pool, &pos);
+    if (slot == NULL) {
+      atomic_store(&pool->refilling, 0);
+      // A signer that took a commitment while "refilling" was still set did not wake the threads, so check again
+      atomic_thread_fence(memory_order_seq_cst);
+      if (fill_level(pool) < pool->low_watermark)
+        atomic_store(&pool->refilling, 1);
+      continue;
+    }
+    t0 = qtesla_time_ns();
+    qtesla_commit(slot->c.y, slot->c.v, pool->a, pool->sk, ws);
+    atomic_fetch_add(&pool->busy_ns, qtesla_time_ns() - t0);
+    atomic_store_explicit(&slot->seq, pos+1, memory_order_release);
+    atomic_fetch_add(&pool->generated, 1);
+  }
+  return NULL;
+}
+
+
+commitpool_t *commitpool_create(const unsigned char *sk, unsigned int capacity, unsigned int low_watermark, unsigned int nthreads)
+{
+  commitpool_t *pool;
+  void *slots = NULL, *a = NULL;
+  size_t i;
+  int ok;
+
+  if (capacity == 0 || low_watermark > capacity || nthreads == 0)
+    return NULL;
+  pool = calloc(1, sizeof(commitpool_t));
+  if (pool == NULL)
+    return NULL;
+  if (posix_memalign(&slots, CRYPTO_WORKSPACEALIGN, capacity*sizeof(commitpool_slot_t)) != 0)
+    slots = NULL;
+  if (posix_memalign(&a, CRYPTO_WORKSPACEALIGN, PARAM_K*PARAM_N*sizeof(int32_t)) != 0)
+    a = NULL;
+  pool->threads = calloc(nthreads, sizeof(pthread_t));
+  pool->ws = calloc(nthreads, sizeof(void *));
+  ok = (slots != NULL && a != NULL && pool->threads != NULL && pool->ws != NULL);
+  for (i = 0; ok && i < nthreads; i++) {   // Allocated here, so that a thread never starts without one
+    if (posix_memalign(&pool->ws[i], CRYPTO_WORKSPACEALIGN, CRYPTO_WORKSPACEBYTES) != 0) {
+      pool->ws[i] = NULL;
+      ok = 0;
+    }
+  }
+  if (!ok) {
+    for (i = 0; pool->ws != NULL && i < nthreads; i++)
+      free(pool->ws[i]);
+    free(pool->ws);
+    free(slots);
+    free(a);
+    free(pool->threads);
+    free(pool);
+    return NULL;
+  }
+  pool->slots = slots;
+  pool->a = a;
+  memcpy(pool->sk, sk, CRYPTO_SECRETKEYBYTES);
+  pool->nws = nthreads;
+  qtesla_commit_a(pool->a, sk, pool->ws[0]);
+
+  pool->capacity = capacity;
+  pool->low_watermark = low_watermark;
+  for (i = 0; i < capacity; i++)
+    atomic_init(&pool->slots[i].seq, i);
+  atomic_init(&pool->refilling, 1);
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->wakeup, NULL);
+
+  for (pool->nthreads = 0; pool->nthreads < nthreads; pool->nthreads++) {
+    if (pthread_create(&pool->threads[pool->nthreads], NULL, commitpool_worker, pool) != 0) {
+      commitpool_destroy(pool);
+      return NULL;
+    }
+  }
+  return pool;
+}
+
+
+/***************************************************************
+* Name:        commitpool_sign_ws
+* Description: outputs a signature for a given message m with the
+*              key of the pool. Each attempt runs only the online
+*              phase on a precomputed commitment, unless the pool
+*              is empty
+* Parameters:  inputs:
+*              - commitpool_t *pool: pool of the secret key
+*              - const unsigned char *m: message to be signed
+*              - unsigned long long mlen: message length
+*              - void *ws: workspace of CRYPTO_WORKSPACEBYTES bytes
+*              outputs:
+*              - unsigned char *sm: signature
+*              - unsigned long long *smlen: signature length*
+* Returns:     0 for successful execution
+***************************************************************/
+int commitpool_sign_ws(commitpool_t *pool, unsigned char *sm, unsigned long long *smlen, const unsigned char *m, unsigned long long mlen, void *ws)
+{
+  unsigned char hm[QTESLA_HM_BYTES];
+  commitpool_slot_t *slot;
+  commit_t miss;
+  size_t pos;
+  int rsp;
+
+  qtesla_sign_hm(hm, m, mlen, pool->sk);
+  do {
+    slot = take(pool, &pos);
+    if (slot != NULL) {
+      atomic_fetch_add(&pool->served, 1);
+      rsp = qtesla_sign_commit(sm, smlen, m, mlen, hm, pool->sk, slot->c.y, slot->c.v, ws);
+      qtesla_clear(&slot->c, sizeof(commit_t));
+      atomic_store_explicit(&slot->seq, pos+pool->capacity, memory_order_release);
+    } else {
+      atomic_fetch_add(&pool->misses, 1);
+      qtesla_commit(miss.y, miss.v, pool->a, pool->sk, ws);
+      rsp = qtesla_sign_commit(sm, smlen, m, mlen, hm, pool->sk, miss.y, miss.v, ws);
+      qtesla_clear(&miss, sizeof(commit_t));
+    }
+
+    atomic_thread_fence(memory_order_seq_cst);
+    if (fill_level(pool) < pool->low_watermark && !atomic_load(&pool->refilling)) {
+      pthread_mutex_lock(&pool->lock);
+      atomic_store(&pool->refilling, 1);
+      pthread_cond_broadcast(&pool->wakeup);
+      pthread_mutex_unlock(&pool->lock);
+    }
+    if (rsp != 0)
+      atomic_fetch_add(&pool->rejected, 1);
+  } while (rsp != 0);
+  atomic_fetch_add(&pool->signatures, 1);
+  return 0;
+}
+
+
+int commitpool_sign(commitpool_t *pool, unsigned char *sm, unsigned long long *smlen, const unsigned char *m, unsigned long long mlen)
+{
+  _Alignas(CRYPTO_WORKSPACEALIGN) unsigned char ws[CRYPTO_WORKSPACEBYTES];
+
+  return commitpool_sign_ws(pool, sm, smlen, m, mlen, ws);
+}
+
+
+void commitpool_get_stats(commitpool_t *pool, commitpool_stats_t *stats)
+{
+  unsigned long long busy_ns = atomic_load(&pool->busy_ns);
+
+  stats->capacity = (unsigned int)pool->capacity;
+  stats->low_watermark = (unsigned int)pool->low_watermark;
+  stats->fill = (unsigned int)fill_level(pool);
+  stats->generated = atomic_load(&pool->generated);
+  stats->served = atomic_load(&pool->served);
+  stats->misses = atomic_load(&pool->misses);
+  stats->rejected = atomic_load(&pool->rejected);
+  stats->signatures = atomic_load(&pool->signatures);
+  // busy_ns adds up the time of all threads, so this is the aggregate rate while they are all computing
+  stats->refill_rate = (busy_ns != 0) ? (double)stats->generated*pool->nthreads*1e9/(double)busy_ns : 0.0;
+}
+
+
+void commitpool_destroy(commitpool_t *pool)
+{
+  unsigned int i;
+
+  pthread_mutex_lock(&pool->lock);
+  atomic_store(&pool->stop, 1);
+  pthread_cond_broadcast(&pool->wakeup);
+  pthread_mutex_unlock(&pool->lock);
+  for (i = 0; i < pool->nthreads; i++)
+    pthread_join(pool->threads[i], NULL);
+
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->wakeup);
+  qtesla_clear(pool->slots, pool->capacity*sizeof(commitpool_slot_t));
+  qtesla_clear(pool->sk, CRYPTO_SECRETKEYBYTES);
+  for (i = 0; i < pool->nws; i++) {
+    qtesla_clear(pool->ws[i], CRYPTO_WORKSPACEBYTES);
+    free(pool->ws[i]);
+  }
+  free(pool->ws);
+  free(pool->slots);
+  free(pool->a);
+  free(pool->threads);
+  free(pool);
+}
@@ -5,11 +5,22 @@
 **************************************************************************************/
 
 #include <string.h>
+#include <stdatomic.h>
 #include "api.h"
 #include "sha3/fips202.h"
 #include "gauss.h"
+#include "parallel.h"
 #include "CDT32.h"
 
+typedef struct {
+    int32_t **z;
+    const unsigned char **seed;
+    int nonce;
+    int (*check)(poly, unsigned int);
+    const unsigned int *bound;
+    atomic_uint first_reject;
+} gauss_batch_t;
+
 
 void sample_gauss_poly(poly z, const unsigned char *seed, int nonce)
 {
@@ -33,4 +44,31 @@ void sample_gauss_poly(poly z, const unsigned char *seed, int nonce)
             z[chunk+i] = (sign & -z[chunk+i]) | (~sign & z[chunk+i]);
         }
     }
-}
\ No newline at end of file
+}
+
+
+static void gauss_batch_task(void *arg, unsigned int j)
+{ // Samples and checks polynomial j, unless a polynomial before it has already been rejected
+    gauss_batch_t *b = arg;
+    unsigned int first;
+
+    if (j > atomic_load(&b->first_reject))
+        return;
+    sample_gauss_poly(b->z[j], b->seed[j], b->nonce+j);
+    if (b->check(b->z[j], b->bound[j]) != 0) {
+        first = atomic_load(&b->first_reject);
+        while (j < first && !atomic_compare_exchange_weak(&b->first_reject, &first, j));
+    }
+}
+
+
+unsigned int sample_gauss_poly_batch(int32_t *z[], const unsigned char *seed[], int nonce, unsigned int n, 
+                                     int (*check)(poly, unsigned int), const unsigned int bound[])
+{ // Samples z[0..n-1] as sample_gauss_poly(z[j], seed[j], nonce+j) and stops at the first z[j] for which
+  // check(z[j], bound[j]) != 0. Returns the number of polynomials accepted before it. With helper threads
+  // enabled the polynomials are sampled speculatively in parallel; otherwise none is sampled past the first rejection
+    gauss_batch_t b = { z, seed, nonce, check, bound, n };
+
+    parallel_for(n, gauss_batch_task, &b);
+    return atomic_load(&b.first_reject);
+}
@@ -0,0 +1,47 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: batch signing, with one signature of the root of a Merkle tree over the
+*           batch and a proof of inclusion per message
+**************************************************************************************/
+
+#ifndef __MERKLE_H
+#define __MERKLE_H
+
+#include "api.h"
+
+#define MERKLE_HASH_BYTES 32
+#define MERKLE_MAX_BATCH (1U << 24)
+#define MERKLE_MAX_DEPTH 24
+// The root message of a batch: a tag, the root and the number of messages (32-bit little-endian)
+#define MERKLE_ROOT_MSG_BYTES (16 + MERKLE_HASH_BYTES + 4)
+// A signed root is the signature of the hash of the root message followed by the root message
+#define MERKLE_SIGNED_ROOT_BYTES (CRYPTO_BYTES + MERKLE_ROOT_MSG_BYTES)
+// A proof is the index of the message (32-bit little-endian) followed by at most one hash per level of the tree
+#define MERKLE_MAX_PROOF_BYTES (4 + MERKLE_MAX_DEPTH*MERKLE_HASH_BYTES)
+
+typedef struct {   // Verifier of one public key; it keeps the last signed root that verified
+  unsigned char pk[CRYPTO_PUBLICKEYBYTES];
+  unsigned char sm[MERKLE_SIGNED_ROOT_BYTES];
+  int cached;
+  unsigned long long root_verifications;   // Signed roots checked with qtesla_verify_hm()
+  unsigned long long cache_hits;           // Proofs checked against the cached root
+} merkle_verifier_t;
+
+// Size of the largest proof of a batch of n messages (0 if n is out of range)
+unsigned int merkle_proof_bytes(unsigned int n);
+
+// Signs the n messages m[i] of mlen[i] bytes with one signature of the root of their Merkle tree. Outputs
+// the signed root in sm (MERKLE_SIGNED_ROOT_BYTES bytes) and the proof of m[i] at proofs + i*merkle_proof_bytes(n),
+// of prooflen[i] bytes (prooflen may be NULL). Returns 0, or -1 if n is 0 or above MERKLE_MAX_BATCH or memory runs out
+int merkle_sign_batch(unsigned char *sm, unsigned long long *smlen, unsigned char *proofs, unsigned int *prooflen,
+                      const unsigned char *const *m, const unsigned long long *mlen, unsigned int n, const unsigned char *sk);
+
+void merkle_verifier_init(merkle_verifier_t *v, const unsigned char *pk);
+
+// Checks that m is in the batch whose signed root is sm. The signature of the root is verified only when sm differs
+// from the last signed root that verified. Returns 0 if valid, otherwise -1. A verifier must not be shared by threads
+int merkle_verify(merkle_verifier_t *v, const unsigned char *m, unsigned long long mlen, const unsigned char *proof,
+                  unsigned int prooflen, const unsigned char *sm, unsigned long long smlen);
+
+#endif
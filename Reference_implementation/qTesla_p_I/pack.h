@@ -4,7 +4,9 @@
 #include "poly.h"
 #include <stdint.h>
 
-void hash_H(unsigned char *c_bin, poly v, const unsigned char *hm);
+#define HASH_H_BYTES (PARAM_K*PARAM_N + 2*HM_BYTES)   // Size of the buffer taken by hash_H
+
+void hash_H(unsigned char *c_bin, poly_k v, const unsigned char *hm, unsigned char *t);
 void encode_sk(unsigned char *sk, const poly s, const poly_k e, const unsigned char *seeds, const unsigned char *hash_pk);
 void encode_pk(unsigned char *pk, const poly_k t, const unsigned char *seedA);
 void decode_pk(int32_t *pk, unsigned char *seedA, const unsigned char *pk_in);
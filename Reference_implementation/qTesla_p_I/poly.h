@@ -4,10 +4,21 @@
 #include "params.h"
 #include "config.h"
 #include <stdint.h>
+#include "sha3/fips202.h"
+
+#define POLY_UNIFORM_BYTES (SHAKE128_RATE*PARAM_GEN_A)   // Size of the buffer taken by poly_uniform
 
 typedef	int32_t poly[PARAM_N];
 typedef	int32_t poly_k[PARAM_N*PARAM_K];
 
+typedef struct {   // State of poly_uniform_next(), which outputs the polynomials "a_i" of poly_uniform() one at a time
+  uint64_t s[25];
+  unsigned char buf[2*SHAKE128_RATE];
+  const unsigned char *seed;
+  unsigned int pos, len, offset, nblocks, nval;
+  uint16_t dmsp;
+} poly_uniform_t;
+
 int32_t reduce(int64_t a);
 sdigit_t barr_reduce(sdigit_t a);
 int64_t barr_reduce64(int64_t a);
@@ -21,6 +32,8 @@ void poly_sub(poly result, const poly x, const poly y);
 void poly_sub_reduce(poly result, const poly x, const poly y);
 void sparse_mul8(poly prod, const unsigned char *s, const uint32_t pos_list[PARAM_H], const int16_t sign_list[PARAM_H]);
 void sparse_mul32(poly prod, const int32_t *pk, const uint32_t pos_list[PARAM_H], const int16_t sign_list[PARAM_H]);
-void poly_uniform(poly_k a, const unsigned char *seed);
+void poly_uniform(poly_k a, const unsigned char *seed, unsigned char *buf);
+void poly_uniform_init(poly_uniform_t *st, const unsigned char *seed);
+void poly_uniform_next(poly a, poly_uniform_t *st);
 
 #endif
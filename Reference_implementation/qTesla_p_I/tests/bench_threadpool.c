@@ -0,0 +1,112 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: throughput of batch key generation, signing and verification with the
+*           work-stealing thread pool
+*
+* Usage: bench_threadpool [max_threads] [batch_size]
+**************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "../random/random.h"
+#include "../api.h"
+#include "../threadpool.h"
+
+#define MLEN 59
+#define NBATCH 256
+
+
+static double wall_time(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + 1e-9*(double)ts.tv_nsec;
+}
+
+
+int main(int argc, char **argv)
+{
+  unsigned int nthreads, max_threads, nbatch, i;
+  unsigned char *pk, *sk, *m, *sm, *mo;
+  unsigned long long *smlen, *mlen;
+  int *res;
+  double t, base[3] = {0}, rate[3];
+  threadpool_t *pool;
+  threadpool_batch_t batch;
+
+  max_threads = (argc > 1) ? (unsigned int)atoi(argv[1]) : (unsigned int)sysconf(_SC_NPROCESSORS_ONLN);
+  nbatch = (argc > 2) ? (unsigned int)atoi(argv[2]) : NBATCH;
+  if (max_threads == 0 || nbatch == 0)
+    return -1;
+
+  pk = malloc((size_t)nbatch*CRYPTO_PUBLICKEYBYTES);
+  sk = malloc((size_t)nbatch*CRYPTO_SECRETKEYBYTES);
+  m = malloc((size_t)nbatch*MLEN);
+  sm = malloc((size_t)nbatch*(MLEN+CRYPTO_BYTES));
+  mo = malloc((size_t)nbatch*(MLEN+CRYPTO_BYTES));
+  smlen = malloc(nbatch*sizeof(unsigned long long));
+  mlen = malloc(nbatch*sizeof(unsigned long long));
+  res = malloc(nbatch*sizeof(int));
+  if (!pk || !sk || !m || !sm || !mo || !smlen || !mlen || !res)
+    return -1;
+  randombytes(m, nbatch*MLEN);
+
+  printf("\n");
+  printf("===========================================================================================\n");
+  printf("Thread pool throughput for %s, batches of %u operations\n", CRYPTO_ALGNAME, nbatch);
+  printf("===========================================================================================\n\n");
+  printf("threads   keygen/s (speedup)   sign/s (speedup)   verify/s (speedup)\n");
+
+  for (nthreads = 1; nthreads <= max_threads; nthreads = (nthreads < max_threads && 2*nthreads > max_threads) ? max_threads : 2*nthreads) {
+    pool = threadpool_create(nthreads, 0);
+    if (pool == NULL) {
+      printf("Thread pool creation FAILED. \n");
+      return -1;
+    }
+
+    threadpool_batch_init(&batch);
+    t = wall_time();
+    for (i = 0; i < nbatch; i++)
+      threadpool_submit_keypair(pool, &batch, &pk[i*CRYPTO_PUBLICKEYBYTES], &sk[i*CRYPTO_SECRETKEYBYTES], &res[i]);
+    threadpool_wait(pool, &batch);
+    rate[0] = nbatch/(wall_time() - t);
+
+    threadpool_batch_init(&batch);
+    t = wall_time();
+    for (i = 0; i < nbatch; i++)
+      threadpool_submit_sign(pool, &batch, &sm[i*(MLEN+CRYPTO_BYTES)], &smlen[i], &m[i*MLEN], MLEN, &sk[i*CRYPTO_SECRETKEYBYTES], &res[i]);
+    threadpool_wait(pool, &batch);
+    rate[1] = nbatch/(wall_time() - t);
+
+    threadpool_batch_init(&batch);
+    t = wall_time();
+    for (i = 0; i < nbatch; i++)
+      threadpool_submit_open(pool, &batch, &mo[i*(MLEN+CRYPTO_BYTES)], &mlen[i], &sm[i*(MLEN+CRYPTO_BYTES)], smlen[i], &pk[i*CRYPTO_PUBLICKEYBYTES], &res[i]);
+    threadpool_wait(pool, &batch);
+    rate[2] = nbatch/(wall_time() - t);
+
+    threadpool_destroy(pool);
+
+    for (i = 0; i < nbatch; i++) {
+      if (res[i] != 0 || mlen[i] != MLEN) {
+        printf("Signature verification FAILED. \n");
+        return -1;
+      }
+    }
+    if (nthreads == 1)
+      for (i = 0; i < 3; i++)
+        base[i] = rate[i];
+    printf("%7u   %10.1f (%4.2fx)   %8.1f (%4.2fx)   %10.1f (%4.2fx)\n", nthreads, 
+           rate[0], rate[0]/base[0], rate[1], rate[1]/base[1], rate[2], rate[2]/base[2]);
+    if (nthreads == max_threads)
+      break;
+  }
+  printf("\n");
+
+  free(pk); free(sk); free(m); free(sm); free(mo); free(smlen); free(mlen); free(res);
+  return 0;
+}
@@ -0,0 +1,40 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: hardware performance counters of the calling thread through perf_event_open,
+*           for the benchmarks. Counters the kernel or the machine does not provide are 
+*           left closed, and all of them are when perf_event_open is unavailable
+**************************************************************************************/
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stdint.h>
+
+typedef enum {
+  PERF_CYCLES,          // Core cycles, at the actual clock frequency
+  PERF_INSTRUCTIONS,
+  PERF_L1D_MISSES,      // L1 data cache read misses
+  PERF_LLC_MISSES,      // Last level cache misses
+  PERF_BRANCH_MISSES,
+  PERF_NCOUNTERS
+} perf_counter_t;
+
+typedef struct {
+  int fd[PERF_NCOUNTERS];   // -1 for the counters that could not be opened
+  int leader;               // Group leader, enabled and disabled for all of them; -1 if none is open
+} perf_counters_t;
+
+// Opens the counters for the calling thread, user mode only. Returns the number of counters opened
+int perf_counters_open(perf_counters_t *pc);
+
+// Starts and stops counting; counts add up over consecutive start/stop pairs until perf_counters_read
+void perf_counters_start(perf_counters_t *pc);
+void perf_counters_stop(perf_counters_t *pc);
+
+// Reads and clears the counts. Returns 1 in available[i] for the counters that are open, otherwise 0
+void perf_counters_read(perf_counters_t *pc, uint64_t value[PERF_NCOUNTERS], int available[PERF_NCOUNTERS]);
+
+void perf_counters_close(perf_counters_t *pc);
+
+#endif
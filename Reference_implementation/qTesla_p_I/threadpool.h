@@ -0,0 +1,45 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: work-stealing thread pool for batches of key generations, signatures and
+*           verifications
+**************************************************************************************/
+
+#ifndef __THREADPOOL_H
+#define __THREADPOOL_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+#include "api.h"
+
+#define THREADPOOL_STACK_BYTES (1 << 20)   // Default stack of each worker: the _ws functions need about 30 KiB at -O3
+                                           // but over 256 KiB in unoptimised builds of qTesla-p-III
+
+typedef struct threadpool threadpool_t;
+
+typedef struct {
+  atomic_uint pending;   // Jobs submitted to the batch that have not completed
+} threadpool_batch_t;
+
+// Creates a pool with "nthreads" workers, each on a stack of "stack_bytes" (THREADPOOL_STACK_BYTES if 0)
+// with a guard page below it. Returns NULL on failure
+threadpool_t *threadpool_create(unsigned int nthreads, size_t stack_bytes);
+
+// Stops the workers. Pending batches must have been waited for
+void threadpool_destroy(threadpool_t *pool);
+
+void threadpool_batch_init(threadpool_batch_t *batch);
+
+// Queue one operation into "batch". Arguments are those of the corresponding crypto_sign* call and
+// must stay valid until threadpool_wait() returns. The return value of the operation is written to
+// *result if "result" is not NULL. Return 0 on success and -1 if the job could not be queued
+int threadpool_submit_keypair(threadpool_t *pool, threadpool_batch_t *batch, unsigned char *pk, unsigned char *sk, int *result);
+int threadpool_submit_sign(threadpool_t *pool, threadpool_batch_t *batch, unsigned char *sm, unsigned long long *smlen, 
+                           const unsigned char *m, unsigned long long mlen, const unsigned char *sk, int *result);
+int threadpool_submit_open(threadpool_t *pool, threadpool_batch_t *batch, unsigned char *m, unsigned long long *mlen, 
+                           const unsigned char *sm, unsigned long long smlen, const unsigned char *pk, int *result);
+
+// Waits until every job in "batch" has completed. The calling thread runs queued jobs while it waits
+void threadpool_wait(threadpool_t *pool, threadpool_batch_t *batch);
+
+#endif
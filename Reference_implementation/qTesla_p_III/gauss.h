@@ -7,7 +7,11 @@
 #include "poly.h"
 
 #define CHUNK_SIZE 512   // Fix chunk size for sampling
+#define GAUSS_BATCH (PARAM_K+1)   // Maximum number of polynomials per call to sample_gauss_poly_batch
 
 void sample_gauss_poly(poly z, const unsigned char *seed, int nonce);
+int check_ES(poly p, unsigned int bound);   // Bound check of e and s, in sign.c; 0 if ok, otherwise 1
+unsigned int sample_gauss_poly_batch(int32_t *z[], const unsigned char *seed[], int nonce, unsigned int n, 
+                                     int (*check)(poly, unsigned int), const unsigned int bound[]);
 
 #endif
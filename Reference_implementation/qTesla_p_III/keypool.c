@@ -0,0 +1,238 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: pool of key pairs pre-generated by background threads
+*
+* Key pairs are kept in a bounded multi-producer/multi-consumer ring in which every slot
+* carries a sequence number (D. Vyukov's bounded MPMC queue), so keypool_get() takes a
+* key pair with a single compare-and-swap and never blocks on the producers.
+**************************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "api.h"
+#include "sign_step.h"
+#include "keypool.h"
+
+typedef struct {
+  atomic_size_t seq;
+  unsigned char pk[CRYPTO_PUBLICKEYBYTES];
+  unsigned char sk[CRYPTO_SECRETKEYBYTES];
+} keypool_slot_t;
+
+struct keypool {
+  keypool_slot_t *slots;
+  size_t capacity, low_watermark;
+  atomic_size_t head, tail;
+  atomic_int refilling, stop;
+  atomic_ullong generated, served, misses, busy_ns;
+  pthread_mutex_t lock;
+  pthread_cond_t wakeup;
+  pthread_t *threads;
+  unsigned int nthreads;
+};
+
+
+static size_t fill_level(keypool_t *pool)
+{
+  size_t tail = atomic_load_explicit(&pool->tail, memory_order_relaxed);
+  size_t head = atomic_load_explicit(&pool->head, memory_order_relaxed);
+
+  return (tail > head) ? tail - head : 0;
+}
+
+
+static int enqueue(keypool_t *pool, const unsigned char *pk, const unsigned char *sk)
+{ // Returns 0 on success, -1 if the pool is full
+  keypool_slot_t *slot;
+  size_t pos = atomic_load_explicit(&pool->tail, memory_order_relaxed), seq;
+  intptr_t diff;
+
+  for (;;) {
+    slot = &pool->slots[pos % pool->capacity];
+    seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    diff = (intptr_t)seq - (intptr_t)pos;
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&pool->tail, &pos, pos+1, memory_order_relaxed, memory_order_relaxed))
+        break;
+    } else if (diff < 0) {
+      return -1;
+    } else {
+      pos = atomic_load_explicit(&pool->tail, memory_order_relaxed);
+    }
+  }
+  memcpy(slot->pk, pk, CRYPTO_PUBLICKEYBYTES);
+  memcpy(slot->sk, sk, CRYPTO_SECRETKEYBYTES);
+  atomic_store_explicit(&slot->seq, pos+1, memory_order_release);
+  return 0;
+}
+
+
+static int dequeue(keypool_t *pool, unsigned char *pk, unsigned char *sk)
+{ // Returns 0 on success, -1 if the pool is empty
+  keypool_slot_t *slot;
+  size_t pos = atomic_load_explicit(&pool->head, memory_order_relaxed), seq;
+  intptr_t diff;
+
+  for (;;) {
+    slot = &pool->slots[pos % pool->capacity];
+    seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    diff = (intptr_t)seq - (intptr_t)(pos+1);
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&pool->head, &pos, pos+1, memory_order_relaxed, memory_order_relaxed))
+        break;
+    } else if (diff < 0) {
+      return -1;
+    } else {
+      pos = atomic_load_explicit(&pool->head, memory_order_relaxed);
+    }
+  }
+  memcpy(pk, slot->pk, CRYPTO_PUBLICKEYBYTES);
+  memcpy(sk, slot->sk, CRYPTO_SECRETKEYBYTES);
+  qtesla_clear(slot->sk, CRYPTO_SECRETKEYBYTES);
+  atomic_store_explicit(&slot->seq, pos+pool->capacity, memory_order_release);
+  return 0;
+}
+
+
+static void stop_refilling(keypool_t *pool)
+{ // Called by a background thread that found the pool full
+  atomic_store(&pool->refilling, 0);
+  // A consumer that took a key pair while "refilling" was still set did not wake the threads, so check again
+  atomic_thread_fence(memory_order_seq_cst);
+  if (fill_level(pool) < pool->low_watermark)
+    atomic_store(&pool->refilling, 1);
+}
+
+
+static void *keypool_worker(void *arg)
+{ // Background thread: generates key pairs until the pool is full, then sleeps until it drops below the low watermark.
+  // A key pair that finds the pool full is kept for the next refill
+  keypool_t *pool = arg;
+  unsigned char pk[CRYPTO_PUBLICKEYBYTES], sk[CRYPTO_SECRETKEYBYTES];
+  unsigned long long t0;
+  int pending = 0;
+
+  while (!atomic_load(&pool->stop)) {
+    if (!atomic_load(&pool->refilling)) {
+      pthread_mutex_lock(&pool->lock);
+      while (!atomic_load(&pool->refilling) && !atomic_load(&pool->stop))
+        pthread_cond_wait(&pool->wakeup, &pool->lock);
+      pthread_mutex_unlock(&pool->lock);
+      continue;
+    }
+
+    if (!pending) {
+      if (fill_level(pool) >= pool->capacity) {
+        stop_refilling(pool);
+        continue;
+      }
+      t0 = qtesla_time_ns();
+      crypto_sign_keypair(pk, sk);
+      atomic_fetch_add(&pool->busy_ns, qtesla_time_ns() - t0);
+      pending = 1;
+    }
+    if (enqueue(pool, pk, sk) == 0) {
+      pending = 0;
+      atomic_fetch_add(&pool->generated, 1);
+    } else {
+      stop_refilling(pool);
+    }
+  }
+  qtesla_clear(sk, CRYPTO_SECRETKEYBYTES);
+  return NULL;
+}
+
+
+keypool_t *keypool_create(unsigned int capacity, unsigned int low_watermark, unsigned int nthreads)
+{
+  keypool_t *pool;
+  size_t i;
+
+  if (capacity == 0 || low_watermark == 0 || low_watermark > capacity || nthreads == 0)
+    return NULL;
+  pool = calloc(1, sizeof(keypool_t));
+  if (pool == NULL)
+    return NULL;
+  pool->slots = calloc(capacity, sizeof(keypool_slot_t));
+  pool->threads = calloc(nthreads, sizeof(pthread_t));
+  if (pool->slots == NULL || pool->threads == NULL) {
+    free(pool->slots);
+    free(pool->threads);
+    free(pool);
+    return NULL;
+  }
+  pool->capacity = capacity;
+  pool->low_watermark = low_watermark;
+  for (i = 0; i < capacity; i++)
+    atomic_init(&pool->slots[i].seq, i);
+  atomic_init(&pool->refilling, 1);
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->wakeup, NULL);
+
+  for (pool->nthreads = 0; pool->nthreads < nthreads; pool->nthreads++) {
+    if (pthread_create(&pool->threads[pool->nthreads], NULL, keypool_worker, pool) != 0) {
+      keypool_destroy(pool);
+      return NULL;
+    }
+  }
+  return pool;
+}
+
+
+int keypool_get(keypool_t *pool, unsigned char *pk, unsigned char *sk)
+{
+  if (dequeue(pool, pk, sk) != 0) {
+    atomic_fetch_add(&pool->misses, 1);
+    crypto_sign_keypair(pk, sk);
+  } else {
+    atomic_fetch_add(&pool->served, 1);
+  }
+
+  atomic_thread_fence(memory_order_seq_cst);
+  if (fill_level(pool) < pool->low_watermark && !atomic_load(&pool->refilling)) {
+    pthread_mutex_lock(&pool->lock);
+    atomic_store(&pool->refilling, 1);
+    pthread_cond_broadcast(&pool->wakeup);
+    pthread_mutex_unlock(&pool->lock);
+  }
+  return 0;
+}
+
+
+void keypool_get_stats(keypool_t *pool, keypool_stats_t *stats)
+{
+  unsigned long long busy_ns = atomic_load(&pool->busy_ns);
+
+  stats->capacity = (unsigned int)pool->capacity;
+  stats->low_watermark = (unsigned int)pool->low_watermark;
+  stats->fill = (unsigned int)fill_level(pool);
+  stats->generated = atomic_load(&pool->generated);
+  stats->served = atomic_load(&pool->served);
+  stats->misses = atomic_load(&pool->misses);
+  // busy_ns adds up the time of all threads, so this is the aggregate rate while they are all generating
+  stats->refill_rate = (busy_ns != 0) ? (double)stats->generated*pool->nthreads*1e9/(double)busy_ns : 0.0;
+}
+
+
+void keypool_destroy(keypool_t *pool)
+{
+  unsigned int i;
+
+  pthread_mutex_lock(&pool->lock);
+  atomic_store(&pool->stop, 1);
+  pthread_cond_broadcast(&pool->wakeup);
+  pthread_mutex_unlock(&pool->lock);
+  for (i = 0; i < pool->nthreads; i++)
+    pthread_join(pool->threads[i], NULL);
+
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->wakeup);
+  qtesla_clear(pool->slots, pool->capacity*sizeof(keypool_slot_t));
+  free(pool->slots);
+  free(pool->threads);
+  free(pool);
+}
@@ -0,0 +1,36 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: pool of key pairs pre-generated by background threads
+**************************************************************************************/
+
+#ifndef __KEYPOOL_H
+#define __KEYPOOL_H
+
+#include "api.h"
+
+typedef struct keypool keypool_t;
+
+typedef struct {
+  unsigned int capacity;          // Key pairs stored when the pool is full (high watermark)
+  unsigned int low_watermark;     // Background threads resume when the fill level drops below this
+  unsigned int fill;              // Key pairs currently stored
+  unsigned long long generated;   // Key pairs generated by the background threads
+  unsigned long long served;      // Key pairs handed out from the pool
+  unsigned long long misses;      // Requests that found the pool empty and generated a key pair inline
+  double refill_rate;             // Key pairs per second generated by the background threads while active
+} keypool_stats_t;
+
+// Creates a pool of "capacity" key pairs refilled by "nthreads" background threads once its fill level
+// drops below "low_watermark", between 1 and "capacity". Returns NULL on failure
+keypool_t *keypool_create(unsigned int capacity, unsigned int low_watermark, unsigned int nthreads);
+
+// Outputs a key pair from the pool, or generates one with crypto_sign_keypair() if the pool is empty
+int keypool_get(keypool_t *pool, unsigned char *pk, unsigned char *sk);
+
+void keypool_get_stats(keypool_t *pool, keypool_stats_t *stats);
+
+// Stops the background threads and erases the stored key pairs
+void keypool_destroy(keypool_t *pool);
+
+#endif
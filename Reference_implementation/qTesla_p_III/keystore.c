@@ -0,0 +1,332 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: on-disk store of expanded keys, mapped into memory for signing and
+*           verification without expanding the keys again
+*
+* A store is a header page followed by fixed-size records aligned to CRYPTO_WORKSPACEALIGN,
+* so the polynomials of a mapped record are used in place. Opening a store reads the header
+* and maps the file, whatever the number of keys; the digest of a record is checked once,
+* on its first use, by whichever thread gets there first.
+**************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "api.h"
+#include "sign_step.h"
+#include "keystore.h"
+#include "sha3/fips202.h"
+
+#define KEYSTORE_IMPL "ref"
+#define KEYSTORE_ENDIAN 0x01020304
+#define RECORD_DIGESTED offsetof(keystore_record_t, digest)
+
+enum { RECORD_UNCHECKED, RECORD_VALID, RECORD_CORRUPTED };
+
+typedef struct {
+  char magic[8];                   // "qTESLAks"
+  uint32_t version;                // KEYSTORE_VERSION
+  uint32_t endian;                 // KEYSTORE_ENDIAN, in the byte order of the writer
+  char algname[16];                // CRYPTO_ALGNAME
+  char impl[8];                    // KEYSTORE_IMPL
+  uint32_t record_bytes, nkeys;
+  uint64_t data_offset;            // KEYSTORE_DATA_OFFSET
+  unsigned char digest[KEYSTORE_DIGEST_BYTES];   // SHAKE256 of the fields above
+} keystore_header_t;
+
+_Static_assert(sizeof(keystore_header_t) <= KEYSTORE_DATA_OFFSET, "the header does not fit before the records");
+_Static_assert(KEYSTORE_DATA_OFFSET % CRYPTO_WORKSPACEALIGN == 0 && sizeof(keystore_record_t) % CRYPTO_WORKSPACEALIGN == 0, 
+               "records must be aligned to CRYPTO_WORKSPACEALIGN");
+
+struct keystore {
+  const unsigned char *base;
+  size_t size;
+  const keystore_record_t *records;
+  unsigned int n, flags;
+  atomic_uchar *state;   // RECORD_UNCHECKED, RECORD_VALID or RECORD_CORRUPTED for each record
+};
+
+
+static void header_init(keystore_header_t *h, unsigned int n)
+{
+  memset(h, 0, sizeof(keystore_header_t));
+  memcpy(h->magic, "qTESLAks", sizeof(h->magic));
+  h->version = KEYSTORE_VERSION;
+  h->endian = KEYSTORE_ENDIAN;
+  strncpy(h->algname, CRYPTO_ALGNAME, sizeof(h->algname));
+  strncpy(h->impl, KEYSTORE_IMPL, sizeof(h->impl));
+  h->record_bytes = sizeof(keystore_record_t);
+  h->nkeys = n;
+  h->data_offset = KEYSTORE_DATA_OFFSET;
+  shake256(h->digest, KEYSTORE_DIGEST_BYTES, (const unsigned char *)h, offsetof(keystore_header_t, digest));
+}
+
+
+static void record_digest(unsigned char *digest, const keystore_record_t *r, unsigned int i)
+{ // The index is hashed too, so that records cannot be swapped
+  unsigned char index[4] = { (unsigned char)i, (unsigned char)(i >> 8), (unsigned char)(i >> 16), (unsigned char)(i >> 24) };
+  unsigned char buf[SHAKE256_RATE];
+  uint64_t s[26];
+
+  shake256_inc_init(s);
+  shake256_inc_absorb(s, (const unsigned char *)r, RECORD_DIGESTED);
+  shake256_inc_absorb(s, index, sizeof(index));
+  shake256_inc_finalize(s);
+  shake256_squeezeblocks(buf, 1, s);
+  memcpy(digest, buf, KEYSTORE_DIGEST_BYTES);
+}
+
+
+static int write_all(int fd, const void *buf, size_t n)
+{
+  const unsigned char *p = buf;
+  ssize_t w;
+
+  while (n > 0) {
+    w = write(fd, p, n);
+    if (w <= 0)
+      return -1;
+    p += w;
+    n -= (size_t)w;
+  }
+  return 0;
+}
+
+
+static int fsync_path(const char *dir)
+{ // Flushes the entries of directory "dir"
+  int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC), rsp;
+
+  if (fd < 0)
+    return -1;
+  rsp = fsync(fd);
+  close(fd);
+  return rsp;
+}
+
+
+static int sync_dir(const char *path)
+{ // Flushes the directory entry of "path", so that a rename into it survives a crash
+  const char *slash = strrchr(path, '/');
+  char *dir;
+  int rsp;
+
+  if (slash == NULL)
+    return fsync_path(".");
+  dir = strndup(path, (slash == path) ? 1 : (size_t)(slash - path));
+  if (dir == NULL)
+    return -1;
+  rsp = fsync_path(dir);
+  free(dir);
+  return rsp;
+}
+
+
+int keystore_write(const char *path, const unsigned char *const *pk, const unsigned char *const *sk, unsigned int n)
+{ // Writes the store to a new file "path.XXXXXX" and renames it over "path" once it is on disk, so that a failed write
+  // leaves the old store in place and processes that have it mapped keep reading the old file. mkstemp() creates the
+  // file with mode 0600 and fails rather than reuse an existing file or follow a symbolic link
+  static const unsigned char zero[KEYSTORE_DATA_OFFSET];
+  keystore_header_t h;
+  keystore_record_t *r;
+  void *ws, *rec;
+  char *tmp;
+  int fd = -1, rsp = -1;
+  unsigned int i;
+
+  if (posix_memalign(&ws, CRYPTO_WORKSPACEALIGN, CRYPTO_WORKSPACEBYTES) != 0)
+    return -1;
+  if (posix_memalign(&rec, CRYPTO_WORKSPACEALIGN, sizeof(keystore_record_t)) != 0) {
+    free(ws);
+    return -1;
+  }
+  r = rec;
+  tmp = malloc(strlen(path) + sizeof(".XXXXXX"));
+  if (tmp == NULL)
+    goto out;
+  strcpy(tmp, path);
+  strcat(tmp, ".XXXXXX");
+  fd = mkstemp(tmp);
+  if (fd < 0)
+    goto out;
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+  header_init(&h, n);
+  if (write_all(fd, &h, sizeof(h)) != 0 || write_all(fd, zero, KEYSTORE_DATA_OFFSET - sizeof(h)) != 0)
+    goto out;
+  for (i = 0; i < n; i++) {
+    memset(r, 0, sizeof(keystore_record_t));   // The padding is digested too
+    qtesla_expand_pk(&r->x, pk[i], ws);
+    memcpy(r->pk, pk[i], CRYPTO_PUBLICKEYBYTES);
+    if (sk != NULL && sk[i] != NULL) {
+      // The secret key holds seed_a and the hash of its public key
+      if (memcmp(&sk[i][CRYPTO_SECRETKEYBYTES-HM_BYTES-2*CRYPTO_SEEDBYTES], &pk[i][CRYPTO_PUBLICKEYBYTES-CRYPTO_SEEDBYTES], CRYPTO_SEEDBYTES) != 0 ||
+          memcmp(&sk[i][CRYPTO_SECRETKEYBYTES-HM_BYTES], r->x.hash_pk, HM_BYTES) != 0)
+        goto out;
+      memcpy(r->sk, sk[i], CRYPTO_SECRETKEYBYTES);
+      r->has_sk = 1;
+    }
+    record_digest(r->digest, r, i);
+    if (write_all(fd, r, sizeof(keystore_record_t)) != 0)
+      goto out;
+  }
+  rsp = fsync(fd);
+
+out:
+  if (fd >= 0 && close(fd) != 0)
+    rsp = -1;
+  if (rsp == 0 && (rename(tmp, path) != 0 || sync_dir(path) != 0))
+    rsp = -1;
+  if (rsp != 0 && fd >= 0)
+    unlink(tmp);
+  qtesla_clear(r, sizeof(keystore_record_t));
+  free(tmp);
+  free(rec);
+  free(ws);
+  return rsp;
+}
+
+
+static int check_record(keystore_t *ks, unsigned int i)
+{ // Returns 1 if the digest of record i matches. Threads that check the same record concurrently reach the same result
+  unsigned char digest[KEYSTORE_DIGEST_BYTES];
+  unsigned char state = atomic_load_explicit(&ks->state[i], memory_order_acquire);
+
+  if (state == RECORD_UNCHECKED) {
+    record_digest(digest, &ks->records[i], i);
+    state = (memcmp(digest, ks->records[i].digest, KEYSTORE_DIGEST_BYTES) == 0) ? RECORD_VALID : RECORD_CORRUPTED;
+    atomic_store_explicit(&ks->state[i], state, memory_order_release);
+  }
+  return state == RECORD_VALID;
+}
+
+
+keystore_t *keystore_open(const char *path, unsigned int flags)
+{
+  keystore_header_t h, expected;
+  keystore_t *ks;
+  struct stat st;
+  void *base;
+  int fd, mflags = MAP_SHARED;
+  unsigned int i;
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  if (fstat(fd, &st) != 0 || pread(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h)) {
+    close(fd);
+    return NULL;
+  }
+  header_init(&expected, h.nkeys);   // Any other header, or a digest that does not match it, is rejected
+  if (memcmp(&h, &expected, sizeof(h)) != 0 ||
+      (unsigned long long)st.st_size < KEYSTORE_DATA_OFFSET + (unsigned long long)h.nkeys*sizeof(keystore_record_t)) {
+    close(fd);
+    return NULL;
+  }
+
+#ifdef MAP_POPULATE
+  if (flags & KEYSTORE_POPULATE)
+    mflags |= MAP_POPULATE;
+#endif
+  base = mmap(NULL, (size_t)st.st_size, PROT_READ, mflags, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+    return NULL;
+#ifdef MADV_HUGEPAGE
+  if (flags & KEYSTORE_HUGEPAGES)
+    madvise(base, (size_t)st.st_size, MADV_HUGEPAGE);   // Only a hint: a kernel without huge pages for files ignores it
+#endif
+
+  ks = calloc(1, sizeof(keystore_t));
+  if (ks != NULL)
+    ks->state = calloc(h.nkeys + 1, sizeof(atomic_uchar));
+  if (ks == NULL || ks->state == NULL) {
+    free(ks);
+    munmap(base, (size_t)st.st_size);
+    return NULL;
+  }
+  ks->base = base;
+  ks->size = (size_t)st.st_size;
+  ks->records = (const keystore_record_t *)(ks->base + KEYSTORE_DATA_OFFSET);
+  ks->n = h.nkeys;
+  ks->flags = flags;
+  if (flags & KEYSTORE_VERIFY_ALL) {
+    for (i = 0; i < ks->n; i++) {
+      if (!check_record(ks, i)) {
+        keystore_close(ks);
+        return NULL;
+      }
+    }
+  }
+  return ks;
+}
+
+
+unsigned int keystore_count(keystore_t *ks)
+{
+  return ks->n;
+}
+
+
+const keystore_record_t *keystore_get(keystore_t *ks, unsigned int i)
+{
+  if (i >= ks->n)
+    return NULL;
+  if (!(ks->flags & KEYSTORE_VERIFY_NONE) && !check_record(ks, i))
+    return NULL;
+  return &ks->records[i];
+}
+
+
+int keystore_sign_ws(keystore_t *ks, unsigned int i, unsigned char *sm, unsigned long long *smlen, const unsigned char *m, unsigned long long mlen, void *ws)
+{
+  const keystore_record_t *r = keystore_get(ks, i);
+  qtesla_sign_t st;
+
+  if (r == NULL || !r->has_sk)
+    return -1;
+  qtesla_sign_begin_a(&st, m, mlen, r->sk, r->x.a, ws);
+  qtesla_sign_step(&st, 0);
+  return qtesla_sign_finish(&st, sm, smlen);
+}
+
+
+int keystore_sign(keystore_t *ks, unsigned int i, unsigned char *sm, unsigned long long *smlen, const unsigned char *m, unsigned long long mlen)
+{
+  _Alignas(CRYPTO_WORKSPACEALIGN) unsigned char ws[CRYPTO_WORKSPACEBYTES];
+
+  return keystore_sign_ws(ks, i, sm, smlen, m, mlen, ws);
+}
+
+
+int keystore_verify_ws(keystore_t *ks, unsigned int i, unsigned char *m, unsigned long long *mlen, const unsigned char *sm, unsigned long long smlen, void *ws)
+{
+  const keystore_record_t *r = keystore_get(ks, i);
+
+  if (r == NULL)
+    return -1;
+  return qtesla_open_expanded(m, mlen, sm, smlen, &r->x, ws);
+}
+
+
+int keystore_verify(keystore_t *ks, unsigned int i, unsigned char *m, unsigned long long *mlen, const unsigned char *sm, unsigned long long smlen)
+{
+  _Alignas(CRYPTO_WORKSPACEALIGN) unsigned char ws[CRYPTO_WORKSPACEBYTES];
+
+  return keystore_verify_ws(ks, i, m, mlen, sm, smlen, ws);
+}
+
+
+void keystore_close(keystore_t *ks)
+{
+  munmap((void *)ks->base, ks->size);
+  free(ks->state);
+  free(ks);
+}
@@ -30,6 +30,10 @@
 #define PARAM_R2_INVN 513161157
 #define PARAM_R 14237691
 #define SHAKE shake256
+#define SHAKE_INC_INIT shake256_inc_init
+#define SHAKE_INC_ABSORB shake256_inc_absorb
+#define SHAKE_INC_FINALIZE shake256_inc_finalize
+#define SHAKE_SQUEEZEBLOCKS shake256_squeezeblocks
 #define cSHAKE cshake256_simple
 #define SHAKE_RATE SHAKE256_RATE
 
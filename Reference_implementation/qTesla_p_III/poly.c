@@ -4,20 +4,22 @@
 * Abstract: NTT, modular reduction and polynomial functions
 **************************************************************************************/
 
+#include <string.h>
 #include "poly.h"
 #include "sha3/fips202.h"
 #include "api.h"
 
+#define SPARSE_MUL32_BLOCK 256
+
 extern poly zeta;
 extern poly zetainv;
 
 
-void poly_uniform(poly_k a, const unsigned char *seed)         
-{ // Generation of polynomials "a_i"
+void poly_uniform(poly_k a, const unsigned char *seed, unsigned char *buf)
+{ // Generation of polynomials "a_i". "buf" holds POLY_UNIFORM_BYTES bytes
   unsigned int pos=0, i=0, nbytes = (PARAM_Q_LOG+7)/8;
   unsigned int nblocks=PARAM_GEN_A;
   uint32_t val1, val2, val3, val4, mask = (uint32_t)(1<<PARAM_Q_LOG)-1;
-  unsigned char buf[SHAKE128_RATE*PARAM_GEN_A];
   uint16_t dmsp=0;
 
   cshake128_simple(buf, SHAKE128_RATE*PARAM_GEN_A, dmsp++, seed, CRYPTO_RANDOMBYTES);    
@@ -48,6 +50,51 @@ void poly_uniform(poly_k a, const unsigned char *seed)
 }
 
 
+void poly_uniform_init(poly_uniform_t *st, const unsigned char *seed)
+{ // Start the output of poly_uniform() for "seed". The first cSHAKE128 output is squeezed one block at a time
+  cshake128_simple_absorb(st->s, 0, seed, CRYPTO_RANDOMBYTES);
+  st->seed = seed;
+  st->dmsp = 1;
+  st->nblocks = PARAM_GEN_A;
+  st->offset = 0;   // Output bytes of the current cSHAKE128 call that precede buf
+  st->pos = 0;
+  st->len = 0;
+  st->nval = 0;     // Values already read from the current group of four
+}
+
+
+void poly_uniform_next(poly a, poly_uniform_t *st)
+{ // Output the next polynomial "a_i" of poly_uniform(), reading the same bytes and applying the same refill rule
+  unsigned int i=0, nbytes = (PARAM_Q_LOG+7)/8;
+  uint32_t val, mask = (uint32_t)(1<<PARAM_Q_LOG)-1;
+
+  while (i < PARAM_N) {
+    if (st->nval == 0) {
+      if (st->offset + st->pos > SHAKE128_RATE*st->nblocks - 4*nbytes) {
+        st->nblocks = 1;
+        cshake128_simple(st->buf, SHAKE128_RATE, st->dmsp++, st->seed, CRYPTO_RANDOMBYTES);
+        st->offset = 0;
+        st->pos = 0;
+        st->len = SHAKE128_RATE;
+      }
+      if (st->pos + 4*nbytes > st->len) {   // Keep the unread bytes and squeeze the next block after them
+        memmove(st->buf, st->buf+st->pos, st->len-st->pos);
+        st->offset += st->pos;
+        st->len -= st->pos;
+        st->pos = 0;
+        cshake128_simple_squeezeblocks(st->buf+st->len, 1, st->s);
+        st->len += SHAKE128_RATE;
+      }
+    }
+    val = (*(uint32_t*)(st->buf+st->pos)) & mask;
+    st->pos += nbytes;
+    st->nval = (st->nval+1) & 3;
+    if (val < PARAM_Q)
+      a[i++] = reduce((int64_t)val*PARAM_R2_INVN);
+  }
+}
+
+
 int32_t reduce(int64_t a)
 { // Montgomery reduction
   int64_t u;
@@ -220,19 +267,23 @@ void sparse_mul8(poly prod, const unsigned char *s, const uint32_t pos_list[PARA
 *              - poly prod: product of 2 polynomials
 *********************************************************************************************/
 void sparse_mul32(poly prod, const int32_t *pk, const uint32_t pos_list[PARAM_H], const int16_t sign_list[PARAM_H])
-{
-  int i, j, pos;
-  int64_t temp[PARAM_N] = {0};
+{ // The product is accumulated SPARSE_MUL32_BLOCK coefficients at a time to keep the 64-bit accumulator small
+  int i, j, pos, b;
+  int64_t temp[SPARSE_MUL32_BLOCK];
   
-  for (i=0; i<PARAM_H; i++) {
-    pos = pos_list[i];
-    for (j=0; j<pos; j++) {
-        temp[j] = temp[j] - sign_list[i]*pk[j+PARAM_N-pos];
-    }
-    for (j=pos; j<PARAM_N; j++) {
-        temp[j] = temp[j] + sign_list[i]*pk[j-pos];
+  for (b=0; b<PARAM_N; b+=SPARSE_MUL32_BLOCK) {
+    for (j=0; j<SPARSE_MUL32_BLOCK; j++)
+      temp[j] = 0;
+    for (i=0; i<PARAM_H; i++) {
+      pos = pos_list[i];
+      for (j=b; j<pos && j<b+SPARSE_MUL32_BLOCK; j++) {
+          temp[j-b] = temp[j-b] - sign_list[i]*pk[j+PARAM_N-pos];
+      }
+      for (j=(pos>b ? pos : b); j<b+SPARSE_MUL32_BLOCK; j++) {
+          temp[j-b] = temp[j-b] + sign_list[i]*pk[j-pos];
+      }
     }
+    for (j=0; j<SPARSE_MUL32_BLOCK; j++)
+      prod[b+j] = (int32_t)barr_reduce64(temp[j]);
   }
-  for (i=0; i<PARAM_N; i++)
-    prod[i] = (int32_t)barr_reduce64(temp[i]);
 }
\ No newline at end of file
@@ -0,0 +1,169 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: detached signatures of large messages over a tree hash (prehash) that
+*           hashes the leaves of the message in parallel
+*
+* The message is cut into leaves of QTESLA_PREHASH_LEAF_BYTES bytes that are hashed 
+* independently, as in ParallelHash and KangarooTwelve, and the root absorbs their chaining
+* values in order. The leaves are split into groups for parallel_for(), and each group
+* hashes its leaves one at a time. The chaining values of a round of groups are kept in
+* the signing workspace, which is then reused to sign the prehash.
+**************************************************************************************/
+
+#include <string.h>
+#include <stdint.h>
+#include "api.h"
+#include "params.h"
+#include "sign_step.h"
+#include "prehash.h"
+#include "parallel.h"
+#include "sha3/fips202.h"
+
+#define PREHASH_LEAF_CSTM (0x4C00 | QTESLA_PREHASH_VERSION)
+#define PREHASH_ROOT_CSTM (0x5200 | QTESLA_PREHASH_VERSION)
+#define PREHASH_GROUP_LEAVES 16   // Leaves per call of hash_group()
+#define PREHASH_ROUND_GROUPS 64   // Groups whose chaining values are kept at once
+
+_Static_assert(PREHASH_ROUND_GROUPS*PREHASH_GROUP_LEAVES*QTESLA_PREHASH_CV_BYTES <= CRYPTO_WORKSPACEBYTES, 
+               "the chaining values of a round do not fit in the workspace");
+
+typedef struct {
+  const unsigned char *m;
+  unsigned long long mlen, nleaves, first;
+  unsigned char *cv;
+} prehash_round_t;
+
+
+static void hash_leaves(unsigned char *cv, const unsigned char *m, unsigned long long mlen, unsigned long long first, unsigned long long end)
+{ // Chaining values of leaves first..end-1
+  unsigned long long i, len;
+
+  for (i = first; i < end; i++) {
+    len = mlen - i*QTESLA_PREHASH_LEAF_BYTES;
+    if (len > QTESLA_PREHASH_LEAF_BYTES)
+      len = QTESLA_PREHASH_LEAF_BYTES;
+    cshake256_simple(&cv[(i - first)*QTESLA_PREHASH_CV_BYTES], QTESLA_PREHASH_CV_BYTES, PREHASH_LEAF_CSTM, &m[i*QTESLA_PREHASH_LEAF_BYTES], len);
+  }
+}
+
+
+static void store_le(unsigned char *p, unsigned long long x, unsigned int nbytes)
+{
+  for (unsigned int i = 0; i < nbytes; i++)
+    p[i] = (unsigned char)(x >> 8*i);
+}
+
+
+static void hash_group(void *arg, unsigned int g)
+{ // Chaining values of the leaves of group g of the round
+  prehash_round_t *r = arg;
+  unsigned long long first = r->first + (unsigned long long)g*PREHASH_GROUP_LEAVES, end = first + PREHASH_GROUP_LEAVES;
+
+  if (end > r->nleaves)
+    end = r->nleaves;
+  hash_leaves(&r->cv[(size_t)g*PREHASH_GROUP_LEAVES*QTESLA_PREHASH_CV_BYTES], r->m, r->mlen, first, end);
+}
+
+
+void qtesla_prehash_ws(unsigned char *hm, const unsigned char *m, unsigned long long mlen, void *ws)
+{
+  static const unsigned char tag[14] = "qTESLA prehash";
+  unsigned char *cv = ws, buf[SHAKE256_RATE];
+  unsigned char header[sizeof(tag) + 1 + 4];
+  unsigned long long n;
+  uint64_t s[26];
+  prehash_round_t r;
+
+  r.m = m;
+  r.mlen = mlen;
+  r.nleaves = (mlen + QTESLA_PREHASH_LEAF_BYTES - 1)/QTESLA_PREHASH_LEAF_BYTES;
+  r.cv = cv;
+  memcpy(header, tag, sizeof(tag));
+  header[sizeof(tag)] = QTESLA_PREHASH_VERSION;
+  store_le(&header[sizeof(tag) + 1], QTESLA_PREHASH_LEAF_BYTES, 4);
+  cshake256_inc_init(s, PREHASH_ROOT_CSTM);
+  shake256_inc_absorb(s, header, sizeof(header));
+
+  // The leaves of a round are hashed in parallel, then their chaining values are absorbed in order
+  for (r.first = 0; r.first < r.nleaves; r.first += n) {
+    n = r.nleaves - r.first;
+    if (n > PREHASH_ROUND_GROUPS*PREHASH_GROUP_LEAVES)
+      n = PREHASH_ROUND_GROUPS*PREHASH_GROUP_LEAVES;
+    parallel_for((unsigned int)((n + PREHASH_GROUP_LEAVES - 1)/PREHASH_GROUP_LEAVES), hash_group, &r);
+    shake256_inc_absorb(s, cv, n*QTESLA_PREHASH_CV_BYTES);
+  }
+  store_le(buf, mlen, 8);
+  shake256_inc_absorb(s, buf, 8);
+  cshake256_inc_finalize(s);
+  shake256_squeezeblocks(buf, 1, s);
+  memcpy(hm, buf, HM_BYTES);
+}
+
+
+/***************************************************************
+* Name:        crypto_sign_prehash_ws
+* Description: outputs a detached signature of the prehash of m
+* Parameters:  inputs:
+*              - const unsigned char *m: message to be signed
+*              - unsigned long long mlen: message length
+*              - const unsigned char* sk: secret key
+*              - void *ws: workspace of CRYPTO_WORKSPACEBYTES bytes
+*              outputs:
+*              - unsigned char *sig: signature
+*              - unsigned long long *siglen: signature length
+* Returns:     0 for successful execution
+***************************************************************/
+int crypto_sign_prehash_ws(unsigned char *sig, unsigned long long *siglen, const unsigned char *m, unsigned long long mlen, const unsigned char *sk, void *ws)
+{
+  unsigned char hm[HM_BYTES];
+  qtesla_sign_t st;
+
+  qtesla_prehash_ws(hm, m, mlen, ws);
+  qtesla_sign_begin_hm(&st, hm, sk, ws);
+  qtesla_sign_step(&st, 0);
+  return qtesla_sign_finish(&st, sig, siglen);
+}
+
+
+/************************************************************
+* Name:        crypto_sign_open_prehash_ws
+* Description: verification of a detached signature of the 
+*              prehash of m
+* Parameters:  inputs:
+*              - const unsigned char *sig: signature
+*              - unsigned long long siglen: signature length
+*              - const unsigned char *m: signed message
+*              - unsigned long long mlen: message length
+*              - const unsigned char* pk: public Key
+*              - void *ws: workspace of CRYPTO_WORKSPACEBYTES bytes
+* Returns:     0 for valid signature
+*              <0 for invalid signature
+************************************************************/
+int crypto_sign_open_prehash_ws(const unsigned char *sig, unsigned long long siglen, const unsigned char *m, unsigned long long mlen, const unsigned char *pk, void *ws)
+{
+  unsigned char hm[HM_BYTES];
+
+  qtesla_prehash_ws(hm, m, mlen, ws);
+  return qtesla_verify_hm(sig, siglen, hm, pk, ws);
+}
+
+
+/**********************************************************
+* crypto_sign_prehash and crypto_sign_open_prehash run the
+* _ws functions with a workspace on the stack
+**********************************************************/
+int crypto_sign_prehash(unsigned char *sig, unsigned long long *siglen, const unsigned char *m, unsigned long long mlen, const unsigned char *sk)
+{
+  _Alignas(CRYPTO_WORKSPACEALIGN) unsigned char ws[CRYPTO_WORKSPACEBYTES];
+
+  return crypto_sign_prehash_ws(sig, siglen, m, mlen, sk, ws);
+}
+
+
+int crypto_sign_open_prehash(const unsigned char *sig, unsigned long long siglen, const unsigned char *m, unsigned long long mlen, const unsigned char *pk)
+{
+  _Alignas(CRYPTO_WORKSPACEALIGN) unsigned char ws[CRYPTO_WORKSPACEBYTES];
+
+  return crypto_sign_open_prehash_ws(sig, siglen, m, mlen, pk, ws);
+}
@@ -0,0 +1,41 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: detached signatures of large messages over a tree hash (prehash) that
+*           hashes the leaves of the message in parallel
+*
+* NOTE: a prehash signature of m is not a signature of m for crypto_sign_open(): it
+*       signs the prehash of m in place of H(m), and must be checked with
+*       crypto_sign_open_prehash()
+**************************************************************************************/
+
+#ifndef __PREHASH_H
+#define __PREHASH_H
+
+#include "api.h"
+
+#define QTESLA_PREHASH_VERSION 2
+#define QTESLA_PREHASH_LEAF_BYTES 8192   // Bytes of m per leaf; the last leaf may be shorter
+#define QTESLA_PREHASH_CV_BYTES 64       // Chaining value of a leaf
+
+// Outputs in hm the HM_BYTES-byte prehash of m, version QTESLA_PREHASH_VERSION. Leaf i is cSHAKE256 of bytes 
+// [i*QTESLA_PREHASH_LEAF_BYTES, (i+1)*QTESLA_PREHASH_LEAF_BYTES) of m with S = 0x4C00 | version ("L"), truncated to
+// QTESLA_PREHASH_CV_BYTES. The prehash is cSHAKE256("qTESLA prehash" || version || leaf bytes (32-bit) || leaf 0 ||
+// ... || leaf n-1 || mlen (64-bit)) with S = 0x5200 | version ("R"), integers in little-endian. Leaves run on the
+// helper threads of parallel_for(). The chaining values are kept in ws, a workspace of CRYPTO_WORKSPACEBYTES bytes.
+// The customization makes the prehash a different function from the SHAKE hash H(m) of crypto_sign(): a prehash
+// signature verifies with crypto_sign_open() only for a message m* with H(m*) equal to the prehash
+void qtesla_prehash_ws(unsigned char *hm, const unsigned char *m, unsigned long long mlen, void *ws);
+
+// Outputs in sig the CRYPTO_BYTES-byte signature of the prehash of m. Returns 0
+int crypto_sign_prehash(unsigned char *sig, unsigned long long *siglen, const unsigned char *m, unsigned long long mlen, const unsigned char *sk);
+
+// Verifies a signature output by crypto_sign_prehash(). Returns 0 if valid, otherwise a negative value
+int crypto_sign_open_prehash(const unsigned char *sig, unsigned long long siglen, const unsigned char *m, unsigned long long mlen, const unsigned char *pk);
+
+// crypto_sign_prehash and crypto_sign_open_prehash with a workspace of CRYPTO_WORKSPACEBYTES bytes aligned to 
+// CRYPTO_WORKSPACEALIGN, which also holds the chaining values
+int crypto_sign_prehash_ws(unsigned char *sig, unsigned long long *siglen, const unsigned char *m, unsigned long long mlen, const unsigned char *sk, void *ws);
+int crypto_sign_open_prehash_ws(const unsigned char *sig, unsigned long long siglen, const unsigned char *m, unsigned long long mlen, const unsigned char *pk, void *ws);
+
+#endif
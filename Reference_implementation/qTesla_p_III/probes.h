@@ -0,0 +1,72 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: USDT (SystemTap SDT) probe points for bpftrace, perf and SystemTap
+**************************************************************************************/
+
+#ifndef __PROBES_H
+#define __PROBES_H
+
+#include <stdint.h>
+
+// Probes of provider "qtesla", built unless USDT=FALSE. An unattached probe is a single nop; its arguments are
+// only placed in registers or memory that already hold them. Arguments are passed as signed 64-bit values:
+//   keygen_entry, keygen_return(rejections)    sign_entry(mlen), sign_return(iterations)
+//   verify_entry(smlen), verify_return(result) reject(reason, nonce), reason as in qtesla_reject_t ("stats.h")
+//   phase_entry(phase), phase_return(phase)    phase as in qtesla_phase_t, around the Keccak-based phases
+//                                              QTESLA_PHASE_GEN_A, QTESLA_PHASE_SAMPLE_Y and QTESLA_PHASE_HASH_H
+
+#if defined(USDT) && defined(__has_include)
+  #if __has_include(<sys/sdt.h>)
+    #define QTESLA_SYS_SDT
+  #endif
+#endif
+
+#if defined(USDT) && defined(QTESLA_SYS_SDT)
+
+#include <sys/sdt.h>
+
+#define QTESLA_PROBE(name)              DTRACE_PROBE(qtesla, name)
+#define QTESLA_PROBE1(name, a1)         DTRACE_PROBE1(qtesla, name, (int64_t)(a1))
+#define QTESLA_PROBE2(name, a1, a2)     DTRACE_PROBE2(qtesla, name, (int64_t)(a1), (int64_t)(a2))
+
+#elif defined(USDT) && defined(__x86_64__) && defined(__ELF__)
+
+// Without <sys/sdt.h> (systemtap-sdt-dev), emit the same nop and .note.stapsdt ELF note it would
+#define QTESLA_SDT_NOTE(name, args)                                            \
+  "990: nop\n"                                                                 \
+  ".pushsection .note.stapsdt,\"\",\"note\"\n"                                 \
+  ".balign 4\n"                                                                \
+  ".4byte 992f-991f, 994f-993f, 3\n"                                           \
+  "991: .asciz \"stapsdt\"\n"                                                  \
+  "992: .balign 4\n"                                                           \
+  "993: .8byte 990b\n"                                                         \
+  ".8byte _.stapsdt.base\n"                                                    \
+  ".8byte 0\n"                                                                 \
+  ".asciz \"qtesla\"\n"                                                        \
+  ".asciz \"" #name "\"\n"                                                     \
+  ".asciz \"" args "\"\n"                                                      \
+  "994: .balign 4\n"                                                           \
+  ".popsection\n"                                                              \
+  ".ifndef _.stapsdt.base\n"                                                   \
+  ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n"      \
+  ".weak _.stapsdt.base\n"                                                     \
+  ".hidden _.stapsdt.base\n"                                                   \
+  "_.stapsdt.base: .space 1\n"                                                 \
+  ".size _.stapsdt.base, 1\n"                                                  \
+  ".popsection\n"                                                              \
+  ".endif\n"
+
+#define QTESLA_PROBE(name)              __asm__ __volatile__ (QTESLA_SDT_NOTE(name, ""))
+#define QTESLA_PROBE1(name, a1)         __asm__ __volatile__ (QTESLA_SDT_NOTE(name, "-8@%0") :: "nor" ((int64_t)(a1)))
+#define QTESLA_PROBE2(name, a1, a2)     __asm__ __volatile__ (QTESLA_SDT_NOTE(name, "-8@%0 -8@%1") :: "nor" ((int64_t)(a1)), "nor" ((int64_t)(a2)))
+
+#else
+
+#define QTESLA_PROBE(name)
+#define QTESLA_PROBE1(name, a1)
+#define QTESLA_PROBE2(name, a1, a2)
+
+#endif
+
+#endif
@@ -1,67 +1,258 @@
 /******************************************************
 * Hardware-based random number generation function
+*
+* randombytes() serves requests from a per-thread buffer 
+* filled by a SHAKE256-based DRBG. The DRBG is seeded from 
+* the operating system on first use in each thread, every
+* DRBG_RESEED_BYTES of output and after a fork. Every refill
+* replaces the DRBG key, so served bytes cannot be 
+* recomputed from a later state
+*
+* Replay builds (make REPLAY=TRUE) are NOT for production:
+* each thread's DRBG is keyed from a fixed seed and never
+* reseeded, so benchmarks see the same randomness, and the 
+* same rejections, in every run
 *******************************************************/ 
 
 #include "random.h"
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <sys/syscall.h>
-static int lock = -1;
-#define _GNU_SOURCE
 
 #define passed 0 
 #define failed 1
 
+static int urandom_fd = -1;
+static pthread_once_t urandom_once = PTHREAD_ONCE_INIT;
 
-static __inline void delay(unsigned int count)
-{
-  while (count--) {}
+
+static void urandom_open(void)
+{ // Opens /dev/urandom once per process; the descriptor is not inherited across exec
+  do {
+    urandom_fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+  } while (urandom_fd == -1 && errno == EINTR);
 }
 
 
 static int randombytes_internal(unsigned char* random_array, unsigned int nbytes)
-{ // Generation of "nbytes" of random values
-  int r, n = nbytes, count = 0;
-    
-  if (lock == -1) {
-    do {
-      lock = open("/dev/urandom", O_RDONLY);
-      if (lock == -1) {
-        delay(0xFFFFF);
-      }
-    } while (lock == -1);
-  }
+{ // Generation of "nbytes" of random values from /dev/urandom
+  ssize_t r;
 
-  while (n > 0) {
-    do {
-      r = read(lock, random_array+count, n);
-      if (r == -1) {
-        delay(0xFFFF);
-      }
-    } while (r == -1);
-    count += r;
-    n -= r;
+  pthread_once(&urandom_once, urandom_open);
+  if (urandom_fd == -1)
+    return failed;
+
+  while (nbytes > 0) {
+    r = read(urandom_fd, random_array, nbytes);
+    if (r == -1 && errno == EINTR)
+      continue;
+    if (r <= 0)
+      return failed;
+    random_array += r;
+    nbytes -= (unsigned int)r;
   }
-    return passed;
+  return passed;
 }
 
 #if defined(SYS_getrandom)
 
-void randombytes(unsigned char* random_array, unsigned int nbytes)
-{ // Generation of "nbytes" of random values
-  // Randombytes using system call
+void randombytes_system(unsigned char* random_array, unsigned int nbytes)
+{ // Generation of "nbytes" of random values with the getrandom system call, or from /dev/urandom where 
+  // the kernel lacks it. Aborts when the operating system supplies no randomness
+  long r;
 
-  if (syscall(SYS_getrandom, random_array, (size_t)nbytes, 0) < 0)
-    randombytes_internal(random_array, nbytes);
+  while (nbytes > 0) {
+    r = syscall(SYS_getrandom, random_array, (size_t)nbytes, 0);
+    if (r == -1 && errno == EINTR)
+      continue;
+    if (r <= 0)
+      break;
+    random_array += r;
+    nbytes -= (unsigned int)r;
+  }
+  if (nbytes > 0 && randombytes_internal(random_array, nbytes) != passed)
+    abort();
 }
 
 #else
 
-void randombytes(unsigned char* random_array, unsigned int nbytes)
+void randombytes_system(unsigned char* random_array, unsigned int nbytes)
+{
+  if (randombytes_internal(random_array, nbytes) != passed)
+    abort();
+}
+
+#endif
+
+#include <stdatomic.h>
+#include "../sha3/fips202.h"
+
+#define DRBG_KEY_BYTES      32
+#define DRBG_BUFFER_BYTES   (8*SHAKE256_RATE-DRBG_KEY_BYTES)   // Output bytes per refill, so that a refill squeezes 8 SHAKE256 blocks
+#define DRBG_RESEED_BYTES   (1 << 20)                          // Output bytes between reseeds from the operating system
+
+typedef struct {
+  unsigned char key[DRBG_KEY_BYTES];
+  unsigned char buffer[DRBG_BUFFER_BYTES];
+  unsigned int available;         // Unused bytes at the end of the buffer
+  unsigned int since_reseed;      // Output bytes since the last reseed
+  unsigned int fork_generation;   // Value of drbg_forks at the last reseed
+  int seeded;
+} drbg_t;
+
+static __thread drbg_t drbg;
+static atomic_uint drbg_forks;    // Incremented in the child after every fork
+static pthread_once_t drbg_once = PTHREAD_ONCE_INIT;
+static pthread_key_t drbg_key;
+
+#ifdef REPLAY
+#warning "REPLAY build: randombytes() output is a fixed function of the replay seed, do not use it for real keys"
+
+static unsigned char replay_seed[DRBG_KEY_BYTES];
+static atomic_uint replay_next_stream;   // Stream of the next thread that draws bytes without choosing one
+
+
+static void replay_set_seed(const unsigned char *seed, unsigned int seedlen)
+{
+  shake256(replay_seed, DRBG_KEY_BYTES, seed, seedlen);
+}
+#endif
+
+
+static void erase(void *p, size_t n)
+{ // Clears secret data with stores the compiler cannot remove
+  volatile unsigned char *v = p;
+
+  while (n--)
+    *v++ = 0;
+}
+
+
+static void drbg_erase(void *d)
+{ // Clears the state of a thread's DRBG when the thread exits
+  erase(d, sizeof(drbg_t));
+}
+
+
+static void drbg_fork_child(void)
+{
+  atomic_fetch_add(&drbg_forks, 1);
+}
+
+
+static void drbg_init(void)
 {
-  randombytes_internal(random_array, nbytes);
+#ifdef REPLAY
+  const char *seed = getenv("QTESLA_REPLAY_SEED");
+
+  if (seed == NULL)
+    seed = RANDOMBYTES_REPLAY_SEED;
+  replay_set_seed((const unsigned char *)seed, (unsigned int)strlen(seed));
+#endif
+  pthread_key_create(&drbg_key, drbg_erase);
+  pthread_atfork(NULL, NULL, drbg_fork_child);
 }
 
+
+#ifdef REPLAY
+static void drbg_replay_key(drbg_t *d, unsigned int stream)
+{ // key = SHAKE256(replay seed || stream), so a stream yields the same bytes in every run
+  unsigned char in[DRBG_KEY_BYTES+4];
+
+  memcpy(in, replay_seed, DRBG_KEY_BYTES);
+  for (unsigned int i = 0; i < 4; i++)
+    in[DRBG_KEY_BYTES+i] = (unsigned char)(stream >> 8*i);
+  shake256(d->key, DRBG_KEY_BYTES, in, sizeof(in));
+  d->available = 0;
+  d->since_reseed = 0;
+  d->fork_generation = atomic_load(&drbg_forks);
+  d->seeded = 1;
+}
 #endif
 
+
+static void drbg_refill(drbg_t *d)
+{ // (key, buffer) = SHAKE256(key), or SHAKE256(key || 32 bytes from the operating system) when reseeding
+  unsigned char in[2*DRBG_KEY_BYTES], out[DRBG_KEY_BYTES+DRBG_BUFFER_BYTES];
+  unsigned int inlen = DRBG_KEY_BYTES, forks = atomic_load(&drbg_forks);
+
+  if (!d->seeded) {
+    pthread_once(&drbg_once, drbg_init);
+    pthread_setspecific(drbg_key, d);
+#ifdef REPLAY
+    drbg_replay_key(d, atomic_fetch_add(&replay_next_stream, 1));
+#endif
+  }
+  memcpy(in, d->key, DRBG_KEY_BYTES);
+#ifdef REPLAY
+  d->fork_generation = forks;   // Replay streams are never reseeded from the operating system, after a fork either
+#else
+  if (!d->seeded || d->since_reseed >= DRBG_RESEED_BYTES || d->fork_generation != forks) {
+    randombytes_system(&in[DRBG_KEY_BYTES], DRBG_KEY_BYTES);
+    inlen += DRBG_KEY_BYTES;
+    d->since_reseed = 0;
+    d->fork_generation = forks;
+    d->seeded = 1;
+  }
+#endif
+  shake256(out, sizeof(out), in, inlen);
+  memcpy(d->key, out, DRBG_KEY_BYTES);
+  memcpy(d->buffer, &out[DRBG_KEY_BYTES], DRBG_BUFFER_BYTES);
+  d->available = DRBG_BUFFER_BYTES;
+  d->since_reseed += DRBG_BUFFER_BYTES;
+  erase(in, sizeof(in));
+  erase(out, sizeof(out));
+}
+
+
+void randombytes(unsigned char* random_array, unsigned int nbytes)
+{ // Generation of "nbytes" of random values from the calling thread's DRBG
+  drbg_t *d = &drbg;
+  unsigned char *p;
+  unsigned int n;
+
+  if (d->fork_generation != atomic_load_explicit(&drbg_forks, memory_order_relaxed))
+    d->available = 0;   // Do not hand out bytes buffered before a fork
+
+  while (nbytes > 0) {
+    if (d->available == 0)
+      drbg_refill(d);
+    n = (nbytes < d->available) ? nbytes : d->available;
+    p = &d->buffer[DRBG_BUFFER_BYTES-d->available];
+    memcpy(random_array, p, n);
+    memset(p, 0, n);
+    d->available -= n;
+    random_array += n;
+    nbytes -= n;
+  }
+}
+
+#ifdef REPLAY
+
+void randombytes_replay(const unsigned char* seed, unsigned int seedlen)
+{ // Replaces the replay seed and restarts the calling thread at stream 0; threads without a stream take 1, 2, ...
+  pthread_once(&drbg_once, drbg_init);
+  replay_set_seed(seed, seedlen);
+  atomic_store(&replay_next_stream, 1);
+  randombytes_replay_stream(0);
+}
+
+
+void randombytes_replay_stream(unsigned int stream)
+{ // Restarts the calling thread's DRBG at the beginning of "stream"
+  drbg_t *d = &drbg;
+
+  pthread_once(&drbg_once, drbg_init);
+  if (!d->seeded)
+    pthread_setspecific(drbg_key, d);
+  drbg_replay_key(d, stream);
+}
+
+#endif
+
+
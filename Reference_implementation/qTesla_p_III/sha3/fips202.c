@@ -41,6 +41,14 @@ static void store64(uint8_t *x, uint64_t u)
 }
 
 
+#if defined(_OPT_KECCAK_)
+
+/* Use the optimized implementation in keccak/KeccakP-1600-opt64.c */
+extern void KeccakP1600_Permute_24rounds(uint64_t *state);
+#define KeccakF1600_StatePermute KeccakP1600_Permute_24rounds
+
+#else
+
 static const uint64_t KeccakF_RoundConstants[NROUNDS] = 
 {
     (uint64_t)0x0000000000000001ULL,
@@ -337,6 +345,8 @@ void KeccakF1600_StatePermute(uint64_t * state)
         #undef    round
 }
 
+#endif
+
 #include <string.h>
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 
@@ -384,6 +394,50 @@ static void keccak_squeezeblocks(unsigned char *h, unsigned long long int nblock
 }
 
 
+static void keccak_inc_init(uint64_t *s_inc)
+{
+  unsigned int i;
+
+  for (i = 0; i < 26; i++)
+    s_inc[i] = 0;
+}
+
+
+static void keccak_inc_absorb(uint64_t *s_inc, unsigned int r, const unsigned char *m, unsigned long long int mlen)
+{ // s_inc[0..24] is the state and s_inc[25] the number of bytes absorbed into the current block
+  unsigned long long i;
+
+  while (mlen > 0) 
+  {
+    if (s_inc[25] == 0 && mlen >= r) 
+    {
+      for (i = 0; i < r / 8; ++i)
+        s_inc[i] ^= load64(m + 8 * i);
+      KeccakF1600_StatePermute(s_inc);
+      mlen -= r;
+      m += r;
+      continue;
+    }
+    s_inc[s_inc[25] >> 3] ^= (uint64_t)*m << (8 * (s_inc[25] & 7));
+    m++;
+    mlen--;
+    if (++s_inc[25] == r) 
+    {
+      KeccakF1600_StatePermute(s_inc);
+      s_inc[25] = 0;
+    }
+  }
+}
+
+
+static void keccak_inc_finalize(uint64_t *s_inc, unsigned int r, unsigned char p)
+{ // Same padding as keccak_absorb
+  s_inc[s_inc[25] >> 3] ^= (uint64_t)p << (8 * (s_inc[25] & 7));
+  s_inc[(r - 1) >> 3] ^= (uint64_t)128 << (8 * ((r - 1) & 7));
+  s_inc[25] = 0;
+}
+
+
 /********** SHAKE128 ***********/
 
 void shake128_absorb(uint64_t *s, const unsigned char *input, unsigned int inputByteLen)
@@ -398,6 +452,24 @@ void shake128_squeezeblocks(unsigned char *output, unsigned long long nblocks, u
 }
 
 
+void shake128_inc_init(uint64_t *s_inc)
+{
+	keccak_inc_init(s_inc);
+}
+
+
+void shake128_inc_absorb(uint64_t *s_inc, const unsigned char *input, unsigned long long inlen)
+{
+	keccak_inc_absorb(s_inc, SHAKE128_RATE, input, inlen);
+}
+
+
+void shake128_inc_finalize(uint64_t *s_inc)
+{
+	keccak_inc_finalize(s_inc, SHAKE128_RATE, 0x1F);
+}
+
+
 void shake128(unsigned char *output, unsigned long long outlen, const unsigned char *input,  unsigned long long inlen)
 {
   uint64_t s[25] = {0};
@@ -491,6 +563,24 @@ void shake256_squeezeblocks(unsigned char *output, unsigned long long nblocks, u
 }
 
 
+void shake256_inc_init(uint64_t *s_inc)
+{
+	keccak_inc_init(s_inc);
+}
+
+
+void shake256_inc_absorb(uint64_t *s_inc, const unsigned char *input, unsigned long long inlen)
+{
+	keccak_inc_absorb(s_inc, SHAKE256_RATE, input, inlen);
+}
+
+
+void shake256_inc_finalize(uint64_t *s_inc)
+{
+	keccak_inc_finalize(s_inc, SHAKE256_RATE, 0x1F);
+}
+
+
 void shake256(unsigned char *output, unsigned long long outlen, const unsigned char *input,  unsigned long long inlen)
 {
   uint64_t s[25];
@@ -552,6 +642,30 @@ void cshake256_simple_squeezeblocks(unsigned char *output, unsigned long long nb
 }
 
 
+void cshake256_inc_init(uint64_t *s_inc, uint16_t cstm)
+{ // Absorbs the same customization block as cshake256_simple_absorb
+  unsigned char *sep = (unsigned char*)s_inc;
+
+  keccak_inc_init(s_inc);
+  sep[0] = 0x01;
+  sep[1] = 0x88;
+  sep[2] = 0x01;
+  sep[3] = 0x00;
+  sep[4] = 0x01;
+  sep[5] = 16; // fixed bitlen of cstm
+  sep[6] = cstm & 0xff;
+  sep[7] = cstm >> 8;
+
+  KeccakF1600_StatePermute(s_inc);
+}
+
+
+void cshake256_inc_finalize(uint64_t *s_inc)
+{
+  keccak_inc_finalize(s_inc, SHAKE256_RATE, 0x04);
+}
+
+
 void cshake256_simple(unsigned char *output, unsigned long long outlen, uint16_t cstm, const unsigned char *in, unsigned long long inlen)
 {
   uint64_t s[25];
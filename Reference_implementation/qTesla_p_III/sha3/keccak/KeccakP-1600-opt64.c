@@ -0,0 +1,290 @@
+/********************************************************************************************
+* Optimized 64-bit Keccak-p[1600,24] permutation
+*
+* Based on the public domain "opt64" implementation from the eXtended Keccak Code Package
+* (https://github.com/XKCP/XKCP) by the Keccak, Keyak and Ketje Teams.
+*
+* Rounds are unrolled KeccakP1600_unrolling (2, 6 or 24) at a time, and the theta column
+* parities are accumulated while computing chi, so each round reads every lane only once.
+* On targets with an and-not instruction (BMI1 "andn" on x64, "bic" on ARM64) chi is
+* computed directly. Otherwise the "bebigokimisa" lane complementing transform is used,
+* which cuts the NOT operations in chi from 25 to 5 per round.
+* With -mbmi2 the rotations compile to "rorx".
+*********************************************************************************************/
+
+#include <stdint.h>
+
+#if defined(__BMI__) || defined(__aarch64__)
+    #define KeccakP1600_useAndNot
+#else
+    #define KeccakP1600_useLaneComplementing
+#endif
+
+#if defined(__GNUC__) && !defined(__clang__) && (defined(__x86_64__) || defined(__i386__))
+    // Some -mtune targets (e.g., znver3) spill general-purpose registers to vector registers,
+    // which slows this register-bound code down by about a third
+    #define KeccakP1600_tuning __attribute__((target("tune=generic")))
+#else
+    #define KeccakP1600_tuning
+#endif
+
+#define ROL64(a, offset) (((a) << (offset)) ^ ((a) >> (64-(offset))))
+
+
+static const uint64_t KeccakP1600_RoundConstants[24] =
+{
+    0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL, 0x8000000080008000ULL,
+    0x000000000000808bULL, 0x0000000080000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
+    0x000000000000008aULL, 0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
+    0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL, 0x8000000000008003ULL,
+    0x8000000000008002ULL, 0x8000000000000080ULL, 0x000000000000800aULL, 0x800000008000000aULL,
+    0x8000000080008081ULL, 0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL
+};
+
+
+#define declareABCDE \
+    uint64_t Aba, Abe, Abi, Abo, Abu; \
+    uint64_t Aga, Age, Agi, Ago, Agu; \
+    uint64_t Aka, Ake, Aki, Ako, Aku; \
+    uint64_t Ama, Ame, Ami, Amo, Amu; \
+    uint64_t Asa, Ase, Asi, Aso, Asu; \
+    uint64_t Bba, Bbe, Bbi, Bbo, Bbu; \
+    uint64_t Ca, Ce, Ci, Co, Cu; \
+    uint64_t Da, De, Di, Do, Du; \
+    uint64_t Eba, Ebe, Ebi, Ebo, Ebu; \
+    uint64_t Ega, Ege, Egi, Ego, Egu; \
+    uint64_t Eka, Eke, Eki, Eko, Eku; \
+    uint64_t Ema, Eme, Emi, Emo, Emu; \
+    uint64_t Esa, Ese, Esi, Eso, Esu;
+
+#define prepareTheta \
+    Ca = Aba^Aga^Aka^Ama^Asa; \
+    Ce = Abe^Age^Ake^Ame^Ase; \
+    Ci = Abi^Agi^Aki^Ami^Asi; \
+    Co = Abo^Ago^Ako^Amo^Aso; \
+    Cu = Abu^Agu^Aku^Amu^Asu;
+
+#ifdef KeccakP1600_useAndNot
+
+#define ANDNOT64(a, b) ((~(a)) & (b))
+
+// Chi on each plane: E[x] = B[x] ^ (~B[x+1] & B[x+2])
+#define chi_b(E) \
+    E##ba = Bba ^ ANDNOT64(Bbe, Bbi); Ca = E##ba; \
+    E##be = Bbe ^ ANDNOT64(Bbi, Bbo); Ce = E##be; \
+    E##bi = Bbi ^ ANDNOT64(Bbo, Bbu); Ci = E##bi; \
+    E##bo = Bbo ^ ANDNOT64(Bbu, Bba); Co = E##bo; \
+    E##bu = Bbu ^ ANDNOT64(Bba, Bbe); Cu = E##bu;
+
+#define chi_plane(E, y) \
+    E##y##a = Bba ^ ANDNOT64(Bbe, Bbi); Ca ^= E##y##a; \
+    E##y##e = Bbe ^ ANDNOT64(Bbi, Bbo); Ce ^= E##y##e; \
+    E##y##i = Bbi ^ ANDNOT64(Bbo, Bbu); Ci ^= E##y##i; \
+    E##y##o = Bbo ^ ANDNOT64(Bbu, Bba); Co ^= E##y##o; \
+    E##y##u = Bbu ^ ANDNOT64(Bba, Bbe); Cu ^= E##y##u;
+
+#define chi_g(E)   chi_plane(E, g)
+#define chi_k(E)   chi_plane(E, k)
+#define chi_m(E)   chi_plane(E, m)
+#define chi_s(E)   chi_plane(E, s)
+
+#else
+
+// Chi on each plane with lanes be, bi, go, ki, mi and sa kept in complemented form
+#define chi_b(E) \
+    E##ba =   Bba ^(  Bbe |  Bbi ); Ca = E##ba; \
+    E##be =   Bbe ^((~Bbi)|  Bbo ); Ce = E##be; \
+    E##bi =   Bbi ^(  Bbo &  Bbu ); Ci = E##bi; \
+    E##bo =   Bbo ^(  Bbu |  Bba ); Co = E##bo; \
+    E##bu =   Bbu ^(  Bba &  Bbe ); Cu = E##bu;
+
+#define chi_g(E) \
+    E##ga =   Bba ^(  Bbe |  Bbi ); Ca ^= E##ga; \
+    E##ge =   Bbe ^(  Bbi &  Bbo ); Ce ^= E##ge; \
+    E##gi =   Bbi ^(  Bbo |(~Bbu)); Ci ^= E##gi; \
+    E##go =   Bbo ^(  Bbu |  Bba ); Co ^= E##go; \
+    E##gu =   Bbu ^(  Bba &  Bbe ); Cu ^= E##gu;
+
+#define chi_k(E) \
+    E##ka =   Bba ^(  Bbe |  Bbi ); Ca ^= E##ka; \
+    E##ke =   Bbe ^(  Bbi &  Bbo ); Ce ^= E##ke; \
+    E##ki =   Bbi ^((~Bbo)&  Bbu ); Ci ^= E##ki; \
+    E##ko = (~Bbo)^(  Bbu |  Bba ); Co ^= E##ko; \
+    E##ku =   Bbu ^(  Bba &  Bbe ); Cu ^= E##ku;
+
+#define chi_m(E) \
+    E##ma =   Bba ^(  Bbe &  Bbi ); Ca ^= E##ma; \
+    E##me =   Bbe ^(  Bbi |  Bbo ); Ce ^= E##me; \
+    E##mi =   Bbi ^((~Bbo)|  Bbu ); Ci ^= E##mi; \
+    E##mo = (~Bbo)^(  Bbu &  Bba ); Co ^= E##mo; \
+    E##mu =   Bbu ^(  Bba |  Bbe ); Cu ^= E##mu;
+
+#define chi_s(E) \
+    E##sa =   Bba ^((~Bbe)&  Bbi ); Ca ^= E##sa; \
+    E##se = (~Bbe)^(  Bbi |  Bbo ); Ce ^= E##se; \
+    E##si =   Bbi ^(  Bbo &  Bbu ); Ci ^= E##si; \
+    E##so =   Bbo ^(  Bbu |  Bba ); Co ^= E##so; \
+    E##su =   Bbu ^(  Bba &  Bbe ); Cu ^= E##su;
+
+#endif
+
+// Round i reading state A and writing state E. The parities C of A must be ready on entry and
+// the parities of E are ready on exit
+#define thetaRhoPiChiIotaPrepareTheta(i, A, E) \
+    Da = Cu^ROL64(Ce, 1); \
+    De = Ca^ROL64(Ci, 1); \
+    Di = Ce^ROL64(Co, 1); \
+    Do = Ci^ROL64(Cu, 1); \
+    Du = Co^ROL64(Ca, 1); \
+    \
+    A##ba ^= Da; \
+    Bba = A##ba; \
+    A##ge ^= De; \
+    Bbe = ROL64(A##ge, 44); \
+    A##ki ^= Di; \
+    Bbi = ROL64(A##ki, 43); \
+    A##mo ^= Do; \
+    Bbo = ROL64(A##mo, 21); \
+    A##su ^= Du; \
+    Bbu = ROL64(A##su, 14); \
+    chi_b(E) \
+    E##ba ^= KeccakP1600_RoundConstants[i]; \
+    Ca ^= KeccakP1600_RoundConstants[i]; \
+    \
+    A##bo ^= Do; \
+    Bba = ROL64(A##bo, 28); \
+    A##gu ^= Du; \
+    Bbe = ROL64(A##gu, 20); \
+    A##ka ^= Da; \
+    Bbi = ROL64(A##ka,  3); \
+    A##me ^= De; \
+    Bbo = ROL64(A##me, 45); \
+    A##si ^= Di; \
+    Bbu = ROL64(A##si, 61); \
+    chi_g(E) \
+    \
+    A##be ^= De; \
+    Bba = ROL64(A##be,  1); \
+    A##gi ^= Di; \
+    Bbe = ROL64(A##gi,  6); \
+    A##ko ^= Do; \
+    Bbi = ROL64(A##ko, 25); \
+    A##mu ^= Du; \
+    Bbo = ROL64(A##mu,  8); \
+    A##sa ^= Da; \
+    Bbu = ROL64(A##sa, 18); \
+    chi_k(E) \
+    \
+    A##bu ^= Du; \
+    Bba = ROL64(A##bu, 27); \
+    A##ga ^= Da; \
+    Bbe = ROL64(A##ga, 36); \
+    A##ke ^= De; \
+    Bbi = ROL64(A##ke, 10); \
+    A##mi ^= Di; \
+    Bbo = ROL64(A##mi, 15); \
+    A##so ^= Do; \
+    Bbu = ROL64(A##so, 56); \
+    chi_m(E) \
+    \
+    A##bi ^= Di; \
+    Bba = ROL64(A##bi, 62); \
+    A##go ^= Do; \
+    Bbe = ROL64(A##go, 55); \
+    A##ku ^= Du; \
+    Bbi = ROL64(A##ku, 39); \
+    A##ma ^= Da; \
+    Bbo = ROL64(A##ma, 41); \
+    A##se ^= De; \
+    Bbu = ROL64(A##se,  2); \
+    chi_s(E)
+
+#ifndef KeccakP1600_unrolling
+#define KeccakP1600_unrolling 6
+#endif
+
+#if (KeccakP1600_unrolling == 24)
+#define rounds24 \
+    prepareTheta \
+    for (i = 0; i < 24; i += 24) { \
+        thetaRhoPiChiIotaPrepareTheta(i+ 0, A, E) \
+        thetaRhoPiChiIotaPrepareTheta(i+ 1, E, A) \
+        thetaRhoPiChiIotaPrepareTheta(i+ 2, A, E) \
+        thetaRhoPiChiIotaPrepareTheta(i+ 3, E, A) \
+        thetaRhoPiChiIotaPrepareTheta(i+ 4, A, E) \
+        thetaRhoPiChiIotaPrepareTheta(i+ 5, E, A) \
+        thetaRhoPiChiIotaPrepareTheta(i+ 6, A, E) \
+        thetaRhoPiChiIotaPrepareTheta(i+ 7, E, A) \
+        thetaRhoPiChiIotaPrepareTheta(i+ 8, A, E) \
+        thetaRhoPiChiIotaPrepareTheta(i+ 9, E, A) \
+        thetaRhoPiChiIotaPrepareTheta(i+10, A, E) \
+        thetaRhoPiChiIotaPrepareTheta(i+11, E, A) \
+        thetaRhoPiChiIotaPrepareTheta(i+12, A, E) \
+        thetaRhoPiChiIotaPrepareTheta(i+13, E, A) \
+        thetaRhoPiChiIotaPrepareTheta(i+14, A, E) \
+        thetaRhoPiChiIotaPrepareTheta(i+15, E, A) \
+        thetaRhoPiChiIotaPrepareTheta(i+16, A, E) \
+        thetaRhoPiChiIotaPrepareTheta(i+17, E, A) \
+        thetaRhoPiChiIotaPrepareTheta(i+18, A, E) \
+        thetaRhoPiChiIotaPrepareTheta(i+19, E, A) \
+        thetaRhoPiChiIotaPrepareTheta(i+20, A, E) \
+        thetaRhoPiChiIotaPrepareTheta(i+21, E, A) \
+        thetaRhoPiChiIotaPrepareTheta(i+22, A, E) \
+        thetaRhoPiChiIotaPrepareTheta(i+23, E, A) \
+    }
+#elif (KeccakP1600_unrolling == 6)
+#define rounds24 \
+    prepareTheta \
+    for (i = 0; i < 24; i += 6) { \
+        thetaRhoPiChiIotaPrepareTheta(i+0, A, E) \
+        thetaRhoPiChiIotaPrepareTheta(i+1, E, A) \
+        thetaRhoPiChiIotaPrepareTheta(i+2, A, E) \
+        thetaRhoPiChiIotaPrepareTheta(i+3, E, A) \
+        thetaRhoPiChiIotaPrepareTheta(i+4, A, E) \
+        thetaRhoPiChiIotaPrepareTheta(i+5, E, A) \
+    }
+#elif (KeccakP1600_unrolling == 2)
+#define rounds24 \
+    prepareTheta \
+    for (i = 0; i < 24; i += 2) { \
+        thetaRhoPiChiIotaPrepareTheta(i  , A, E) \
+        thetaRhoPiChiIotaPrepareTheta(i+1, E, A) \
+    }
+#else
+#error "Unsupported KeccakP1600_unrolling"
+#endif
+
+#define copyFromState(X, state) \
+    X##ba = state[ 0]; X##be = state[ 1]; X##bi = state[ 2]; X##bo = state[ 3]; X##bu = state[ 4]; \
+    X##ga = state[ 5]; X##ge = state[ 6]; X##gi = state[ 7]; X##go = state[ 8]; X##gu = state[ 9]; \
+    X##ka = state[10]; X##ke = state[11]; X##ki = state[12]; X##ko = state[13]; X##ku = state[14]; \
+    X##ma = state[15]; X##me = state[16]; X##mi = state[17]; X##mo = state[18]; X##mu = state[19]; \
+    X##sa = state[20]; X##se = state[21]; X##si = state[22]; X##so = state[23]; X##su = state[24];
+
+#define copyToState(state, X) \
+    state[ 0] = X##ba; state[ 1] = X##be; state[ 2] = X##bi; state[ 3] = X##bo; state[ 4] = X##bu; \
+    state[ 5] = X##ga; state[ 6] = X##ge; state[ 7] = X##gi; state[ 8] = X##go; state[ 9] = X##gu; \
+    state[10] = X##ka; state[11] = X##ke; state[12] = X##ki; state[13] = X##ko; state[14] = X##ku; \
+    state[15] = X##ma; state[16] = X##me; state[17] = X##mi; state[18] = X##mo; state[19] = X##mu; \
+    state[20] = X##sa; state[21] = X##se; state[22] = X##si; state[23] = X##so; state[24] = X##su;
+
+#ifdef KeccakP1600_useLaneComplementing
+#define complementLanes(X) \
+    X##be = ~X##be; X##bi = ~X##bi; X##go = ~X##go; \
+    X##ki = ~X##ki; X##mi = ~X##mi; X##sa = ~X##sa;
+#else
+#define complementLanes(X)
+#endif
+
+
+KeccakP1600_tuning void KeccakP1600_Permute_24rounds(uint64_t *state)
+{ // Keccak-f[1600] on a state in the standard (non-complemented) lane representation
+    declareABCDE
+    unsigned int i;
+
+    copyFromState(A, state)
+    complementLanes(A)
+    rounds24
+    complementLanes(A)
+    copyToState(state, A)
+}
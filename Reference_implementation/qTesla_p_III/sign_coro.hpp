@@ -0,0 +1,129 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: C++20 coroutine wrapper of the step-wise signing API in sign_step.h.
+*           qtesla::sign() yields to a scheduler after every few rejection iterations,
+*           so many signatures can be interleaved fairly on one thread
+**************************************************************************************/
+
+#ifndef __SIGN_CORO_HPP
+#define __SIGN_CORO_HPP
+
+#include <atomic>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <stdlib.h>
+
+extern "C" {
+#include "api.h"
+#include "sign_step.h"
+}
+
+namespace qtesla {
+
+// Lazily started coroutine that returns a T. It runs when awaited, or when its handle() is resumed
+template <class T>
+class task {
+public:
+  struct promise_type {
+    T value{};
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+
+    task get_return_object() { return task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    struct final_awaiter {   // Resumes the awaiting coroutine, if any
+      bool await_ready() noexcept { return false; }
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept { return h.promise().continuation; }
+      void await_resume() noexcept {}
+    };
+    final_awaiter final_suspend() noexcept { return {}; }
+    void return_value(T v) { value = v; }
+    void unhandled_exception() { std::terminate(); }
+  };
+
+  task(task &&t) noexcept : h(t.h) { t.h = nullptr; }
+  task(const task &) = delete;
+  task &operator=(const task &) = delete;
+  ~task() { if (h) h.destroy(); }
+
+  std::coroutine_handle<> handle() const { return h; }
+  bool done() const { return h.done(); }
+  T result() const { return h.promise().value; }
+
+  bool await_ready() const noexcept { return false; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> c) noexcept { h.promise().continuation = c; return h; }
+  T await_resume() const { return h.promise().value; }
+
+private:
+  explicit task(std::coroutine_handle<promise_type> p) : h(p) {}
+  std::coroutine_handle<promise_type> h;
+};
+
+
+// Scheduler that resumes the posted coroutines in FIFO order on the thread calling run().
+// Any type with a post(std::coroutine_handle<>) member, such as an event loop adapter, can replace it
+class round_robin {
+public:
+  void post(std::coroutine_handle<> h) { ready.push_back(h); }
+  template <class T> void spawn(task<T> &t) { post(t.handle()); }
+  void run()
+  {
+    while (!ready.empty()) {
+      std::coroutine_handle<> h = ready.front();
+      ready.pop_front();
+      h.resume();
+    }
+  }
+
+private:
+  std::deque<std::coroutine_handle<>> ready;
+};
+
+
+// Number of workspaces held by sign() tasks that have neither completed nor been destroyed
+inline std::atomic<unsigned long> workspaces_in_use{0};
+
+struct workspace_deleter {   // Wipes a signing workspace before it is freed
+  void operator()(void *p) const
+  {
+    qtesla_clear(p, CRYPTO_WORKSPACEBYTES);
+    free(p);
+    workspaces_in_use--;
+  }
+};
+
+
+template <class Scheduler>
+struct yield {   // Suspends the awaiting coroutine and posts it back to the scheduler
+  Scheduler &sched;
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> h) { sched.post(h); }
+  void await_resume() const noexcept {}
+};
+
+
+// Signs m with sk as crypto_sign() does, yielding to "sched" after every "iterations" rejection iterations.
+// m, sk, sm and smlen must stay valid until the task completes. Returns 0, or -1 if no workspace could be allocated.
+// The workspace belongs to the coroutine frame, so destroying a suspended task wipes and frees it
+template <class Scheduler>
+task<int> sign(Scheduler &sched, unsigned char *sm, unsigned long long *smlen, const unsigned char *m, unsigned long long mlen,
+               const unsigned char *sk, unsigned int iterations = 1)
+{
+  qtesla_sign_t st;
+  void *p;
+
+  if (posix_memalign(&p, CRYPTO_WORKSPACEALIGN, CRYPTO_WORKSPACEBYTES) != 0)
+    co_return -1;
+  workspaces_in_use++;
+  std::unique_ptr<void, workspace_deleter> ws(p);
+  qtesla_sign_begin(&st, m, mlen, sk, ws.get());
+  while (qtesla_sign_step(&st, iterations) == QTESLA_SIGN_AGAIN)
+    co_await yield<Scheduler>{sched};
+  co_return qtesla_sign_finish(&st, sm, smlen);
+}
+
+}
+
+#endif
@@ -0,0 +1,72 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: step-wise signing, for callers that must not block for a whole signature
+**************************************************************************************/
+
+#ifndef __SIGN_STEP_H
+#define __SIGN_STEP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "api.h"
+
+#define QTESLA_SIGN_AGAIN 1   // Returned by qtesla_sign_step() when the signature is not ready yet
+
+// sample_y() separates the cSHAKE calls of nonce n with the 16-bit value n<<8, which repeats after 256 nonces.
+// A signature that reaches this nonce draws fresh randomness for y and starts again from nonce 1
+#define QTESLA_SIGN_NONCE_LIMIT 255
+
+typedef struct {   // Signing state owned by the caller; it holds no pointers into itself and can be moved between steps
+  const unsigned char *m, *sk;
+  const int32_t *a;   // Polynomials a_k of sk, in the workspace unless they were given expanded
+  unsigned long long mlen;
+  void *ws;
+  unsigned char c[CRYPTO_C_BYTES];
+  unsigned char randomness[CRYPTO_SEEDBYTES];
+  unsigned char randomness_input[CRYPTO_RANDOMBYTES+CRYPTO_SEEDBYTES+2*HM_BYTES];
+  int nonce;      // Rejection iterations run since y was last seeded
+  int restarts;   // Times y was reseeded at QTESLA_SIGN_NONCE_LIMIT
+  int rejected_z, rejected_w;   // Iterations rejected by the test on z and by the correctness test on w
+  int done;
+} qtesla_sign_t;
+
+// Starts a signature of m with sk. The polynomials of the signature live in "ws", a workspace of
+// CRYPTO_WORKSPACEBYTES bytes aligned to CRYPTO_WORKSPACEALIGN; m, sk and ws must stay valid until qtesla_sign_finish()
+void qtesla_sign_begin(qtesla_sign_t *st, const unsigned char *m, unsigned long long mlen, const unsigned char *sk, void *ws);
+
+// Same as qtesla_sign_begin for the message whose hash H(m) of HM_BYTES bytes is hm, e.g. a prehash (see prehash.h).
+// qtesla_sign_finish() then outputs the signature alone, of CRYPTO_BYTES bytes
+void qtesla_sign_begin_hm(qtesla_sign_t *st, const unsigned char *hm, const unsigned char *sk, void *ws);
+
+// Verifies a signature output after qtesla_sign_begin_hm(). Returns 0 if valid, otherwise a negative value
+int qtesla_verify_hm(const unsigned char *sig, unsigned long long siglen, const unsigned char *hm, const unsigned char *pk, void *ws);
+
+// Same as qtesla_sign_begin with the PARAM_K*PARAM_N coefficients of the polynomials a_k of sk already expanded, e.g.
+// in a key store (see keystore.h). a is aligned to CRYPTO_WORKSPACEALIGN and must stay valid until qtesla_sign_finish()
+void qtesla_sign_begin_a(qtesla_sign_t *st, const unsigned char *m, unsigned long long mlen, const unsigned char *sk, const int32_t *a, void *ws);
+
+// Runs up to "iterations" rejection iterations (0 for no limit). Returns 0 once the signature is ready, 
+// or QTESLA_SIGN_AGAIN if every iteration was rejected
+int qtesla_sign_step(qtesla_sign_t *st, unsigned int iterations);
+
+// Same as qtesla_sign_step, but also returns QTESLA_SIGN_AGAIN once CLOCK_MONOTONIC reaches "deadline_ns" (0 for no 
+// deadline). The deadline is checked before each iteration, so a call overruns it by at most one iteration
+int qtesla_sign_step_deadline(qtesla_sign_t *st, unsigned int iterations, uint64_t deadline_ns);
+
+// Outputs the signed message sm as crypto_sign() does. Returns 0, or -1 if the signature is not ready
+int qtesla_sign_finish(qtesla_sign_t *st, unsigned char *sm, unsigned long long *smlen);
+
+// Signs m within a budget of "iterations" rejection iterations (0 for no limit) and a deadline (0 for none). Returns 0 
+// with the signed message in sm, or QTESLA_SIGN_AGAIN with the signature kept in st and ws, to be resumed with
+// qtesla_sign_step_deadline() and output with qtesla_sign_finish(), or dropped
+int qtesla_sign_bounded(unsigned char *sm, unsigned long long *smlen, const unsigned char *m, unsigned long long mlen, 
+                        const unsigned char *sk, qtesla_sign_t *st, void *ws, unsigned int iterations, uint64_t deadline_ns);
+
+// Current CLOCK_MONOTONIC time in nanoseconds, to build deadlines and time the pools and caches
+uint64_t qtesla_time_ns(void);
+
+// Erases n bytes of memory holding secrets, with stores the compiler cannot drop even if the memory is not read again
+void qtesla_clear(void *mem, size_t n);
+
+#endif
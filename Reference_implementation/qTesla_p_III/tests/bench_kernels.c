@@ -0,0 +1,400 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: cycles of every hot kernel of key generation, signing and verification,
+*           with percentiles, hot- or cold-cache runs, JSON output and comparison
+*           against a stored baseline
+*
+* Usage: bench_kernels [-n nruns] [-cold] [-nocounters] [-json file] [-baseline file] [-threshold percent]
+*        Next to the cycles, the hardware counters (see perf_counters.h) give the IPC, the 
+*        cache and branch misses per call and the ratio of core cycles to cpucycles(), 
+*        which departs from its usual value when turbo or throttling changes the clock.
+*        -json writes the results ("-" for stdout), to be used later as a baseline.
+*        -baseline compares the medians with those of a previous run and returns 1 if
+*        any kernel is slower by more than the threshold (default 10 percent)
+**************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../random/random.h"
+#include "../api.h"
+#include "../params.h"
+#include "../poly.h"
+#include "../pack.h"
+#include "../sample.h"
+#include "../gauss.h"
+#include "../sha3/fips202.h"
+#include "cpucycles.h"
+#include "perf_counters.h"
+#if (TARGET == TARGET_AMD64 || TARGET == TARGET_x86)
+  #include <emmintrin.h>
+#endif
+
+#if (TARGET == TARGET_ARM || TARGET == TARGET_ARM64)
+  #define UNIT "nsec"
+#else
+  #define UNIT "cycles"
+#endif
+
+#define IMPLEMENTATION "ref"
+#define MLEN 59
+#define NRUNS 1000
+#define THRESHOLD 10.0
+#define CACHE_LINE 64
+#define EVICT_BYTES (32 << 20)   // Swept to evict the caches where clflush is not available
+#define MAX_KERNELS 64
+
+extern poly zeta, zetainv;
+
+typedef struct {   // Inputs, outputs and scratch of the kernels; cold-cache runs flush all of it before each run
+  poly_k a, e, t, v;
+  poly s, y, y_ntt, z, w;
+  unsigned char seed[CRYPTO_RANDOMBYTES], seeds[(PARAM_K+3)*CRYPTO_SEEDBYTES];
+  unsigned char m[MLEN], hm[2*HM_BYTES], c[CRYPTO_C_BYTES];
+  unsigned char pk[CRYPTO_PUBLICKEYBYTES], sk[CRYPTO_SECRETKEYBYTES], sm[CRYPTO_BYTES+MLEN];
+  unsigned char uniform_buf[POLY_UNIFORM_BYTES], hash_buf[HASH_H_BYTES];
+  int32_t pk_t[PARAM_N*PARAM_K];
+  uint32_t pos_list[PARAM_H];
+  int16_t sign_list[PARAM_H];
+  int32_t *es[GAUSS_BATCH];
+  const unsigned char *es_seeds[GAUSS_BATCH];
+  unsigned int bounds[GAUSS_BATCH];
+  int nonce;
+} data_t;
+
+typedef struct {
+  const char *name;
+  void (*run)(data_t *);
+} kernel_t;
+
+typedef struct {
+  char name[64];
+  unsigned long long min, median, mean, p90, p99, max;
+  double counter[PERF_NCOUNTERS];   // Per call
+  int available[PERF_NCOUNTERS];
+  double clock_ratio;               // Core cycles per cpucycles() unit
+} result_t;
+
+
+static void k_shake128(data_t *d)        { shake128(d->seeds, (PARAM_K+3)*CRYPTO_SEEDBYTES, d->seed, CRYPTO_RANDOMBYTES); }
+static void k_shake256(data_t *d)        { shake256(d->seeds, (PARAM_K+3)*CRYPTO_SEEDBYTES, d->seed, CRYPTO_RANDOMBYTES); }
+static void k_shake_hm(data_t *d)        { SHAKE(d->hm, HM_BYTES, d->m, MLEN); }
+static void k_cshake128(data_t *d)       { cshake128_simple(d->uniform_buf, SHAKE128_RATE, (uint16_t)d->nonce++, d->seed, CRYPTO_RANDOMBYTES); }
+static void k_poly_uniform(data_t *d)    { poly_uniform(d->a, d->seed, d->uniform_buf); }
+static void k_sample_y(data_t *d)        { sample_y(d->y, d->seed, ++d->nonce); }
+static void k_sample_gauss(data_t *d)    { sample_gauss_poly(d->s, d->seed, ++d->nonce); }
+static void k_sample_gauss_batch(data_t *d) { d->nonce += GAUSS_BATCH; sample_gauss_poly_batch(d->es, d->es_seeds, d->nonce, GAUSS_BATCH, check_ES, d->bounds); }
+static void k_check_ES(data_t *d)        { check_ES(d->s, PARAM_KEYGEN_BOUND_S); }
+static void k_ntt(data_t *d)             { ntt(d->w, zeta); }
+static void k_nttinv(data_t *d)          { nttinv(d->w, zetainv); }
+static void k_poly_ntt(data_t *d)        { poly_ntt(d->y_ntt, d->y); }
+static void k_poly_mul(data_t *d)        { poly_mul(d->v, d->a, d->y_ntt); }
+static void k_poly_add(data_t *d)        { poly_add(d->z, d->y, d->w); }
+static void k_poly_add_correct(data_t *d){ poly_add_correct(d->t, d->v, d->e); }
+static void k_poly_sub(data_t *d)        { poly_sub(d->w, d->v, d->z); }
+static void k_poly_sub_reduce(data_t *d) { poly_sub_reduce(d->w, d->v, d->z); }
+static void k_sparse_mul8(data_t *d)     { sparse_mul8(d->w, &d->sk[PARAM_N], d->pos_list, d->sign_list); }
+static void k_sparse_mul32(data_t *d)    { sparse_mul32(d->w, d->pk_t, d->pos_list, d->sign_list); }
+static void k_hash_H(data_t *d)          { hash_H(d->c, d->v, d->hm, d->hash_buf); }
+static void k_encode_c(data_t *d)        { encode_c(d->pos_list, d->sign_list, d->c); }
+static void k_encode_sk(data_t *d)       { encode_sk(d->sk, d->s, d->e, &d->seeds[(PARAM_K+1)*CRYPTO_SEEDBYTES], d->hm); }
+static void k_encode_pk(data_t *d)       { encode_pk(d->pk, d->t, &d->seeds[(PARAM_K+1)*CRYPTO_SEEDBYTES]); }
+static void k_decode_pk(data_t *d)       { decode_pk(d->pk_t, d->seeds, d->pk); }
+static void k_encode_sig(data_t *d)      { encode_sig(d->sm, d->c, d->z); }
+static void k_decode_sig(data_t *d)      { decode_sig(d->c, d->z, d->sm); }
+
+static const kernel_t kernels[] = {
+  {"shake128", k_shake128}, {"shake256", k_shake256}, {"shake_hm", k_shake_hm}, {"cshake128_block", k_cshake128},
+  {"poly_uniform", k_poly_uniform}, {"sample_y", k_sample_y}, {"sample_gauss_poly", k_sample_gauss},
+  {"sample_gauss_batch", k_sample_gauss_batch}, {"check_ES", k_check_ES},
+  {"ntt", k_ntt}, {"nttinv", k_nttinv}, {"poly_ntt", k_poly_ntt}, {"poly_mul", k_poly_mul},
+  {"poly_add", k_poly_add}, {"poly_add_correct", k_poly_add_correct}, {"poly_sub", k_poly_sub}, {"poly_sub_reduce", k_poly_sub_reduce},
+  {"sparse_mul8", k_sparse_mul8}, {"sparse_mul32", k_sparse_mul32}, {"hash_H", k_hash_H}, {"encode_c", k_encode_c},
+  {"encode_sk", k_encode_sk}, {"encode_pk", k_encode_pk}, {"decode_pk", k_decode_pk}, {"encode_sig", k_encode_sig}, {"decode_sig", k_decode_sig},
+};
+
+#define NKERNELS (sizeof(kernels)/sizeof(kernels[0]))
+
+
+static int cmp_llu(const void *a, const void*b)
+{
+  if (*(unsigned long long *)a < *(unsigned long long *)b) return -1;
+  if (*(unsigned long long *)a > *(unsigned long long *)b) return 1;
+  return 0;
+}
+
+
+static void flush_data(const data_t *d, unsigned char *evict)
+{ // Evicts the kernel data from every cache level
+#if (TARGET == TARGET_AMD64 || TARGET == TARGET_x86)
+  (void)evict;
+  for (size_t i = 0; i < sizeof(data_t); i += CACHE_LINE)
+    _mm_clflush((const unsigned char *)d + i);
+  _mm_mfence();
+#else
+  (void)d;
+  for (size_t i = 0; i < EVICT_BYTES; i += CACHE_LINE)
+    evict[i]++;
+#endif
+}
+
+
+static void init_data(data_t *d)
+{ // Real keys, signature and challenge, so that every kernel sees the data it sees when signing
+  unsigned long long smlen;
+
+  randombytes(d->seed, CRYPTO_RANDOMBYTES);
+  randombytes(d->m, MLEN);
+  crypto_sign_keypair(d->pk, d->sk);
+  crypto_sign(d->sm, &smlen, d->m, MLEN, d->sk);
+  decode_sig(d->c, d->z, d->sm);
+  decode_pk(d->pk_t, d->seeds, d->pk);
+  encode_c(d->pos_list, d->sign_list, d->c);
+  shake128(d->seeds, (PARAM_K+3)*CRYPTO_SEEDBYTES, d->seed, CRYPTO_RANDOMBYTES);
+  SHAKE(d->hm, 2*HM_BYTES, d->m, MLEN);
+  poly_uniform(d->a, d->seed, d->uniform_buf);
+  for (int k = 0; k < PARAM_K; k++)
+    sample_gauss_poly(&d->e[k*PARAM_N], d->seed, k+1);
+  sample_gauss_poly(d->s, d->seed, PARAM_K+1);
+  for (int k = 0; k < GAUSS_BATCH; k++) {
+    d->es[k] = (k < PARAM_K) ? &d->e[k*PARAM_N] : d->s;
+    d->es_seeds[k] = &d->seeds[(k % (PARAM_K+1))*CRYPTO_SEEDBYTES];
+    d->bounds[k] = (k < PARAM_K) ? PARAM_KEYGEN_BOUND_E : PARAM_KEYGEN_BOUND_S;
+  }
+  sample_y(d->y, d->seed, 1);
+  poly_ntt(d->y_ntt, d->y);
+  for (int k = 0; k < PARAM_K; k++)
+    poly_mul(&d->v[k*PARAM_N], &d->a[k*PARAM_N], d->y_ntt);
+  memcpy(d->t, d->v, sizeof(poly_k));
+  memcpy(d->w, d->y_ntt, sizeof(poly));
+  d->nonce = PARAM_K+1;
+}
+
+
+static void run_kernel(const kernel_t *k, data_t *d, unsigned long long *cycles, unsigned int nruns, int cold, unsigned char *evict, 
+                       perf_counters_t *pc, result_t *r)
+{
+  unsigned long long t0, sum = 0;
+  uint64_t value[PERF_NCOUNTERS];
+  unsigned int i;
+
+  // The counters count the whole loop, except the flushes of cold-cache runs: the system calls that start and 
+  // stop them would otherwise disturb the predictors and caches seen by every hot-cache run
+  k->run(d);   // Warm up, and fault in the pages of the outputs
+  perf_counters_start(pc);
+  for (i = 0; i < nruns; i++) {
+    if (cold) {
+      perf_counters_stop(pc);
+      flush_data(d, evict);
+      perf_counters_start(pc);
+    }
+    t0 = cpucycles();
+    k->run(d);
+    cycles[i] = cpucycles() - t0;
+    sum += cycles[i];
+  }
+  perf_counters_stop(pc);
+  perf_counters_read(pc, value, r->available);
+  for (i = 0; i < PERF_NCOUNTERS; i++)
+    r->counter[i] = (double)value[i]/nruns;
+  r->clock_ratio = (sum != 0) ? (double)value[PERF_CYCLES]/(double)sum : 0;
+  qsort(cycles, nruns, sizeof(unsigned long long), cmp_llu);
+  snprintf(r->name, sizeof(r->name), "%s", k->name);
+  r->min = cycles[0];
+  r->median = cycles[nruns/2];
+  r->mean = sum/nruns;
+  r->p90 = cycles[(size_t)(0.90*(nruns-1))];
+  r->p99 = cycles[(size_t)(0.99*(nruns-1))];
+  r->max = cycles[nruns-1];
+}
+
+
+static int write_json(const char *file, const result_t *r, unsigned int n, unsigned int nruns, int cold)
+{
+  FILE *f = (strcmp(file, "-") == 0) ? stdout : fopen(file, "w");
+  unsigned int i;
+
+  if (f == NULL)
+    return -1;
+  fprintf(f, "{\n");
+  fprintf(f, "  \"scheme\": \"%s\",\n", CRYPTO_ALGNAME);
+  fprintf(f, "  \"implementation\": \"%s\",\n", IMPLEMENTATION);
+  fprintf(f, "  \"cache\": \"%s\",\n", cold ? "cold" : "hot");
+  fprintf(f, "  \"unit\": \"%s\",\n", UNIT);
+  fprintf(f, "  \"nruns\": %u,\n", nruns);
+  fprintf(f, "  \"kernels\": [\n");
+  for (i = 0; i < n; i++) {
+    fprintf(f, "    {\"name\": \"%s\", \"min\": %llu, \"median\": %llu, \"mean\": %llu, \"p90\": %llu, \"p99\": %llu, \"max\": %llu",
+            r[i].name, r[i].min, r[i].median, r[i].mean, r[i].p90, r[i].p99, r[i].max);
+    if (r[i].available[PERF_CYCLES] && r[i].available[PERF_INSTRUCTIONS])
+      fprintf(f, ", \"ipc\": %.3f", r[i].counter[PERF_INSTRUCTIONS]/r[i].counter[PERF_CYCLES]);
+    if (r[i].available[PERF_L1D_MISSES])
+      fprintf(f, ", \"l1d_misses\": %.2f", r[i].counter[PERF_L1D_MISSES]);
+    if (r[i].available[PERF_LLC_MISSES])
+      fprintf(f, ", \"llc_misses\": %.2f", r[i].counter[PERF_LLC_MISSES]);
+    if (r[i].available[PERF_BRANCH_MISSES])
+      fprintf(f, ", \"branch_misses\": %.2f", r[i].counter[PERF_BRANCH_MISSES]);
+    if (r[i].available[PERF_CYCLES])
+      fprintf(f, ", \"clock_ratio\": %.3f", r[i].clock_ratio);
+    fprintf(f, "}%s\n", (i+1 < n) ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+  if (f != stdout)
+    fclose(f);
+  return 0;
+}
+
+
+static void print_counter(const result_t *r, perf_counter_t i)
+{
+  if (r->available[i])
+    printf(" %9.1f", r->counter[i]);
+  else
+    printf(" %9s", "-");
+}
+
+
+static int compare_baseline(const char *file, const result_t *r, unsigned int n, int cold, double threshold)
+{ // Reads a file written by write_json and compares the medians. Returns the number of regressions, or -1
+  FILE *f = fopen(file, "r");
+  char line[512], name[64], field[64];
+  unsigned long long min, median;
+  result_t base[MAX_KERNELS];
+  unsigned int nbase = 0, i, j;
+  int regressions = 0;
+  double delta;
+
+  if (f == NULL)
+    return -1;
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (sscanf(line, " \"scheme\": \"%63[^\"]\"", field) == 1 && strcmp(field, CRYPTO_ALGNAME) != 0) {
+      printf("Baseline %s is for %s, not %s\n", file, field, CRYPTO_ALGNAME);
+      fclose(f);
+      return -1;
+    }
+    if (sscanf(line, " \"implementation\": \"%63[^\"]\"", field) == 1 && strcmp(field, IMPLEMENTATION) != 0) {
+      printf("Baseline %s is for the %s implementation, not %s\n", file, field, IMPLEMENTATION);
+      fclose(f);
+      return -1;
+    }
+    if (sscanf(line, " \"cache\": \"%63[^\"]\"", field) == 1 && strcmp(field, cold ? "cold" : "hot") != 0) {
+      printf("Baseline %s was measured with a %s cache\n", file, field);
+      fclose(f);
+      return -1;
+    }
+    if (nbase < MAX_KERNELS && sscanf(line, " {\"name\": \"%63[^\"]\", \"min\": %llu, \"median\": %llu", name, &min, &median) == 3) {
+      snprintf(base[nbase].name, sizeof(base[nbase].name), "%s", name);
+      base[nbase++].median = median;
+    }
+  }
+  fclose(f);
+
+  printf("\nkernel                   baseline     current     change\n");
+  for (i = 0; i < n; i++) {
+    for (j = 0; j < nbase && strcmp(base[j].name, r[i].name) != 0; j++);
+    if (j == nbase || base[j].median == 0) {
+      printf("%-20s %12s %11llu        new\n", r[i].name, "-", r[i].median);
+      continue;
+    }
+    delta = 100.0*((double)r[i].median - (double)base[j].median)/(double)base[j].median;
+    printf("%-20s %12llu %11llu   %+7.1f%%%s\n", r[i].name, base[j].median, r[i].median, delta, (delta > threshold) ? "   REGRESSION" : "");
+    regressions += (delta > threshold);
+  }
+  printf("\n%d of %u kernels slower than the baseline by more than %.1f%%\n", regressions, n, threshold);
+  return regressions;
+}
+
+
+int main(int argc, char **argv)
+{
+  const char *json = NULL, *baseline = NULL;
+  unsigned int nruns = NRUNS, i;
+  unsigned long long *cycles;
+  unsigned char *evict = NULL;
+  double threshold = THRESHOLD;
+  result_t results[NKERNELS];
+  perf_counters_t pc;
+  data_t *d;
+  int cold = 0, counters = 1, ncounters = 0, regressions = 0;
+
+  for (i = 1; i < (unsigned int)argc; i++) {
+    if (strcmp(argv[i], "-n") == 0 && i+1 < (unsigned int)argc)
+      nruns = (unsigned int)atoi(argv[++i]);
+    else if (strcmp(argv[i], "-cold") == 0)
+      cold = 1;
+    else if (strcmp(argv[i], "-nocounters") == 0)
+      counters = 0;
+    else if (strcmp(argv[i], "-json") == 0 && i+1 < (unsigned int)argc)
+      json = argv[++i];
+    else if (strcmp(argv[i], "-baseline") == 0 && i+1 < (unsigned int)argc)
+      baseline = argv[++i];
+    else if (strcmp(argv[i], "-threshold") == 0 && i+1 < (unsigned int)argc)
+      threshold = atof(argv[++i]);
+    else {
+      printf("Usage: %s [-n nruns] [-cold] [-nocounters] [-json file] [-baseline file] [-threshold percent]\n", argv[0]);
+      return -1;
+    }
+  }
+  if (nruns == 0)
+    return -1;
+
+  cycles = malloc(nruns*sizeof(unsigned long long));
+  if (posix_memalign((void **)&d, CACHE_LINE, sizeof(data_t)) != 0 || cycles == NULL)
+    return -1;
+#if !(TARGET == TARGET_AMD64 || TARGET == TARGET_x86)
+  if (cold && (evict = calloc(EVICT_BYTES, 1)) == NULL)
+    return -1;
+#endif
+  init_data(d);
+  memset(&pc, -1, sizeof(pc));   // All counters closed
+  if (counters)
+    ncounters = perf_counters_open(&pc);
+
+  for (i = 0; i < NKERNELS; i++)
+    run_kernel(&kernels[i], d, cycles, nruns, cold, evict, &pc, &results[i]);
+  perf_counters_close(&pc);
+
+  if (json == NULL || strcmp(json, "-") != 0) {
+    printf("\n");
+    printf("===========================================================================================\n");
+    printf("Kernels of %s (%s), %s cache, %u runs each, in ", CRYPTO_ALGNAME, IMPLEMENTATION, cold ? "cold" : "hot", nruns);
+    print_unit;
+    printf("\n===========================================================================================\n\n");
+    printf("kernel                      min     median       mean        p90        p99     IPC   L1D miss  LLC miss  br. miss  clock\n");
+    for (i = 0; i < NKERNELS; i++) {
+      printf("%-20s %10llu %10llu %10llu %10llu %10llu", results[i].name, results[i].min, results[i].median, results[i].mean, results[i].p90, results[i].p99);
+      if (results[i].available[PERF_CYCLES] && results[i].available[PERF_INSTRUCTIONS])
+        printf(" %7.2f", results[i].counter[PERF_INSTRUCTIONS]/results[i].counter[PERF_CYCLES]);
+      else
+        printf(" %7s", "-");
+      print_counter(&results[i], PERF_L1D_MISSES);
+      print_counter(&results[i], PERF_LLC_MISSES);
+      print_counter(&results[i], PERF_BRANCH_MISSES);
+      if (results[i].available[PERF_CYCLES])
+        printf(" %6.2f\n", results[i].clock_ratio);
+      else
+        printf(" %6s\n", "-");
+    }
+    if (counters && ncounters == 0)
+      printf("\nHardware counters unavailable: perf_event_open failed (see /proc/sys/kernel/perf_event_paranoid)\n");
+    else if (counters)
+      printf("\nMisses are per call; clock is core cycles per cpucycles() unit, so turbo or throttling shows as a change in it\n");
+  }
+  if (json != NULL && write_json(json, results, NKERNELS, nruns, cold) != 0) {
+    printf("Cannot write %s\n", json);
+    return -1;
+  }
+  if (baseline != NULL) {
+    regressions = compare_baseline(baseline, results, NKERNELS, cold, threshold);
+    if (regressions < 0) {
+      printf("Cannot compare with baseline %s\n", baseline);
+      return -1;
+    }
+  }
+
+  free(evict);
+  free(cycles);
+  free(d);
+  return (regressions > 0);
+}
@@ -0,0 +1,126 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: startup time and per-signature cost of a mapped store of expanded keys
+*           against expanding raw keys
+*
+* Usage: bench_keystore [nkeys] [path]
+*        Writes a store of "nkeys" key pairs (256 by default) to "path" (a file in /tmp 
+*        by default), then compares opening it with expanding every raw public key, and
+*        signing and verifying with stored keys with crypto_sign and crypto_sign_open
+**************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../random/random.h"
+#include "../api.h"
+#include "../keystore.h"
+#include "cpucycles.h"
+
+#define MLEN 59
+#define NKEYS 256
+#define NRUNS 200
+
+
+static int cmp_llu(const void *a, const void*b)
+{
+  if (*(unsigned long long *)a < *(unsigned long long *)b) return -1;
+  if (*(unsigned long long *)a > *(unsigned long long *)b) return 1;
+  return 0;
+}
+
+
+static double time_ms(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec*1e3 + ts.tv_nsec/1e6;
+}
+
+
+int main(int argc, char **argv)
+{
+  unsigned int nkeys = (argc > 1) ? (unsigned int)atoi(argv[1]) : NKEYS, i, r;
+  const char *path = (argc > 2) ? argv[2] : "/tmp/qtesla-bench-keystore";
+  unsigned char *pk, *sk, m[MLEN], sm[MLEN+CRYPTO_BYTES], mo[MLEN+CRYPTO_BYTES];
+  const unsigned char **pkp, **skp;
+  unsigned long long cycles[4][NRUNS], smlen, mlen, t0;
+  qtesla_pk_expanded_t *x;
+  keystore_t *ks;
+  void *ws;
+  double t;
+
+  pk = malloc((size_t)nkeys*CRYPTO_PUBLICKEYBYTES);
+  sk = malloc((size_t)nkeys*CRYPTO_SECRETKEYBYTES);
+  pkp = malloc(nkeys*sizeof(unsigned char *));
+  skp = malloc(nkeys*sizeof(unsigned char *));
+  if (nkeys == 0 || pk == NULL || sk == NULL || pkp == NULL || skp == NULL || 
+      posix_memalign(&ws, CRYPTO_WORKSPACEALIGN, CRYPTO_WORKSPACEBYTES) != 0 || posix_memalign((void **)&x, CRYPTO_WORKSPACEALIGN, sizeof(qtesla_pk_expanded_t)) != 0)
+    return -1;
+  for (i = 0; i < nkeys; i++) {
+    pkp[i] = &pk[(size_t)i*CRYPTO_PUBLICKEYBYTES];
+    skp[i] = &sk[(size_t)i*CRYPTO_SECRETKEYBYTES];
+    crypto_sign_keypair(&pk[(size_t)i*CRYPTO_PUBLICKEYBYTES], &sk[(size_t)i*CRYPTO_SECRETKEYBYTES]);
+  }
+
+  printf("\n");
+  printf("===========================================================================================\n");
+  printf("Key store of %u key pairs for %s, %u-byte records\n", nkeys, CRYPTO_ALGNAME, (unsigned int)sizeof(keystore_record_t));
+  printf("===========================================================================================\n\n");
+
+  t = time_ms();
+  if (keystore_write(path, pkp, skp, nkeys) != 0) {
+    printf("Key store writing FAILED. \n");
+    return -1;
+  }
+  printf("Writing the store:                   %10.2f ms\n", time_ms() - t);
+  t = time_ms();
+  for (i = 0; i < nkeys; i++)
+    qtesla_expand_pk(x, pkp[i], ws);
+  printf("Expanding every raw public key:      %10.2f ms\n", time_ms() - t);
+  t = time_ms();
+  ks = keystore_open(path, 0);
+  printf("Opening the store:                   %10.2f ms\n", time_ms() - t);
+  keystore_close(ks);
+  t = time_ms();
+  ks = keystore_open(path, KEYSTORE_VERIFY_ALL | KEYSTORE_POPULATE);
+  printf("Opening and checking every record:   %10.2f ms\n\n", time_ms() - t);
+  if (ks == NULL)
+    return -1;
+
+  for (r = 0; r < NRUNS; r++) {
+    i = r % nkeys;
+    randombytes(m, MLEN);
+    t0 = cpucycles();
+    crypto_sign(sm, &smlen, m, MLEN, skp[i]);
+    cycles[0][r] = cpucycles() - t0;
+    t0 = cpucycles();
+    keystore_sign_ws(ks, i, sm, &smlen, m, MLEN, ws);
+    cycles[1][r] = cpucycles() - t0;
+    t0 = cpucycles();
+    crypto_sign_open_ws(mo, &mlen, sm, smlen, pkp[i], ws);
+    cycles[2][r] = cpucycles() - t0;
+    t0 = cpucycles();
+    if (keystore_verify_ws(ks, i, mo, &mlen, sm, smlen, ws) != 0) {
+      printf("Signature verification with stored key FAILED. \n");
+      return -1;
+    }
+    cycles[3][r] = cpucycles() - t0;
+  }
+  for (i = 0; i < 4; i++)
+    qsort(cycles[i], NRUNS, sizeof(unsigned long long), cmp_llu);
+  printf("Median ");
+  print_unit;
+  printf(" over %u runs:   raw key   stored key\n", NRUNS);
+  printf("sign                        %10llu %12llu\n", cycles[0][NRUNS/2], cycles[1][NRUNS/2]);
+  printf("verify                      %10llu %12llu\n\n", cycles[2][NRUNS/2], cycles[3][NRUNS/2]);
+
+  keystore_close(ks);
+  if (argc <= 2)
+    remove(path);
+  free(pk); free(sk); free(pkp); free(skp); free(ws); free(x);
+  return 0;
+}
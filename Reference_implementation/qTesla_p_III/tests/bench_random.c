@@ -0,0 +1,59 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: amortized cost per call of randombytes, served from the per-thread DRBG
+*           buffer, against reading every request from the operating system
+*
+* Usage: bench_random [nruns]
+**************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../random/random.h"
+#include "../api.h"
+#include "cpucycles.h"
+
+#define NRUNS 100000
+#define MAX_REQUEST 1024
+
+
+static unsigned long long cycles_per_call(void (*rng)(unsigned char *, unsigned int), unsigned int nbytes, unsigned int nruns)
+{ // Average cycles of rng(buf, nbytes) over nruns consecutive calls, including the DRBG refills and reseeds
+  static unsigned char buf[MAX_REQUEST];
+  unsigned long long t0;
+  unsigned int i;
+
+  rng(buf, nbytes);
+  t0 = cpucycles();
+  for (i = 0; i < nruns; i++)
+    rng(buf, nbytes);
+  return (cpucycles() - t0)/nruns;
+}
+
+
+int main(int argc, char **argv)
+{
+  static const unsigned int sizes[] = { CRYPTO_RANDOMBYTES, 64, 256, MAX_REQUEST };
+  unsigned long long sys, drbg;
+  unsigned int nruns, i;
+
+  nruns = (argc > 1) ? (unsigned int)atoi(argv[1]) : NRUNS;
+  if (nruns == 0)
+    return -1;
+
+  printf("\n");
+  printf("===========================================================================================\n");
+  printf("randombytes cost per call, average of %u calls\n", nruns);
+  printf("===========================================================================================\n\n");
+  printf("bytes   operating system   per-thread DRBG   saving\n");
+
+  for (i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++) {
+    sys = cycles_per_call(randombytes_system, sizes[i], nruns);
+    drbg = cycles_per_call(randombytes, sizes[i], nruns);
+    printf("%5u   %9llu ", sizes[i], sys); print_unit;
+    printf("   %8llu ", drbg); print_unit;
+    printf("   %5.1fx\n", (double)sys/(double)drbg);
+  }
+  printf("\n");
+  return 0;
+}
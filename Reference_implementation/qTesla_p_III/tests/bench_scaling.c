@@ -0,0 +1,340 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: aggregate throughput of key generation, signing and verification on 1..N
+*           pinned threads, with scaling efficiency and latency percentiles
+*
+* Usage: bench_scaling [-t max_threads] [-helpers max_helpers] [-d seconds] [-csv file] [-json file]
+*        Each thread count runs every operation for "seconds" (1 by default) on threads
+*        pinned to consecutive CPUs. "sign" is crypto_sign, with its workspace on the
+*        stack; "sign_ws" is crypto_sign_ws with a workspace each thread allocates once.
+*        -helpers measures instead the latency of one operation at a time with 0..max_helpers
+*        helper threads of parallel_for() (see parallel.h), the caller on CPU 0 and the
+*        helpers on CPUs 1, 2, ...
+**************************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include "../random/random.h"
+#include "../api.h"
+#include "../parallel.h"
+
+#define IMPLEMENTATION "ref"
+#define MLEN 59
+#define SECONDS 1.0
+#define MAX_SAMPLES (1 << 16)   // Latencies recorded per thread and operation
+
+typedef enum { OP_KEYGEN, OP_SIGN, OP_SIGN_WS, OP_VERIFY, NOPS } op_t;
+
+static const char *op_names[NOPS] = { "keygen", "sign", "sign_ws", "verify" };
+
+typedef struct {
+  op_t op;
+  unsigned int cpu, index;
+  double seconds;
+  pthread_barrier_t *start;
+  unsigned long long nops;
+  unsigned int nsamples;
+  double *latency;   // In microseconds
+  int failed;
+} worker_t;
+
+typedef struct {
+  op_t op;
+  unsigned int nthreads, helpers;
+  double ops_per_sec, efficiency, p50, p90, p99;
+} result_t;
+
+
+static double wall_time(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + 1e-9*(double)ts.tv_nsec;
+}
+
+
+static int cmp_double(const void *a, const void *b)
+{
+  if (*(const double *)a < *(const double *)b) return -1;
+  if (*(const double *)a > *(const double *)b) return 1;
+  return 0;
+}
+
+
+static void *run_worker(void *arg)
+{ // Pins itself, prepares its own keys and message, then runs w->op until w->seconds have passed
+  worker_t *w = arg;
+  unsigned char m[MLEN], sm[MLEN+CRYPTO_BYTES], mo[MLEN+CRYPTO_BYTES];
+  unsigned char pk[CRYPTO_PUBLICKEYBYTES], sk[CRYPTO_SECRETKEYBYTES];
+  unsigned long long smlen, mlen;
+  double t, t0, end;
+  cpu_set_t cpus;
+  void *ws = NULL;
+  int r = 0;
+
+  CPU_ZERO(&cpus);
+  CPU_SET(w->cpu, &cpus);
+  pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#ifdef REPLAY
+  randombytes_replay_stream(w->index);   // Each thread replays the same randomness whatever order threads start in
+#endif
+
+  randombytes(m, MLEN);
+  crypto_sign_keypair(pk, sk);
+  crypto_sign(sm, &smlen, m, MLEN, sk);
+  if (w->op == OP_SIGN_WS && posix_memalign(&ws, CRYPTO_WORKSPACEALIGN, CRYPTO_WORKSPACEBYTES) != 0)
+    w->failed = 1;
+
+  pthread_barrier_wait(w->start);
+  if (w->failed)
+    return NULL;
+  t = wall_time();
+  end = t + w->seconds;
+  while (t < end) {
+    t0 = t;
+    switch (w->op) {
+      case OP_KEYGEN:  r = crypto_sign_keypair(pk, sk); break;
+      case OP_SIGN:    r = crypto_sign(sm, &smlen, m, MLEN, sk); break;
+      case OP_SIGN_WS: r = crypto_sign_ws(sm, &smlen, m, MLEN, sk, ws); break;
+      case OP_VERIFY:  r = crypto_sign_open(mo, &mlen, sm, smlen, pk); break;
+      default: break;
+    }
+    t = wall_time();
+    w->failed |= (r != 0);
+    if (w->nsamples < MAX_SAMPLES)
+      w->latency[w->nsamples++] = 1e6*(t - t0);
+    w->nops++;
+  }
+  free(ws);
+  return NULL;
+}
+
+
+static int run(op_t op, unsigned int nthreads, unsigned int ncpus, double seconds, double base, result_t *res)
+{ // Runs "op" on nthreads pinned threads. Returns 0, or -1 if a thread could not run or an operation failed
+  pthread_t *threads = malloc(nthreads*sizeof(pthread_t));
+  worker_t *w = calloc(nthreads, sizeof(worker_t));
+  double *all = malloc((size_t)nthreads*MAX_SAMPLES*sizeof(double));
+  pthread_barrier_t start;
+  unsigned long long nops = 0;
+  unsigned int i, n = 0;
+  int failed = 0;
+
+  if (threads == NULL || w == NULL || all == NULL) {
+    free(threads); free(w); free(all);
+    return -1;
+  }
+  pthread_barrier_init(&start, NULL, nthreads);
+  for (i = 0; i < nthreads; i++) {
+    w[i].op = op;
+    w[i].cpu = i % ncpus;
+    w[i].index = i;
+    w[i].seconds = seconds;
+    w[i].start = &start;
+    w[i].latency = &all[(size_t)i*MAX_SAMPLES];
+    if (pthread_create(&threads[i], NULL, run_worker, &w[i]) != 0) {
+      printf("Thread creation FAILED. \n");
+      exit(-1);   // The threads already created would wait on the barrier forever
+    }
+  }
+  for (i = 0; i < nthreads; i++) {
+    pthread_join(threads[i], NULL);
+    nops += w[i].nops;
+    failed |= w[i].failed;
+    memmove(&all[n], w[i].latency, w[i].nsamples*sizeof(double));
+    n += w[i].nsamples;
+  }
+  pthread_barrier_destroy(&start);
+
+  qsort(all, n, sizeof(double), cmp_double);
+  res->op = op;
+  res->nthreads = nthreads;
+  res->helpers = 0;
+  res->ops_per_sec = nops/seconds;
+  res->efficiency = (base > 0) ? res->ops_per_sec/(nthreads*base) : 1.0;
+  res->p50 = (n > 0) ? all[n/2] : 0;
+  res->p90 = (n > 0) ? all[(size_t)(0.90*(n-1))] : 0;
+  res->p99 = (n > 0) ? all[(size_t)(0.99*(n-1))] : 0;
+
+  free(threads); free(w); free(all);
+  return failed ? -1 : 0;
+}
+
+
+static int write_csv(const char *file, const result_t *r, unsigned int n)
+{
+  FILE *f = (strcmp(file, "-") == 0) ? stdout : fopen(file, "w");
+  unsigned int i;
+
+  if (f == NULL)
+    return -1;
+  fprintf(f, "scheme,implementation,operation,threads,helpers,ops_per_sec,efficiency,p50_us,p90_us,p99_us\n");
+  for (i = 0; i < n; i++)
+    fprintf(f, "%s,%s,%s,%u,%u,%.1f,%.3f,%.1f,%.1f,%.1f\n", CRYPTO_ALGNAME, IMPLEMENTATION, op_names[r[i].op], r[i].nthreads, r[i].helpers,
+            r[i].ops_per_sec, r[i].efficiency, r[i].p50, r[i].p90, r[i].p99);
+  if (f != stdout)
+    fclose(f);
+  return 0;
+}
+
+
+static int write_json(const char *file, const result_t *r, unsigned int n, double seconds)
+{
+  FILE *f = (strcmp(file, "-") == 0) ? stdout : fopen(file, "w");
+  unsigned int i;
+
+  if (f == NULL)
+    return -1;
+  fprintf(f, "{\n");
+  fprintf(f, "  \"scheme\": \"%s\",\n", CRYPTO_ALGNAME);
+  fprintf(f, "  \"implementation\": \"%s\",\n", IMPLEMENTATION);
+  fprintf(f, "  \"seconds\": %.2f,\n", seconds);
+  fprintf(f, "  \"results\": [\n");
+  for (i = 0; i < n; i++)
+    fprintf(f, "    {\"operation\": \"%s\", \"threads\": %u, \"helpers\": %u, \"ops_per_sec\": %.1f, \"efficiency\": %.3f, \"p50_us\": %.1f, \"p90_us\": %.1f, \"p99_us\": %.1f}%s\n",
+            op_names[r[i].op], r[i].nthreads, r[i].helpers, r[i].ops_per_sec, r[i].efficiency, r[i].p50, r[i].p90, r[i].p99, (i+1 < n) ? "," : "");
+  fprintf(f, "  ]\n}\n");
+  if (f != stdout)
+    fclose(f);
+  return 0;
+}
+
+
+static int run_helpers(unsigned int max_helpers, unsigned int ncpus, double seconds, int quiet, result_t *results, unsigned int *nresults)
+{ // Latency of keygen, sign and verify on one thread with 0..max_helpers helper threads. Returns 0, or -1 on failure
+  static const op_t ops[3] = { OP_KEYGEN, OP_SIGN, OP_VERIFY };
+  double base[3] = {0};
+  unsigned int h, i;
+  result_t *r;
+  int *cpus;
+
+  cpus = malloc((max_helpers+1)*sizeof(int));
+  if (cpus == NULL)
+    return -1;
+  for (i = 0; i < max_helpers; i++)
+    cpus[i] = (int)((i+1) % ncpus);
+  if (!quiet)
+    printf("operation  helpers        ops/s     speedup    p50 us    p90 us    p99 us\n");
+
+  for (h = 0; h <= max_helpers; h++) {
+    if (h > 0 && parallel_enable(h, cpus) != 0) {
+      printf("Helper thread creation FAILED. \n");
+      free(cpus);
+      return -1;
+    }
+    for (i = 0; i < 3; i++) {
+      r = &results[(*nresults)++];
+      if (run(ops[i], 1, ncpus, seconds, 0, r) != 0) {
+        printf("Operation %s FAILED. \n", op_names[ops[i]]);
+        parallel_disable();
+        free(cpus);
+        return -1;
+      }
+      r->helpers = h;
+      if (h == 0)
+        base[i] = r->p50;
+      r->efficiency = (r->p50 > 0) ? base[i]/r->p50 : 0;   // Speedup of the median latency
+      if (!quiet)
+        printf("%-9s %8u %12.1f %11.2fx %9.1f %9.1f %9.1f\n", op_names[ops[i]], h, r->ops_per_sec, r->efficiency, r->p50, r->p90, r->p99);
+    }
+    if (h > 0)
+      parallel_disable();
+  }
+  if (!quiet)
+    printf("\nSpeedup is the median latency without helpers over the median latency with them; helpers beyond %u share CPUs\n\n", ncpus-1);
+  free(cpus);
+  return 0;
+}
+
+
+int main(int argc, char **argv)
+{
+  const char *csv = NULL, *json = NULL;
+  unsigned int ncpus, max_threads, nthreads, nresults = 0, i;
+  int max_helpers = -1;
+  double seconds = SECONDS, base[NOPS] = {0};
+  result_t *results;
+  int op, quiet;
+
+  ncpus = (unsigned int)sysconf(_SC_NPROCESSORS_ONLN);
+  max_threads = ncpus;
+  for (i = 1; i < (unsigned int)argc; i++) {
+    if (strcmp(argv[i], "-t") == 0 && i+1 < (unsigned int)argc)
+      max_threads = (unsigned int)atoi(argv[++i]);
+    else if (strcmp(argv[i], "-helpers") == 0 && i+1 < (unsigned int)argc)
+      max_helpers = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-d") == 0 && i+1 < (unsigned int)argc)
+      seconds = atof(argv[++i]);
+    else if (strcmp(argv[i], "-csv") == 0 && i+1 < (unsigned int)argc)
+      csv = argv[++i];
+    else if (strcmp(argv[i], "-json") == 0 && i+1 < (unsigned int)argc)
+      json = argv[++i];
+    else {
+      printf("Usage: %s [-t max_threads] [-helpers max_helpers] [-d seconds] [-csv file] [-json file]\n", argv[0]);
+      return -1;
+    }
+  }
+  if (max_threads == 0 || ncpus == 0 || seconds <= 0)
+    return -1;
+  if (max_helpers > 0xFFFF)
+    return -1;
+  results = malloc((max_helpers >= 0 ? 3*(size_t)(max_helpers+1) : NOPS*(size_t)(max_threads+1))*sizeof(result_t));
+  if (results == NULL)
+    return -1;
+  quiet = (csv != NULL && strcmp(csv, "-") == 0) || (json != NULL && strcmp(json, "-") == 0);
+
+  if (max_helpers >= 0) {
+    if (!quiet) {
+      printf("\n");
+      printf("===========================================================================================\n");
+      printf("Single-operation latency of %s (%s) with helper threads, %u CPUs, %.1f s per run\n", CRYPTO_ALGNAME, IMPLEMENTATION, ncpus, seconds);
+      printf("===========================================================================================\n\n");
+    }
+    if (run_helpers((unsigned int)max_helpers, ncpus, seconds, quiet, results, &nresults) != 0)
+      return -1;
+    goto out;
+  }
+
+  if (!quiet) {
+    printf("\n");
+    printf("===========================================================================================\n");
+    printf("Throughput scaling of %s (%s), %u CPUs, %.1f s per run\n", CRYPTO_ALGNAME, IMPLEMENTATION, ncpus, seconds);
+    printf("===========================================================================================\n\n");
+    printf("operation  threads        ops/s   efficiency    p50 us    p90 us    p99 us\n");
+  }
+
+  for (op = 0; op < NOPS; op++) {
+    for (nthreads = 1; nthreads <= max_threads; nthreads = (nthreads < max_threads && 2*nthreads > max_threads) ? max_threads : 2*nthreads) {
+      if (run((op_t)op, nthreads, ncpus, seconds, base[op], &results[nresults]) != 0) {
+        printf("Operation %s FAILED. \n", op_names[op]);
+        return -1;
+      }
+      if (nthreads == 1)
+        base[op] = results[nresults].ops_per_sec;
+      if (!quiet)
+        printf("%-9s %8u %12.1f %11.1f%% %9.1f %9.1f %9.1f\n", op_names[op], nthreads, results[nresults].ops_per_sec,
+               100*results[nresults].efficiency, results[nresults].p50, results[nresults].p90, results[nresults].p99);
+      nresults++;
+      if (nthreads == max_threads)
+        break;
+    }
+  }
+  if (!quiet)
+    printf("\nEfficiency is ops/s over threads times the ops/s of one thread; threads beyond %u share CPUs\n\n", ncpus);
+
+out:
+  if ((csv != NULL && write_csv(csv, results, nresults) != 0) || (json != NULL && write_json(json, results, nresults, seconds) != 0)) {
+    printf("Cannot write the results\n");
+    return -1;
+  }
+  free(results);
+  return 0;
+}
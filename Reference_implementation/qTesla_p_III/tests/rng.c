@@ -4,17 +4,173 @@
 //  Created by Bassham, Lawrence E (Fed) on 8/29/17.
 //  Copyright © 2017 Bassham, Lawrence E (Fed). All rights reserved.
 //
+//  AES-256 is computed here instead of with OpenSSL: with AES-NI when the compiler targets it
+//  (e.g. -march=native on x86), and with a portable byte-oriented implementation otherwise.
+//  The key schedule is expanded once per request, and randombytes() encrypts all the counter
+//  blocks of a request in one call, so the output is the same as that of the NIST CTR_DRBG
+//
 
 #include <string.h>
 #include "rng.h"
-#include <openssl/conf.h>
-#include <openssl/evp.h>
-#include <openssl/err.h>
+#if defined(__AES__) && (defined(__x86_64__) || defined(__i386__))
+  #include <wmmintrin.h>
+  #define AES_NI
+#endif
+
+#define AES256_ROUNDS 14
 
 AES256_CTR_DRBG_struct  DRBG_ctx;
 
 void    AES256_ECB(unsigned char *key, unsigned char *ctr, unsigned char *buffer);
 
+static const unsigned char sbox[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+};
+
+/*
+ aes256_key_expansion()
+    rk   - the 15 round keys, in the byte order of FIPS 197 (which is also the one AESENC takes)
+    key  - 256-bit AES key
+ */
+static void
+aes256_key_expansion(unsigned char rk[16*(AES256_ROUNDS+1)], const unsigned char *key)
+{
+    unsigned char   rcon = 0x01, t[4];
+
+    memcpy(rk, key, 32);
+    for (int i=8; i<4*(AES256_ROUNDS+1); i++) {
+        memcpy(t, rk+4*(i-1), 4);
+        if ( i % 8 == 0 ) {
+            unsigned char   u = t[0];
+            t[0] = sbox[t[1]] ^ rcon;
+            t[1] = sbox[t[2]];
+            t[2] = sbox[t[3]];
+            t[3] = sbox[u];
+            rcon = (unsigned char)((rcon << 1) ^ ((rcon >> 7) * 0x1b));
+        }
+        else if ( i % 8 == 4 ) {
+            for (int j=0; j<4; j++)
+                t[j] = sbox[t[j]];
+        }
+        for (int j=0; j<4; j++)
+            rk[4*i+j] = rk[4*(i-8)+j] ^ t[j];
+    }
+}
+
+#if defined(AES_NI)
+
+static void
+aes256_encrypt_block(const unsigned char rk[16*(AES256_ROUNDS+1)], const unsigned char *in, unsigned char *out)
+{
+    __m128i         b = _mm_xor_si128(_mm_loadu_si128((const __m128i *)in), _mm_loadu_si128((const __m128i *)rk));
+
+    for (int r=1; r<AES256_ROUNDS; r++)
+        b = _mm_aesenc_si128(b, _mm_loadu_si128((const __m128i *)(rk+16*r)));
+    _mm_storeu_si128((__m128i *)out, _mm_aesenclast_si128(b, _mm_loadu_si128((const __m128i *)(rk+16*AES256_ROUNDS))));
+}
+
+#else
+
+static unsigned char
+xtime(unsigned char x)
+{
+    return (unsigned char)((x << 1) ^ ((x >> 7) * 0x1b));
+}
+
+static void
+aes256_encrypt_block(const unsigned char rk[16*(AES256_ROUNDS+1)], const unsigned char *in, unsigned char *out)
+{
+    unsigned char   s[16], t[16];
+
+    for (int i=0; i<16; i++)
+        s[i] = in[i] ^ rk[i];
+    for (int r=1; r<=AES256_ROUNDS; r++) {
+        // SubBytes and ShiftRows: byte i of the state is row i%4 of column i/4
+        for (int i=0; i<16; i++)
+            t[i] = sbox[s[(i + 4*(i%4)) % 16]];
+        // MixColumns, except in the last round
+        if ( r < AES256_ROUNDS ) {
+            for (int c=0; c<4; c++) {
+                unsigned char   *col = t+4*c, a = col[0] ^ col[1] ^ col[2] ^ col[3], c0 = col[0];
+                col[0] ^= a ^ xtime(col[0] ^ col[1]);
+                col[1] ^= a ^ xtime(col[1] ^ col[2]);
+                col[2] ^= a ^ xtime(col[2] ^ col[3]);
+                col[3] ^= a ^ xtime(col[3] ^ c0);
+            }
+        }
+        for (int i=0; i<16; i++)
+            s[i] = t[i] ^ rk[16*r+i];
+    }
+    memcpy(out, s, 16);
+}
+
+#endif
+
+static void
+increment_V(unsigned char *V)
+{
+    for (int j=15; j>=0; j--) {
+        if ( V[j] == 0xff )
+            V[j] = 0x00;
+        else {
+            V[j]++;
+            break;
+        }
+    }
+}
+
+/*
+ aes256_ctr()
+    Encrypts the counter blocks V+1, ..., V+nblocks under the expanded key rk into out, and leaves V at V+nblocks
+ */
+static void
+aes256_ctr(const unsigned char rk[16*(AES256_ROUNDS+1)], unsigned char *V, unsigned char *out, unsigned long long nblocks)
+{
+#if defined(AES_NI)
+    __m128i         k[AES256_ROUNDS+1], b[4];
+    unsigned char   ctr[4][16];
+    unsigned long long  i;
+    int             j, n, r;
+
+    for (r=0; r<=AES256_ROUNDS; r++)
+        k[r] = _mm_loadu_si128((const __m128i *)(rk+16*r));
+    for (i=0; i<nblocks; i+=4) {
+        // Four independent blocks at a time hide the latency of AESENC
+        n = (nblocks-i < 4) ? (int)(nblocks-i) : 4;
+        for (j=0; j<n; j++) {
+            increment_V(V);
+            memcpy(ctr[j], V, 16);
+            b[j] = _mm_xor_si128(_mm_loadu_si128((const __m128i *)ctr[j]), k[0]);
+        }
+        for (r=1; r<AES256_ROUNDS; r++)
+            for (j=0; j<n; j++)
+                b[j] = _mm_aesenc_si128(b[j], k[r]);
+        for (j=0; j<n; j++)
+            _mm_storeu_si128((__m128i *)(out+16*(i+j)), _mm_aesenclast_si128(b[j], k[AES256_ROUNDS]));
+    }
+#else
+    for (unsigned long long i=0; i<nblocks; i++) {
+        increment_V(V);
+        aes256_encrypt_block(rk, V, out+16*i);
+    }
+#endif
+}
+
 /*
  seedexpander_init()
  ctx            - stores the current state of an instance of the seed expander
@@ -30,11 +186,11 @@ seedexpander_init(AES_XOF_struct *ctx,
 {
     if ( maxlen >= 0x100000000 )
         return RNG_BAD_MAXLEN;
-    
+
     ctx->length_remaining = maxlen;
-    
+
     memcpy(ctx->key, seed, 32);
-    
+
     memcpy(ctx->ctr, diversifier, 8);
     ctx->ctr[11] = maxlen % 256;
     maxlen >>= 8;
@@ -44,10 +200,10 @@ seedexpander_init(AES_XOF_struct *ctx,
     maxlen >>= 8;
     ctx->ctr[8] = maxlen % 256;
     memset(ctx->ctr+12, 0x00, 4);
-    
+
     ctx->buffer_pos = 16;
     memset(ctx->buffer, 0x00, 16);
-    
+
     return RNG_SUCCESS;
 }
 
@@ -61,31 +217,31 @@ int
 seedexpander(AES_XOF_struct *ctx, unsigned char *x, unsigned long xlen)
 {
     unsigned long   offset;
-    
+
     if ( x == NULL )
         return RNG_BAD_OUTBUF;
     if ( xlen >= ctx->length_remaining )
         return RNG_BAD_REQ_LEN;
-    
+
     ctx->length_remaining -= xlen;
-    
+
     offset = 0;
     while ( xlen > 0 ) {
         if ( xlen <= (16-ctx->buffer_pos) ) { // buffer has what we need
             memcpy(x+offset, ctx->buffer+ctx->buffer_pos, xlen);
             ctx->buffer_pos += xlen;
-            
+
             return RNG_SUCCESS;
         }
-        
+
         // take what's in the buffer
         memcpy(x+offset, ctx->buffer+ctx->buffer_pos, 16-ctx->buffer_pos);
         xlen -= 16-ctx->buffer_pos;
         offset += 16-ctx->buffer_pos;
-        
+
         AES256_ECB(ctx->key, ctx->ctr, ctx->buffer);
         ctx->buffer_pos = 0;
-        
+
         //increment the counter
         for (int i=15; i>=12; i--) {
             if ( ctx->ctr[i] == 0xff )
@@ -95,44 +251,23 @@ seedexpander(AES_XOF_struct *ctx, unsigned char *x, unsigned long xlen)
                 break;
             }
         }
-        
+
     }
-    
+
     return RNG_SUCCESS;
 }
 
 
-void handleErrors(void)
-{
-    ERR_print_errors_fp(stderr);
-    abort();
-}
-
-// Use whatever AES implementation you have. This uses AES from openSSL library
 //    key - 256-bit AES key
 //    ctr - a 128-bit plaintext value
 //    buffer - a 128-bit ciphertext value
 void
 AES256_ECB(unsigned char *key, unsigned char *ctr, unsigned char *buffer)
 {
-    EVP_CIPHER_CTX *ctx;
-    
-    int len;
-    
-    int ciphertext_len;
-    
-    /* Create and initialise the context */
-    if(!(ctx = EVP_CIPHER_CTX_new())) handleErrors();
-    
-    if(1 != EVP_EncryptInit_ex(ctx, EVP_aes_256_ecb(), NULL, key, NULL))
-        handleErrors();
-    
-    if(1 != EVP_EncryptUpdate(ctx, buffer, &len, ctr, 16))
-        handleErrors();
-    ciphertext_len = len;
-    
-    /* Clean up */
-    EVP_CIPHER_CTX_free(ctx);
+    unsigned char   rk[16*(AES256_ROUNDS+1)];
+
+    aes256_key_expansion(rk, key);
+    aes256_encrypt_block(rk, ctr, buffer);
 }
 
 void
@@ -141,7 +276,7 @@ randombytes_init(unsigned char *entropy_input,
                  int security_strength)
 {
     unsigned char   seed_material[48];
-    
+
     memcpy(seed_material, entropy_input, 48);
     if (personalization_string)
         for (int i=0; i<48; i++)
@@ -155,33 +290,18 @@ randombytes_init(unsigned char *entropy_input,
 int
 randombytes(unsigned char *x, unsigned long long xlen)
 {
-    unsigned char   block[16];
-    int             i = 0;
-    
-    while ( xlen > 0 ) {
-        //increment V
-        for (int j=15; j>=0; j--) {
-            if ( DRBG_ctx.V[j] == 0xff )
-                DRBG_ctx.V[j] = 0x00;
-            else {
-                DRBG_ctx.V[j]++;
-                break;
-            }
-        }
-        AES256_ECB(DRBG_ctx.Key, DRBG_ctx.V, block);
-        if ( xlen > 15 ) {
-            memcpy(x+i, block, 16);
-            i += 16;
-            xlen -= 16;
-        }
-        else {
-            memcpy(x+i, block, xlen);
-            xlen = 0;
-        }
+    unsigned char   rk[16*(AES256_ROUNDS+1)], block[16];
+
+    // The whole blocks go straight to x, the last partial one through "block"
+    aes256_key_expansion(rk, DRBG_ctx.Key);
+    aes256_ctr(rk, DRBG_ctx.V, x, xlen/16);
+    if ( xlen % 16 ) {
+        aes256_ctr(rk, DRBG_ctx.V, block, 1);
+        memcpy(x+16*(xlen/16), block, xlen % 16);
     }
     AES256_CTR_DRBG_Update(NULL, DRBG_ctx.Key, DRBG_ctx.V);
     DRBG_ctx.reseed_counter++;
-    
+
     return RNG_SUCCESS;
 }
 
@@ -190,33 +310,13 @@ AES256_CTR_DRBG_Update(unsigned char *provided_data,
                        unsigned char *Key,
                        unsigned char *V)
 {
-    unsigned char   temp[48];
-    
-    for (int i=0; i<3; i++) {
-        //increment V
-        for (int j=15; j>=0; j--) {
-            if ( V[j] == 0xff )
-                V[j] = 0x00;
-            else {
-                V[j]++;
-                break;
-            }
-        }
-        
-        AES256_ECB(Key, V, temp+16*i);
-    }
+    unsigned char   rk[16*(AES256_ROUNDS+1)], temp[48];
+
+    aes256_key_expansion(rk, Key);
+    aes256_ctr(rk, V, temp, 3);
     if ( provided_data != NULL )
         for (int i=0; i<48; i++)
             temp[i] ^= provided_data[i];
     memcpy(Key, temp, 32);
     memcpy(V, temp+32, 16);
 }
-
-
-
-
-
-
-
-
-
@@ -0,0 +1,68 @@
+/*************************************************************************************
+* qTESLA: an efficient post-quantum signature scheme based on the R-LWE problem
+*
+* Abstract: bounded, sharded cache of verified signatures, for verifiers that see the
+*           same signed messages many times
+**************************************************************************************/
+
+#ifndef __VERIFYCACHE_H
+#define __VERIFYCACHE_H
+
+#include "api.h"
+
+#define VERIFYCACHE_KEY_BYTES 32         // Digest of H(m), the public key digest and the signature that identifies an entry
+#define VERIFYCACHE_PK_DIGEST_BYTES 32   // SHAKE256 digest of a public key
+#define VERIFYCACHE_WAYS 8               // Entries per set; a full set evicts its least recently used entry
+
+typedef struct verifycache verifycache_t;
+
+typedef struct {   // Public key with its digest, computed once for all the signatures checked under the key
+  const unsigned char *pk;
+  unsigned char digest[VERIFYCACHE_PK_DIGEST_BYTES];
+} verifycache_pk_t;
+
+typedef struct {
+  unsigned int capacity;          // Entries stored when the cache is full
+  unsigned int nshards;           // Shards, each with its own lock
+  unsigned int entries;           // Entries currently stored
+  unsigned long long hits;        // Signatures accepted without verification
+  unsigned long long misses;      // Signatures verified with crypto_sign_open()
+  unsigned long long rejected;    // Misses that failed verification, which are never stored
+  unsigned long long evictions;   // Entries dropped to store newer ones
+  double hit_rate;                // hits/(hits + misses)
+  double hit_ns;                  // Average time of a hit
+  double verify_ns;               // Average time of a verification
+  double saved_ns;                // Time saved by the hits: hits*(verify_ns - hit_ns)
+} verifycache_stats_t;
+
+// Creates a cache of "capacity" entries split into "nshards" shards (both rounded up: the shards to a power of 2,
+// the entries of a shard to a multiple of VERIFYCACHE_WAYS). Returns NULL on failure
+verifycache_t *verifycache_create(unsigned int capacity, unsigned int nshards);
+
+// Same as crypto_sign_open(), except that a signed message that verified before for pk is accepted without being 
+// verified again. Only signatures that verify are stored. A NULL cache runs crypto_sign_open(). Thread-safe
+int verifycache_open(verifycache_t *cache, unsigned char *m, unsigned long long *mlen, const unsigned char *sm, unsigned long long smlen, const unsigned char *pk);
+
+// Same as above, with the large temporaries of a verification kept in "ws", a workspace of CRYPTO_WORKSPACEBYTES bytes
+// aligned to CRYPTO_WORKSPACEALIGN
+int verifycache_open_ws(verifycache_t *cache, unsigned char *m, unsigned long long *mlen, const unsigned char *sm, unsigned long long smlen, 
+                        const unsigned char *pk, void *ws);
+
+// Points "key" at pk, which must stay valid as long as "key" is used, and computes the digest of pk
+void verifycache_pk_init(verifycache_pk_t *key, const unsigned char *pk);
+
+// Same as verifycache_open() and verifycache_open_ws() under the public key of "key". A hit hashes only H(m) and the 
+// signature, where the functions above also hash the whole public key
+int verifycache_open_pk(verifycache_t *cache, unsigned char *m, unsigned long long *mlen, const unsigned char *sm, unsigned long long smlen, 
+                        const verifycache_pk_t *key);
+int verifycache_open_pk_ws(verifycache_t *cache, unsigned char *m, unsigned long long *mlen, const unsigned char *sm, unsigned long long smlen, 
+                           const verifycache_pk_t *key, void *ws);
+
+// Drops every entry, e.g. when a public key is revoked. The statistics are kept
+void verifycache_clear(verifycache_t *cache);
+
+void verifycache_get_stats(verifycache_t *cache, verifycache_stats_t *stats);
+
+void verifycache_destroy(verifycache_t *cache);
+
+#endif